@@ -0,0 +1 @@
+"""Bridge benchmarks: `python -m bench.<name>` from agent/ (see README.md)."""
@@ -0,0 +1,143 @@
+"""
+Minimal MQTT 3.1.1 broker for benchmarks: acks everything, delivers nothing, counts packets.
+
+Runs in its own process (so it doesn't compete with the bridge for the GIL) and counts the
+PUBLISH packets it receives & the acks it sends for them: a QoS 1 message costs one broker
+round-trip (PUBLISH/PUBACK), a QoS 2 message two (PUBLISH/PUBREC, PUBREL/PUBCOMP).
+"""
+
+from __future__ import annotations
+
+import multiprocessing as mp
+import socket
+import struct
+import threading
+from typing import TYPE_CHECKING, Final, Self
+
+if TYPE_CHECKING:
+    from multiprocessing.sharedctypes import Synchronized
+    from multiprocessing.synchronize import Event
+    from types import TracebackType
+
+DISCONNECT: Final = 14  # Control packet type (high nibble of the fixed header)
+
+type Counter = Synchronized[int]
+
+
+def _read(conn: socket.socket, n: int) -> bytes:
+    data = b""
+    while len(data) < n:
+        if not (chunk := conn.recv(n - len(data))):
+            raise ConnectionError
+        data += chunk
+    return data
+
+
+def _read_length(conn: socket.socket) -> int:
+    """Read a variable-length remaining length field."""
+
+    value, mult = 0, 1
+    while True:
+        byte = _read(conn, 1)[0]
+        value += (byte & 0x7F) * mult
+        mult *= 128
+        if not byte & 0x80:
+            return value
+
+
+def _count(counter: Counter) -> None:
+    with counter.get_lock():
+        counter.value += 1
+
+
+def _reply(header: int, body: bytes, publishes: Counter, round_trips: Counter) -> bytes:
+    """Return the broker's response to a packet (b"" if none); acks are counted before they're sent."""
+
+    match header >> 4:
+        case 1:  # CONNECT
+            return b"\x20\x02\x00\x00"  # CONNACK, accepted
+        case 3:  # PUBLISH
+            _count(publishes)
+            if not (qos := (header >> 1) & 3):
+                return b""
+            topic_len = struct.unpack(">H", body[:2])[0]
+            _count(round_trips)
+            return (b"\x40\x02" if qos == 1 else b"\x50\x02") + body[2 + topic_len : 4 + topic_len]  # PUBACK/PUBREC
+        case 6:  # PUBREL
+            _count(round_trips)
+            return b"\x70\x02" + body[:2]  # PUBCOMP
+        case 8:  # SUBSCRIBE
+            return b"\x90\x03" + body[:2] + b"\x02"  # SUBACK, QoS 2 granted
+        case 10:  # UNSUBSCRIBE
+            return b"\xb0\x02" + body[:2]
+        case 12:  # PINGREQ
+            return b"\xd0\x00"
+        case _:
+            return b""
+
+
+def _serve_client(conn: socket.socket, publishes: Counter, round_trips: Counter) -> None:
+    with conn:
+        try:
+            while True:
+                header = _read(conn, 1)[0]
+                body = _read(conn, n) if (n := _read_length(conn)) else b""
+                if header >> 4 == DISCONNECT:
+                    return
+                if reply := _reply(header, body, publishes, round_trips):
+                    conn.sendall(reply)
+        except OSError:
+            return
+
+
+def _serve(srv: socket.socket, ready: Event, publishes: Counter, round_trips: Counter) -> None:
+    srv.listen()
+    ready.set()
+    while True:
+        conn, _ = srv.accept()
+        threading.Thread(target=_serve_client, args=(conn, publishes, round_trips), daemon=True).start()
+
+
+class Broker:
+    """Broker process on 127.0.0.1 (an OS-assigned port unless given), for use as a context manager."""
+
+    def __init__(self, port: int = 0) -> None:
+        self._srv = socket.socket()
+        self._srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._srv.bind(("127.0.0.1", port))
+        self.port: int = self._srv.getsockname()[1]
+
+        self._publishes: Counter = mp.Value("q", 0)
+        self._round_trips: Counter = mp.Value("q", 0)
+        self._ready = mp.Event()
+        self._proc = mp.Process(
+            target=_serve, args=(self._srv, self._ready, self._publishes, self._round_trips), daemon=True
+        )
+
+    def __enter__(self) -> Self:
+        self._proc.start()
+        self._ready.wait()
+        return self
+
+    def __exit__(
+        self, exc_type: type[BaseException] | None, exc: BaseException | None, tb: TracebackType | None
+    ) -> None:
+        self._proc.kill()
+        self._proc.join()
+        self._srv.close()
+
+    @property
+    def publishes(self) -> int:
+        """PUBLISH packets received (since the last reset())."""
+        return self._publishes.value
+
+    @property
+    def round_trips(self) -> int:
+        """Acks sent for PUBLISH/PUBREL packets (since the last reset())."""
+        return self._round_trips.value
+
+    def reset(self) -> None:
+        with self._publishes.get_lock():
+            self._publishes.value = 0
+        with self._round_trips.get_lock():
+            self._round_trips.value = 0
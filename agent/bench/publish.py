@@ -0,0 +1,102 @@
+"""
+Publish throughput per QoS/batching config: events/s, MQTT messages & broker round-trips.
+
+Events go through MqttClient.publish_events() (in bursts, as the reader hands them over) to a
+local broker (see broker.py). A run ends once the broker has received (and acked) every message.
+
+    uv run python -m bench.publish [--events N]  # From agent/
+"""
+
+from __future__ import annotations
+
+import argparse
+import itertools
+import logging
+import math
+import time
+from typing import TYPE_CHECKING, Final
+
+from agent.mqtt import DEFAULT_QOS, MqttClient, PublishConf
+
+from .broker import Broker
+
+if TYPE_CHECKING:
+    from collections.abc import Callable
+
+    from agent.mqtt import OutEvent
+
+BURST: Final = 32  # Events per publish_events() call
+TIMEOUT: Final = 60
+
+EVENT: Final = b'{"event_type":"pop_result","t":1234,"mole_id":3,"outcome":"hit","reaction_ms":245,"lvl":2}'
+
+# (name, game_events QoS, --batch, --max-inflight)
+CONFIGS: Final = (
+    ("qos2 (old default)", 2, 0, 20),
+    ("qos1", 1, 0, 20),
+    ("qos1, max-inflight 100", 1, 0, 100),
+    ("qos0", 0, 0, 20),
+    ("qos1, batch 32", 1, 32, 20),
+)
+
+
+def wait_until(done: Callable[[], bool], what: str) -> None:
+    deadline = time.monotonic() + TIMEOUT
+    while not done():
+        if time.monotonic() > deadline:
+            msg = f"{what} not done within {TIMEOUT}s"
+            raise TimeoutError(msg)
+        time.sleep(0.001)
+
+
+def run(broker: Broker, n_events: int, qos: int, batch: int, inflight: int) -> tuple[float, int, int]:
+    """Publish n_events with the given config; return (events/s, messages, broker round-trips)."""
+
+    conf = PublishConf(qos={**DEFAULT_QOS, "game_events": qos}, batch_max=batch, max_inflight=inflight)
+    mqtt = MqttClient(
+        broker="127.0.0.1", port=broker.port, client_id="bench", topic="whac", on_command=print, publish=conf
+    )
+    if not mqtt.connect():
+        msg = "can't connect to benchmark broker"
+        raise ConnectionError(msg)
+
+    try:
+        # Start timing once connected (a QoS 1 state message is acked)
+        mqtt.publish_state("bench", "online").wait_for_publish(TIMEOUT)
+        broker.reset()
+
+        msgs = math.ceil(n_events / batch) if batch else n_events
+        burst: list[OutEvent] = [(EVENT, None, None)] * BURST
+        start = time.perf_counter()
+        for sent in itertools.batched(range(n_events), BURST):
+            mqtt.publish_events("bench", burst[: len(sent)])
+        wait_until(lambda: broker.publishes >= msgs and broker.round_trips >= msgs * qos, "publishing")
+        elapsed = time.perf_counter() - start
+        publishes, round_trips = broker.publishes, broker.round_trips
+
+        # Let the client read the acks before disconnecting: the broker acks in order, so they're
+        # in once an ack for a later message arrives (else paho can race its own disconnect)
+        mqtt.publish_state("bench", "online").wait_for_publish(TIMEOUT)
+        return n_events / elapsed, publishes, round_trips
+    finally:
+        mqtt.disconnect()
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--events", type=int, default=5000, help="events per config (default: %(default)s)")
+    args = parser.parse_args()
+
+    # paho 2.1's loop thread can send DISCONNECT & exit before disconnect() returns, which then
+    # reports NO_CONN (logged as a failure); connect failures still raise
+    logging.getLogger("MqttClient").setLevel(logging.CRITICAL + 1)
+
+    print(f"{args.events} events per config, published in bursts of {BURST}")
+    with Broker() as broker:
+        for name, qos, batch, inflight in CONFIGS:
+            rate, msgs, round_trips = run(broker, args.events, qos, batch, inflight)
+            print(f"  {name:24s} {rate / 1000:6.1f}k events/s  {msgs:6d} msgs  {round_trips:6d} round-trips")
+
+
+if __name__ == "__main__":
+    main()
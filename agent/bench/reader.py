@@ -0,0 +1,134 @@
+"""
+Serial reader throughput: per-line readline()/json round-trip vs chunked framing & field splicing.
+
+A burst of pop_result lines (as a board flushes them) is read from memory the old way (pyserial
+readline(), decode, json.loads(), dict merge, json.dumps()) and the new way (LineReader framing,
+fastjson.loads() from the buffer, fastjson.splice() onto the raw line); parse-only variants show
+how much of that is framing. Then checks spliced output decodes to the same object as the merge.
+
+    uv run python -m bench.reader [--lines N]  # From agent/
+"""
+
+from __future__ import annotations
+
+import argparse
+import io
+import itertools
+import json
+import time
+from typing import TYPE_CHECKING, Final
+
+from agent import fastjson
+from agent.framing import LineReader
+
+if TYPE_CHECKING:
+    from collections.abc import Callable
+
+ROUNDS: Final = 3  # Best of
+
+COMMON: Final = {"device_id": "bench", "seq_epoch": 1}  # Fields the bridge adds (plus ts & seq)
+
+
+class _Burst:
+    """Buffered serial input: pyserial-like readline() (one read(1) per byte) & Transport.read()."""
+
+    def __init__(self, data: bytes) -> None:
+        self._f = io.BytesIO(data)
+
+    def read(self, max_bytes: int = 1) -> bytes:
+        return self._f.read(max_bytes)
+
+    def readline(self) -> bytes:
+        line = bytearray()
+        while c := self.read(1):
+            line += c
+            if c == b"\n":
+                break
+        return bytes(line)
+
+
+def make_lines(n: int) -> list[bytes]:
+    return [
+        b'{"event_type":"pop_result","mole_id":%d,"outcome":"hit","reaction_ms":%d,"lvl":3,"t":%d}\n'
+        % (i % 8, 200 + i % 300, 10000 + i)
+        for i in range(n)
+    ]
+
+
+def old_reader(data: bytes) -> int:
+    burst, seq, out = _Burst(data), itertools.count(), 0
+    while line := burst.readline():
+        event = json.loads(line.decode("ascii").strip())
+        out += len(json.dumps(event | COMMON | {"ts": 1, "seq": next(seq)}))
+    return out
+
+
+def new_reader(data: bytes) -> int:
+    burst, reader, seq, out = _Burst(data), LineReader(), itertools.count(), 0
+    while reader.fill(burst):  # type: ignore[arg-type]
+        while (frame := reader.next_frame()) is not None:
+            with frame:
+                fastjson.loads(frame)
+                out += len(fastjson.splice(bytes(frame), COMMON | {"ts": 1, "seq": next(seq)}))
+    return out
+
+
+def old_parse(data: bytes) -> int:
+    burst, n = _Burst(data), 0
+    while line := burst.readline():
+        json.loads(line.decode("ascii").strip())
+        n += 1
+    return n
+
+
+def new_parse(data: bytes) -> int:
+    burst, reader, n = _Burst(data), LineReader(), 0
+    while reader.fill(burst):  # type: ignore[arg-type]
+        while (frame := reader.next_frame()) is not None:
+            with frame:
+                fastjson.loads(frame)
+                n += 1
+    return n
+
+
+def best_time(fn: Callable[[bytes], int], data: bytes) -> float:
+    times = []
+    for _ in range(ROUNDS):
+        start = time.perf_counter()
+        fn(data)
+        times.append(time.perf_counter() - start)
+    return min(times)
+
+
+def check_splice(lines: list[bytes]) -> None:
+    """Spliced lines must decode to the old merge (incl. empty objects, padding & overridden keys)."""
+
+    fields = COMMON | {"ts": 7, "seq": 1}
+    for line in [*lines, b"{}", b' {"a":1 } \r', b'{"device_id":"x","ts":5}']:
+        if json.loads(fastjson.splice(line, fields)) != json.loads(line) | fields:
+            msg = f"splice differs from merge for {line!r}"
+            raise AssertionError(msg)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--lines", type=int, default=20000, help="lines per burst (default: %(default)s)")
+    args = parser.parse_args()
+
+    lines = make_lines(args.lines)
+    data = b"".join(lines)
+    print(f"{args.lines} lines in one burst, JSON backend: {fastjson.BACKEND}")
+    for name, fn in (
+        ("old readline+loads+merge+dumps", old_reader),
+        ("new framing+loads+splice", new_reader),
+        ("parse only, old (readline+loads)", old_parse),
+        ("parse only, new (framing+loads)", new_parse),
+    ):
+        print(f"  {name:34s} {args.lines / best_time(fn, data) / 1000:6.1f}k lines/s")
+
+    check_splice(lines[:1000])
+    print("Spliced output decodes identically to the merged dict")
+
+
+if __name__ == "__main__":
+    main()
@@ -2,14 +2,51 @@ import contextlib
 
 from agent.misc.env import get_env_vars
 
-from .bridge import Bridge
+from . import metrics
+from .bridge import Bridge, MultiBridge
 from .misc import get_cli_args, init_logging
+from .mqtt import DEFAULT_QOS, PublishConf
+from .spool import SpoolConf
 
 
 def main() -> None:
     args = get_cli_args()
     init_logging(args.log_level)
-    bridge = Bridge(**get_env_vars(), serial_port=args.serial_port, baud_rate=args.baud_rate)
+    spool = SpoolConf(dir=args.spool_dir, max_bytes=args.spool_max_bytes, max_age_s=args.spool_max_age_s)
+    publish = PublishConf(
+        qos={**DEFAULT_QOS, **args.qos},
+        batch_max=args.batch_max,
+        max_inflight=args.max_inflight,
+        max_queued=args.max_queued,
+    )
+
+    if args.metrics_port:
+        metrics.serve(args.metrics_host, args.metrics_port)
+
+    bridge: Bridge | MultiBridge
+    if args.port_glob is not None:
+        bridge = MultiBridge(
+            **get_env_vars(),
+            port_glob=args.port_glob,
+            baud_rate=args.baud_rate,
+            summary_only=args.summary_only,
+            spool=spool,
+            publish=publish,
+            metrics_interval=args.metrics_interval,
+            capture_dir=args.capture_dir,
+        )
+    else:
+        assert args.serial_port is not None  # noqa: S101 - argparse group is required
+        bridge = Bridge(
+            **get_env_vars(),
+            serial_port=args.serial_port,
+            baud_rate=args.baud_rate,
+            summary_only=args.summary_only,
+            spool=spool,
+            publish=publish,
+            metrics_interval=args.metrics_interval,
+            capture_dir=args.capture_dir,
+        )
 
     with contextlib.suppress(KeyboardInterrupt):
         bridge.run()
@@ -1,360 +1,381 @@
 """
-UART-MQTT Bridge for Whac-A-Mole embedded device.
+UART-MQTT Bridge for Whac-A-Mole embedded devices.
 
-This module bridges communication between the MAX32655 embedded device
+This module bridges communication between MAX32655 embedded devices
 (via UART/serial) and the MQTT broker (for dashboard integration).
 
 Data Flow:
     Device -> UART -> Bridge -> MQTT -> Dashboard
     Dashboard -> MQTT -> Bridge -> UART -> Device
 
-Protocol:
-    - Device sends JSONL events over UART (one JSON object per line)
-    - Bridge publishes events to MQTT topic: whac/<device_id>/game_events
-    - Dashboard sends commands via MQTT topic: whac/<device_id>/cmd
-    - Bridge forwards single-byte commands to device via UART
+Modes:
+    - Bridge: One port, reconnects to the same port if it drops (10 minute timeout). The port
+      may be any transport (serial, tcp://, pty:, mem://, replay://; see transport.py)
+    - MultiBridge: Watches for serial ports matching a glob; each attached board gets its own
+      DevicePipeline (identified via b"I") and all share one MQTT connection. Pipelines are
+      torn down on detach & respawned when the board re-enumerates (on any matching port)
 
-Connection Handling:
-    - Auto-reconnect on serial disconnect (10 minute timeout)
-    - Heartbeat messages every 20s to indicate bridge is alive
-    - Graceful cleanup on shutdown (unpause, send 'D' to start buffering)
+Port changes are picked up from hot-plug events (inotify on the port's directory, see hotplug.py)
+within milliseconds, falling back to polling where that's unavailable. Time from a serial error
+or detach to the device being served again is recorded as the "recover" latency stage.
+
+Both publish bridge metrics (counters & latency percentiles, see metrics.py) every
+metrics_interval secs to <namespace>/<client_id>/metrics. With capture_dir set, each device's
+raw traffic is also recorded there (see capture.py) for replay with replay://<file>.
+
+See device.py for the per-device protocol & pipeline.
 """
 
 from __future__ import annotations
 
-import json
+import asyncio
+import contextlib
 import logging
+import os
+import socket
 import time
-from json import JSONDecodeError
-from typing import TYPE_CHECKING, Any, ClassVar, Final
-
-from rich.status import Status
-from serial import Serial, SerialException
-from serial.tools import list_ports
+from typing import TYPE_CHECKING, Final
 
+from agent.device import DevicePipeline
+from agent.hotplug import HotplugMonitor
+from agent.metrics import METRICS
 from agent.mqtt import MqttClient
+from agent.transport import CaptureTransport, SerialTransport, make_transport
 
 if TYPE_CHECKING:
+    from collections.abc import AsyncIterator
     from logging import Logger
+    from pathlib import Path
+
+    from agent.mqtt import PublishConf
+    from agent.spool import SpoolConf
+    from agent.transport import Transport
+
+# Port polling interval for hot-plug discovery (without hot-plug events)
+HOTPLUG_POLL_INTERVAL: Final = 1
 
+# Safety-net rescan interval when hot-plug events are available
+HOTPLUG_RESCAN_INTERVAL: Final = 30
 
-RECONNECT_TIMEOUT: Final = 600  # 10 min sto reconnect before giving up
-RECONNECT_RETRY_INTERVAL: Final = 2  # Secs between reconnect attempts
+# Secs before retrying a matching port that didn't identify (e.g. not a Whac-A-Mole board)
+IDENTIFY_RETRY_INTERVAL: Final = 30
+
+
+@contextlib.asynccontextmanager
+async def _publishing_metrics(mqtt: MqttClient, interval: int) -> AsyncIterator[None]:
+    """Publish bridge metrics every interval secs while in context (0 = never)."""
+
+    async def publish_periodically() -> None:
+        while True:
+            await asyncio.sleep(interval)
+            mqtt.publish_metrics(METRICS.snapshot())
 
-DEVICE_ID_TIMEOUT: Final = 10  # Secs to wait for identify response
-DEVICE_ID_RETRY_INTERVAL: Final = 0.1
+    if not interval:
+        yield
+        return
 
-# Heartbeat to indicate bridge is alive (MQTT retained message)
-HEARTBEAT_INTERVAL: Final = 20
+    task = asyncio.create_task(publish_periodically(), name="metrics")
+    try:
+        yield
+    finally:
+        task.cancel()
+        with contextlib.suppress(asyncio.CancelledError):
+            await task
 
 
 class Bridge:
     """
-    Bridges UART device to MQTT broker.
+    Bridges a single UART device to MQTT broker.
 
     Manages the full lifecycle of device communication:
-        1. Connect to serial port
-        2. Request device ID (identify handshake)
-        3. Setup MQTT with device-specific topics
-        4. Forward events (Device -> MQTT) and commands (MQTT -> Device)
-        5. Handle disconnects with auto-reconnect
-        6. Graceful cleanup on shutdown
+        1. Connect to serial port & identify device
+        2. Setup MQTT with device-specific topics (& last will)
+        3. Run device pipeline until device is gone
+        4. Graceful cleanup on shutdown
     """
 
-    TOPIC_NAMESPACE: ClassVar = "whac"
-    BYTES_ENCODING: ClassVar = "ascii"
-
-    # Format: {byte: description} for logging/validation
-    BOARD_COMMANDS: ClassVar[dict[bytes, str]] = {
-        b"I": "identify",
-        b"P": "pause toggle",
-        b"R": "reset game",
-        b"S": "start game",
-        b"D": "disconnect (start buffering)",
-        b"1": "set level 1",
-        b"2": "set level 2",
-        b"3": "set level 3",
-        b"4": "set level 4",
-        b"5": "set level 5",
-        b"6": "set level 6",
-        b"7": "set level 7",
-        b"8": "set level 8",
-    }
-
     mqtt_broker: str
     mqtt_port: int
     serial_port: str
     baud_rate: int
-    device_id: str
+    summary_only: bool
+    spool: SpoolConf | None
+    publish: PublishConf | None
+    metrics_interval: int
+    capture_dir: Path | None
 
     _log: Logger
-    _serial: Serial
-    _mqtt: MqttClient
 
-    def __init__(self, *, mqtt_broker: str, mqtt_port: int, serial_port: str, baud_rate: int) -> None:
+    def __init__(
+        self,
+        *,
+        mqtt_broker: str,
+        mqtt_port: int,
+        serial_port: str,
+        baud_rate: int,
+        summary_only: bool = False,
+        spool: SpoolConf | None = None,
+        publish: PublishConf | None = None,
+        metrics_interval: int = 0,
+        capture_dir: Path | None = None,
+    ) -> None:
         self.mqtt_broker = mqtt_broker
         self.mqtt_port = mqtt_port
         self.serial_port = serial_port
         self.baud_rate = baud_rate
-        self.device_id: str
+        self.summary_only = summary_only
+        self.spool = spool
+        self.publish = publish
+        self.metrics_interval = metrics_interval
+        self.capture_dir = capture_dir
 
         self._log = logging.getLogger("Bridge")
-        self._serial: Serial
-        self._mqtt: MqttClient
-        self._paused: bool = False
-
-    # ==================== Public API ====================
 
     def run(self) -> None:
         try:
-            if not self._connect_to_serial():
-                return
+            asyncio.run(self._run())
+        finally:
+            self._log.info("Shutdown complete")
+
+    async def _run(self) -> None:
+        try:
+            transport = make_transport(self.serial_port, self.baud_rate)
+            if self.capture_dir is not None:
+                transport = CaptureTransport(transport, self.capture_dir, baud_rate=self.baud_rate)
+        except ValueError as e:
+            self._log.critical("Invalid port: %s", e)
+            return
+        except OSError as e:
+            self._log.critical("Can't start capture: %s", e)
+            return
 
-            if not self._request_device_id():
-                self._serial.close()
+        device = DevicePipeline(transport=transport, summary_only=self.summary_only)
+        try:
+            if not await device.open():
                 return
 
             # Setup MQTT now that we have device_id for topic routing
-            self._mqtt = MqttClient(
+            client_id = f"bridge-{device.device_id}"
+            mqtt = MqttClient(
                 broker=self.mqtt_broker,
                 port=self.mqtt_port,
-                device_id=self.device_id,
-                topic=Bridge.TOPIC_NAMESPACE,
-                on_command=self._handle_command,
-                last_will="offline",  # Auto-publish on ungraceful disconnect
+                client_id=client_id,
+                topic=DevicePipeline.TOPIC_NAMESPACE,
+                on_command=lambda _, payload: device.on_command(payload),
+                spool=self.spool.open(client_id) if self.spool is not None else None,
+                publish=self.publish,
             )
+            mqtt.set_last_will(device.device_id, "offline")  # Auto-publish on ungraceful disconnect
+            mqtt.add_device(device.device_id)
 
-            if not self._mqtt.connect():
-                self._serial.close()
+            if not await asyncio.to_thread(mqtt.connect):
                 return
 
-            self._mqtt.publish_state("online").wait_for_publish()
-
             try:
-                self._read_events()
+                async with _publishing_metrics(mqtt, self.metrics_interval):
+                    await device.run(mqtt)
             finally:
-                self._cleanup_before_disconnect()
-                self._mqtt.publish_state("offline").wait_for_publish()
-                self._mqtt.disconnect()
-                self._serial.close()
-
+                mqtt.disconnect()
         finally:
-            self._log.info("Shutdown complete")
-
-    # ==================== Event Processing ====================
-
-    def _read_events(self) -> None:
-        """Read JSONL events from serial and publish to MQTT.
-
-        - Normal events: Parse JSON, publish to MQTT
-        - Serial errors: Attempt reconnect or exit
-        """
-        self._log.debug("Listening for events")
-
-        last_heartbeat = time.monotonic()
-        while True:
-            try:
-                jsonl = self._serial_read_jsonl()
-            except SerialException:
-                if not self._device_connected():
-                    self._log.critical("Device unplugged, exiting")
-                elif self._wait_for_reconnect():
-                    self._mqtt.publish_state("online").wait_for_publish()
-                    continue
-                else:
-                    self._mqtt.publish_state("serial_error").wait_for_publish()
-                return
-            except (UnicodeDecodeError, JSONDecodeError):
-                # Malformed data - skip and continue (logged in _serial_read_jsonl)
-                pass
-            else:
-                if jsonl is not None:
-                    self._mqtt.publish_event(jsonl)
-
-            now = time.monotonic()
-            if now - last_heartbeat >= HEARTBEAT_INTERVAL:
-                self._mqtt.publish_state("online")
-                last_heartbeat = now
-
-    def _wait_for_reconnect(self) -> bool:
-        """Wait for serial device to reconnect. Returns True if reconnected."""
-
-        self._log.debug("Waiting for device to reconnect")
-
-        with Status("") as status:
-            start = time.monotonic()
-            while (elapsed := time.monotonic() - start) < RECONNECT_TIMEOUT:
-                left = int(RECONNECT_TIMEOUT - elapsed)
-                status.update(f"  [dim]>[/] Reconnecting ({left}s remaining)")
-                try:
-                    self._serial = Serial(self.serial_port, self.baud_rate, timeout=0.1)
-                    self._serial.reset_input_buffer()
-                except (OSError, SerialException, BaseException):  # noqa: BLE001
-                    time.sleep(RECONNECT_RETRY_INTERVAL)
-                else:
-                    status.stop()
-                    self._log.info("Reconnected to %s", self.serial_port)
-                    # Re-identify to flush any buffered events on device
-                    self._serial_write(b"I", ctx="re-identifying after reconnect")
-                    return True
-
-        self._log.critical("Failed to reconnect (timeout after %ds)", RECONNECT_TIMEOUT)
-        return False
-
-    def _request_device_id(self) -> bool:
-        """Send identify command and wait for response. Returns True on success."""
-
-        self._log.debug("Requesting device ID")
-        if not self._serial_write(b"I", ctx="requesting device ID"):  # Identify
-            self._log.critical("Failed to get device ID")
-            return False
-
-        start = time.monotonic()
-        while (time.monotonic() - start) < DEVICE_ID_TIMEOUT:
-            try:
-                jsonl = self._serial_read_jsonl(ctx="getting device ID")
-            except (SerialException, UnicodeDecodeError):
-                return False
-            except JSONDecodeError:
-                continue  # Could be a partial line (e.g. if connecting while device middle of game)
-
-            if jsonl is None:
-                continue
-
-            if jsonl.get("event_type") == "identify" and "device_id" in jsonl:
-                self.device_id = jsonl["device_id"]
-                self._log.info("Device ID received: [bright_green]%s[/]", self.device_id)
-                return True
-
-            time.sleep(DEVICE_ID_RETRY_INTERVAL)
-
-        self._log.critical("Failed to get device ID (timeout after %ds)", DEVICE_ID_TIMEOUT)
-        return False
-
-    def _handle_command(self, byte: bytes) -> None:
-        """Handle MQTT command (callback from MqttClient).
+            device.close()
 
-        Args:
-            byte: Single-byte MQTT Command
-        """
 
-        if byte not in Bridge.BOARD_COMMANDS:
-            self._log.warning("[MQTT -> Device] INVALID COMMAND: %r", byte)
-            return
-
-        desc = Bridge.BOARD_COMMANDS[byte]
-        self._log.info("[bright_white on grey30][MQTT -> Device][/] %r (%s)", byte, desc)
-
-        if not self._serial_write(byte):
-            return
-
-        match byte:
-            case b"P":
-                self._paused = not self._paused
-
-    def _connect_to_serial(self) -> bool:
-        """Connect to serial port. Returns True on success."""
-
-        self._log.debug("Connecting to serial port %s (%d baud)", self.serial_port, self.baud_rate)
-        try:
-            self._serial = Serial(self.serial_port, self.baud_rate, timeout=0.1)
-            self._serial.reset_input_buffer()
-        except (OSError, SerialException, BaseException) as e:  # noqa: BLE001
-            self._log.critical("Failed to connect to serial port: %s", e)
-            return False
+class MultiBridge:
+    """
+    Bridges every attached UART device matching a port glob over one MQTT connection.
 
-        self._log.info("Connected to %s", self.serial_port)
-        return True
+    A watcher rescans the serial port list on hot-plug events (or polls); each new matching port
+    gets a DevicePipeline task (identify, then run), cancelled when the port disappears. Commands are routed by the
+    device ID in their topic.
 
-    def _serial_read_jsonl(self, *, ctx: str = "reading line") -> dict[str, Any] | None:
-        """Read line (as bytes) from serial device and decode as JSON.
+    With a shared connection the broker can only hold one last will, so none is set: a bridge
+    crash is picked up by the dashboard's device timeout instead.
+    """
 
-        Args:
-            ctx: Context for logging
+    mqtt_broker: str
+    mqtt_port: int
+    port_glob: str
+    baud_rate: int
+    summary_only: bool
+    spool: SpoolConf | None
+    publish: PublishConf | None
+    metrics_interval: int
+    capture_dir: Path | None
 
-        Returns:
-            Decoded JSON line from serial device. If empty line (no bytes), returns None
+    _log: Logger
+    _mqtt: MqttClient
+    _tasks: dict[str, asyncio.Task[None]]  # Serial port -> pipeline task
+    _devices: dict[str, DevicePipeline]  # Device ID -> pipeline currently serving it
+    _retry_after: dict[str, float]  # Serial port -> monotonic time it may be retried
+    _detached_at: dict[str, float]  # Device ID -> perf_counter() its pipeline ended (for recover time)
+
+    def __init__(
+        self,
+        *,
+        mqtt_broker: str,
+        mqtt_port: int,
+        port_glob: str,
+        baud_rate: int,
+        summary_only: bool = False,
+        spool: SpoolConf | None = None,
+        publish: PublishConf | None = None,
+        metrics_interval: int = 0,
+        capture_dir: Path | None = None,
+    ) -> None:
+        self.mqtt_broker = mqtt_broker
+        self.mqtt_port = mqtt_port
+        self.port_glob = port_glob
+        self.baud_rate = baud_rate
+        self.summary_only = summary_only
+        self.spool = spool
+        self.publish = publish
+        self.metrics_interval = metrics_interval
+        self.capture_dir = capture_dir
 
-        Raises:
-            SerialException: Serial read error
-            UnicodeDecodeError: Decode error
-            JSONDecodeError: Invalid JSON
-        """
+        self._log = logging.getLogger("Bridge")
+        self._tasks = {}
+        self._devices = {}
+        self._retry_after = {}
+        self._detached_at = {}
 
+    def run(self) -> None:
         try:
-            line_bytes = self._serial.readline()
-        except SerialException as e:
-            self._log.error("Serial error while %s: %s", ctx, e)
-            raise
+            asyncio.run(self._run())
+        finally:
+            self._log.info("Shutdown complete")
 
-        if not line_bytes:
-            return None
+    async def _run(self) -> None:
+        client_id = f"bridge-{socket.gethostname()}"
+        self._mqtt = MqttClient(
+            broker=self.mqtt_broker,
+            port=self.mqtt_port,
+            client_id=client_id,
+            topic=DevicePipeline.TOPIC_NAMESPACE,
+            on_command=self._on_command,
+            spool=self.spool.open(client_id) if self.spool is not None else None,
+            publish=self.publish,
+        )
+
+        if not await asyncio.to_thread(self._mqtt.connect):
+            return
 
+        self._log.info("Watching for serial ports matching [cyan]%s[/]", self.port_glob)
         try:
-            line = line_bytes.decode(Bridge.BYTES_ENCODING).strip()
-        except UnicodeDecodeError as e:
-            self._log.error("Decode error (%s) while %s: %s", Bridge.BYTES_ENCODING, ctx, e)
-            raise
-
+            async with _publishing_metrics(self._mqtt, self.metrics_interval):
+                await self._watch_ports()
+        finally:
+            tasks = list(self._tasks.values())
+            for task in tasks:
+                task.cancel()
+            await asyncio.gather(*tasks, return_exceptions=True)
+            self._mqtt.disconnect()
+
+    async def _watch_ports(self) -> None:
+        """Rescan serial ports on every hot-plug event (or poll interval), until cancelled."""
+
+        with HotplugMonitor([self.port_glob]) as hotplug:
+            self._log.info("Hot-plug detection: %s", hotplug.describe())
+            interval = HOTPLUG_POLL_INTERVAL if hotplug.source == "poll" else HOTPLUG_RESCAN_INTERVAL
+            while True:
+                await self._rescan_ports()
+                await hotplug.wait_async(interval)
+
+    async def _rescan_ports(self) -> None:
+        """Start pipelines for new matching ports & cancel those of detached ones."""
+
+        ports = await asyncio.to_thread(self._scan_ports)
+        now = time.monotonic()
+
+        for port in sorted(ports - self._tasks.keys()):
+            # A just-created node may not be usable until udev sets its permissions (an event follows)
+            if self._retry_after.get(port, 0) <= now and _port_accessible(port):
+                self._tasks[port] = asyncio.create_task(self._serve(port), name=port)
+
+        for port in self._tasks.keys() - ports:
+            if not (task := self._tasks[port]).cancelling():
+                self._log.info("Serial port %s detached", port)
+                task.cancel()
+
+        # Forget retry backoff for ports that went away (a re-plugged board is tried at once)
+        for port in self._retry_after.keys() - ports:
+            del self._retry_after[port]
+
+    async def _serve(self, port: str) -> None:
+        """Identify device on port & run its pipeline until detach (task per port)."""
+
+        transport: Transport = SerialTransport(port, self.baud_rate)
+        if self.capture_dir is not None:
+            try:
+                transport = CaptureTransport(transport, self.capture_dir, baud_rate=self.baud_rate)
+            except OSError as e:
+                self._log.error("Can't capture %s (bridging without): %s", port, e)
+
+        device = DevicePipeline(
+            transport=transport,
+            summary_only=self.summary_only,
+            reconnect=False,  # Watcher respawns on re-attach (possibly on a different port)
+            log_port=True,
+        )
         try:
-            jsonl = json.loads(line)
-            if not isinstance(jsonl, dict):
-                msg = f"expected dict, got {type(jsonl)}"
-                raise JSONDecodeError(msg, doc=jsonl, pos=0)  # noqa: TRY301
-
-        except JSONDecodeError as e:
-            self._log.warning(
-                "[bright_yellow on grey30][IGNORING][/] Invalid JSON received (%s): %s (error: %s)",
-                ctx,
-                line,
-                e,
-            )
-            raise
-
-        return jsonl
+            if not await device.open():
+                self._retry_after[port] = time.monotonic() + IDENTIFY_RETRY_INTERVAL
+                return
 
-    def _serial_write(self, byte: bytes, *, ctx: str | None = None) -> bool:
-        """Write byte to serial device.
+            self._claim(device)
+            try:
+                await device.run(self._mqtt)
+            finally:
+                self._release(device)
+        except Exception:  # noqa: BLE001 - one board failing mustn't take the others down
+            self._log.exception("Pipeline for %s failed", port)
+        finally:
+            device.close()
+            del self._tasks[port]
+            if device.superseded:  # Port still listed but board answers elsewhere - don't flap
+                self._retry_after[port] = time.monotonic() + IDENTIFY_RETRY_INTERVAL
 
-        Args:
-            byte: Command byte to write to serial device
-            ctx: Context for logging
+    def _claim(self, device: DevicePipeline) -> None:
+        """Register device as serving its ID, superseding a stale pipeline for the same board."""
 
-        Returns:
-            True on success
-        """
+        if (old := self._devices.get(device.device_id)) is not None:
+            self._log.info("Device %s moved from %s to %s", device.device_id, old.port, device.port)
+            old.superseded = True
+            if (task := self._tasks.get(old.port)) is not None:
+                task.cancel()
 
-        try:
-            self._serial.write(byte)
-        except SerialException as e:
-            ctx = f"writing {byte!r}" if ctx is None else ctx
-            self._log.error("Serial error while %s: %s", ctx, e)
-            return False
+        self._devices[device.device_id] = device
+        self._mqtt.add_device(device.device_id)
+        self._log.info("Serving %d device(s)", len(self._devices))
 
-        return True
+        if (detached_at := self._detached_at.pop(device.device_id, None)) is not None:
+            recovered_in = time.perf_counter() - detached_at
+            self._log.info("Device %s back after %.3fs", device.device_id, recovered_in)
+            METRICS.observe("recover", recovered_in)
 
-    def _device_connected(self) -> bool:
-        """Return True if serial device is physically connected."""
+    def _release(self, device: DevicePipeline) -> None:
+        """Unregister device (unless a newer pipeline has already claimed its ID)."""
 
-        available = [p.device for p in list_ports.comports()]
-        return self.serial_port in available
+        if self._devices.get(device.device_id) is not device:
+            return
 
-    def _cleanup_before_disconnect(self) -> None:
-        """Send unpause and disconnect command before disconnecting.
+        del self._devices[device.device_id]
+        self._mqtt.remove_device(device.device_id)
+        self._detached_at[device.device_id] = time.perf_counter()
+        self._log.info("Serving %d device(s)", len(self._devices))
 
-        Only sends commands if device is still physically connected.
-        If unplugged, device has reset anyway so no point sending commands.
-        """
+    def _on_command(self, device_id: str, payload: bytes) -> None:
+        """Route MQTT command to device's pipeline (callback from MqttClient, runs in paho's thread)."""
 
-        if not self._device_connected():
-            self._log.debug("Skipping cleanup commands")
+        if (device := self._devices.get(device_id)) is None:
+            self._log.warning("[MQTT -> Device] Command for unknown device %s: %r", device_id, payload)
             return
+        device.on_command(payload)
+
+    def _scan_ports(self) -> set[str]:
+        """Return serial ports matching the glob."""
+        return set(SerialTransport.scan(self.port_glob))
 
-        if self._paused:
-            self._log.info("[bright_white on grey30][Agent -> Device][/] Unpausing device before disconnect")
-            if self._serial_write(b"P", ctx="attempting to unpause device"):
-                self._paused = False
 
-        # Notify device to start buffering events
-        self._log.info("[bright_white on grey30][Agent -> Device][/] Sending disconnect command")
-        self._serial_write(b"D", ctx="attempting to disconnect device")
+def _port_accessible(port: str) -> bool:
+    """Return True if port's device node can be opened read/write (always True without nodes, e.g. COM)."""
+    return os.name != "posix" or os.access(port, os.R_OK | os.W_OK)
@@ -0,0 +1,108 @@
+"""
+Capture file format for raw device traffic (see CaptureTransport & ReplayTransport in transport.py).
+
+Every chunk read from or written to a device is stored with its monotonic time since the
+capture started, so a field issue can be replayed through the bridge byte-for-byte and at the
+original pace (or faster).
+
+    header   b"WHACCAP" + version byte, u32 metadata length, metadata (JSON)
+    record   u64 t_us, u8 kind, u32 length, data      (little-endian)
+
+Kinds: RX (device -> bridge), TX (bridge -> device) & OPEN (transport (re)opened, no data).
+Records are per chunk (not per line), so overhead stays small for bursts.
+"""
+
+from __future__ import annotations
+
+import json
+import struct
+import threading
+import time
+from enum import IntEnum
+from typing import IO, TYPE_CHECKING, Any, ClassVar, NamedTuple
+
+if TYPE_CHECKING:
+    from collections.abc import Iterator
+    from pathlib import Path
+
+
+class CaptureFormatError(ValueError):
+    """File isn't a (supported) capture."""
+
+
+class Kind(IntEnum):
+    RX = 0
+    TX = 1
+    OPEN = 2
+
+
+class Record(NamedTuple):
+    t_us: int  # Monotonic microseconds since capture start
+    kind: Kind
+    data: bytes
+
+
+_MAGIC = b"WHACCAP\x01"
+_META_LEN = struct.Struct("<I")
+_RECORD = struct.Struct("<QBI")
+
+
+class CaptureWriter:
+    """Appends records to a capture file (thread-safe; flushed per record so a crash loses nothing)."""
+
+    path: Path
+
+    def __init__(self, path: Path, meta: dict[str, Any]) -> None:
+        self.path = path
+        self._lock = threading.Lock()
+        self._t0 = time.monotonic_ns()
+
+        path.parent.mkdir(parents=True, exist_ok=True)
+        self._file: IO[bytes] | None = path.open("wb")
+        meta_json = json.dumps(meta).encode()
+        self._file.write(_MAGIC + _META_LEN.pack(len(meta_json)) + meta_json)
+        self._file.flush()
+
+    def write(self, kind: Kind, data: bytes = b"") -> None:
+        t_us = (time.monotonic_ns() - self._t0) // 1000
+        with self._lock:
+            if self._file is None:
+                return
+            self._file.write(_RECORD.pack(t_us, kind, len(data)) + data)
+            self._file.flush()
+
+    def close(self) -> None:
+        with self._lock:
+            if self._file is not None:
+                self._file.close()
+                self._file = None
+
+
+class CaptureReader:
+    """Reads a capture file's metadata & records."""
+
+    CHUNK: ClassVar = 64 * 1024
+
+    path: Path
+    meta: dict[str, Any]
+
+    def __init__(self, path: Path) -> None:
+        self.path = path
+        with path.open("rb") as f:
+            if f.read(len(_MAGIC)) != _MAGIC:
+                msg = f"{path} is not a capture file (or unsupported version)"
+                raise CaptureFormatError(msg)
+            (meta_len,) = _META_LEN.unpack(f.read(_META_LEN.size))
+            self.meta = json.loads(f.read(meta_len))
+            self._records_at = f.tell()
+
+    def records(self) -> Iterator[Record]:
+        """Yield records in order (a truncated final record, e.g. from a crash, is ignored)."""
+
+        with self.path.open("rb", buffering=CaptureReader.CHUNK) as f:
+            f.seek(self._records_at)
+            while len(head := f.read(_RECORD.size)) == _RECORD.size:
+                t_us, kind, length = _RECORD.unpack(head)
+                if len(data := f.read(length)) < length:
+                    return
+                yield Record(t_us, Kind(kind), data)
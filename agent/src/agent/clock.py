@@ -0,0 +1,134 @@
+"""
+NTP-style clock synchronisation between bridge and device.
+
+The device stamps every event with its tick count ("t", ms since boot). To turn that into
+wall-clock time the bridge periodically sends a sync request (b"Y"); the device replies with
+the tick captured in its UART ISR. Each exchange gives one sample:
+
+    t0 = host send time, t3 = host receive time, d = device tick (somewhere in [t0, t3])
+    offset = d - (t0 + t3) / 2        error <= (t3 - t0) / 2
+
+Samples are taken against the monotonic clock (immune to host wall-clock steps) and mapped
+to wall-clock time only at conversion. A linear fit over the low-RTT samples estimates the
+device oscillator's drift relative to the host.
+"""
+
+from __future__ import annotations
+
+import time
+from collections import deque
+from dataclasses import dataclass
+from typing import ClassVar, Final, TypedDict
+
+# Samples with RTT above this multiple of the best RTT are ignored (queued behind other output)
+_RTT_FILTER_FACTOR: Final = 2.0
+
+# Minimum time span (ms) covered by samples before drift is estimated
+_MIN_DRIFT_SPAN_MS: Final = 10_000
+
+
+class ClockReport(TypedDict):
+    offset_ms: int  # Wall-clock time (ms since Epoch) at device tick 0 (i.e. device boot)
+    drift_ppm: float  # Device clock rate error vs host (+ve = device runs fast)
+    err_ms: float  # Error bound of conversions (half the best RTT)
+    samples: int
+
+
+@dataclass(frozen=True, slots=True)
+class _Sample:
+    host_ms: float  # Monotonic midpoint of the exchange
+    device_ms: int
+    rtt_ms: float
+
+
+class ClockSync:
+    """Estimate device-tick -> wall-clock mapping from sync request/reply pairs."""
+
+    MAX_SAMPLES: ClassVar = 16
+    REPLY_TIMEOUT_MS: ClassVar = 1000
+
+    _samples: deque[_Sample]
+    _pending_since: float | None
+
+    def __init__(self) -> None:
+        self._samples = deque(maxlen=ClockSync.MAX_SAMPLES)
+        self._pending_since = None
+        self._slope = 1.0
+        self._intercept = 0.0
+        self._err_ms = 0.0
+
+    def reset(self) -> None:
+        """Forget all samples (device may have rebooted, restarting its tick count)."""
+        self._samples.clear()
+        self._pending_since = None
+
+    def request_sent(self) -> None:
+        """Record send time of a sync request (call right after writing b"Y")."""
+        self._pending_since = _mono_ms()
+
+    def reply_received(self, device_ms: int) -> bool:
+        """Record device's reply to the outstanding request. Returns True if sample was used."""
+
+        now = _mono_ms()
+        sent = self._pending_since
+        self._pending_since = None
+        if sent is None or now - sent > ClockSync.REPLY_TIMEOUT_MS:
+            return False
+
+        # Device tick wrapped (~49.7 days uptime) or device rebooted - start over
+        if self._samples and device_ms < self._samples[-1].device_ms:
+            self._samples.clear()
+
+        self._samples.append(_Sample(host_ms=(sent + now) / 2, device_ms=device_ms, rtt_ms=now - sent))
+        self._fit()
+        return True
+
+    def to_wall_ms(self, device_ms: int) -> int | None:
+        """Convert a device tick to wall-clock ms since the Epoch (None if not yet synced)."""
+
+        if not self._samples:
+            return None
+
+        host_mono = (device_ms - self._intercept) / self._slope
+        return round(host_mono + (time.time() * 1000 - _mono_ms()))
+
+    def report(self) -> ClockReport | None:
+        """Return the current offset/drift estimate (None if not yet synced)."""
+
+        boot_wall = self.to_wall_ms(0)
+        if boot_wall is None:
+            return None
+
+        return {
+            "offset_ms": boot_wall,
+            "drift_ppm": round((self._slope - 1) * 1e6, 1),
+            "err_ms": round(self._err_ms, 1),
+            "samples": len(self._samples),
+        }
+
+    def _fit(self) -> None:
+        """Fit device_ms = slope * host_ms + intercept over the low-RTT samples."""
+
+        best_rtt = min(s.rtt_ms for s in self._samples)
+        good = [s for s in self._samples if s.rtt_ms <= max(best_rtt * _RTT_FILTER_FACTOR, 1.0)]
+        self._err_ms = best_rtt / 2
+
+        span = good[-1].host_ms - good[0].host_ms
+        if len(good) < 2 or span < _MIN_DRIFT_SPAN_MS:  # noqa: PLR2004
+            # Not enough baseline for drift - anchor on the tightest sample
+            anchor = min(good, key=lambda s: s.rtt_ms)
+            self._slope = 1.0
+            self._intercept = anchor.device_ms - anchor.host_ms
+            return
+
+        n = len(good)
+        mean_h = sum(s.host_ms for s in good) / n
+        mean_d = sum(s.device_ms for s in good) / n
+        var_h = sum((s.host_ms - mean_h) ** 2 for s in good)
+        cov = sum((s.host_ms - mean_h) * (s.device_ms - mean_d) for s in good)
+        self._slope = cov / var_h
+        self._intercept = mean_d - self._slope * mean_h
+
+
+def _mono_ms() -> float:
+    return time.monotonic() * 1000
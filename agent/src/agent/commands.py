@@ -0,0 +1,200 @@
+"""
+Dashboard -> device command tracking: IDs, coalescing & acknowledgements.
+
+Commands arrive on whac/<device_id>/commands as a bare command byte (e.g. b"5") or as JSON
+{"cmd": "5", "id": "<request id>"}. On the wire each is tagged b"#" + ID byte + command
+(IDs 0x80-0xFF, which older firmware ignores), and the firmware replies
+
+    {"event_type": "cmd_ack", "id": N, "ok": true}
+
+once the command is applied (ok = false if it was dropped, e.g. the device's command queue
+was full). At most WINDOW commands are unacknowledged at a time so that queue can't overflow;
+the rest wait here and are coalesced while they wait:
+
+    1-8   supersedes a waiting level change (only the last one matters)
+    P     cancels a waiting P (two toggles are a no-op)
+    S     supersedes a waiting S
+    R     supersedes waiting level changes, S & R (the device discards them on reset anyway)
+
+Every command gets one result, published to whac/<device_id>/command_acks (see CommandResult):
+applied, dropped, superseded, timeout (no ack within ACK_TIMEOUT; should the ack turn up later,
+an applied/dropped result follows), failed (serial write error), sent (firmware doesn't
+acknowledge commands, so they go out untagged) or invalid (not a device command; never sent).
+
+Ack support is the firmware's to declare: its identify reply carries "acks": true. Firmware
+that predates cmd_ack doesn't, and is never sent tags (a slow ack is a timeout, not a verdict).
+
+Not thread-safe: used from the pipeline's event loop only.
+"""
+
+from __future__ import annotations
+
+import itertools
+import time
+from collections import deque
+from dataclasses import dataclass
+from json import JSONDecodeError
+from typing import ClassVar, Literal, TypedDict
+
+from . import fastjson
+
+type CommandStatus = Literal["applied", "dropped", "superseded", "timeout", "failed", "sent", "invalid"]
+
+# Waiting commands made redundant by a new one: {new command: commands it supersedes}
+_LEVELS = frozenset(b"12345678")
+_SUPERSEDES: dict[int, frozenset[int]] = {
+    **dict.fromkeys(_LEVELS, _LEVELS),
+    ord("S"): frozenset(b"S"),
+    ord("R"): _LEVELS | frozenset(b"SR"),
+}
+
+
+class CommandResult(TypedDict):
+    cmd: str
+    id: str | None  # Request ID from the dashboard (None for bare-byte commands)
+    status: CommandStatus
+    rtt_ms: float | None  # Written to serial -> acked by device (applied/dropped only)
+    total_ms: float  # Received from MQTT -> this result
+
+
+@dataclass(slots=True)
+class Command:
+    cmd: bytes
+    request_id: str | None
+    received_at: float  # perf_counter() when received from MQTT
+    wire_id: int | None = None  # Tag byte (None if sent untagged)
+    sent_at: float | None = None  # perf_counter() when written to serial
+
+    @staticmethod
+    def parse(payload: bytes) -> Command:
+        """Parse an MQTT command payload (bare command byte or JSON).
+
+        Raises:
+            ValueError: Not a command byte or {"cmd": "<byte>", "id": ...} object
+        """
+
+        now = time.perf_counter()
+        if len(payload) == 1:
+            return Command(payload, None, now)
+
+        try:
+            obj = fastjson.loads(payload)
+        except (JSONDecodeError, UnicodeDecodeError) as e:
+            msg = f"not a command byte or JSON object: {payload[:32]!r}"
+            raise ValueError(msg) from e
+
+        cmd = obj.get("cmd") if isinstance(obj, dict) else None
+        if not isinstance(cmd, str) or len(cmd) != 1 or not cmd.isascii():
+            msg = f"expected {{'cmd': '<byte>', 'id': ...}}, got {payload[:64]!r}"
+            raise ValueError(msg)
+
+        request_id = obj.get("id")
+        return Command(cmd.encode(), None if request_id is None else str(request_id), now)
+
+    def result(self, status: CommandStatus) -> CommandResult:
+        now = time.perf_counter()
+        rtt = (now - self.sent_at) * 1000 if self.sent_at is not None and status in ("applied", "dropped") else None
+        return {
+            "cmd": self.cmd.decode(),
+            "id": self.request_id,
+            "status": status,
+            "rtt_ms": None if rtt is None else round(rtt, 2),
+            "total_ms": round((now - self.received_at) * 1000, 2),
+        }
+
+
+class CommandTracker:
+    """Queues, coalesces & tags one device's commands, matching acks to them (see module docstring)."""
+
+    WINDOW: ClassVar = 4  # Max unacked commands (device's cmd_queue holds 8)
+    ACK_TIMEOUT: ClassVar = 5.0  # Secs (game task only drains its queue between pops)
+    TAG: ClassVar = b"#"
+    ID_MIN: ClassVar = 0x80
+    ID_MAX: ClassVar = 0xFF
+
+    acks_supported: bool  # Set from the device's identify reply (False until then: commands go untagged)
+
+    def __init__(self) -> None:
+        self.acks_supported = False
+
+        self._waiting: deque[Command] = deque()
+        self._in_flight: dict[int, Command] = {}  # Wire ID -> command awaiting ack
+        self._timed_out: dict[int, Command] = {}  # Wire ID -> command reported as timeout (until ID reused)
+        self._ids = itertools.cycle(range(CommandTracker.ID_MIN, CommandTracker.ID_MAX + 1))
+
+    @property
+    def pending(self) -> int:
+        """Commands waiting or awaiting an ack."""
+        return len(self._waiting) + len(self._in_flight)
+
+    def submit(self, cmd: Command) -> list[CommandResult]:
+        """Queue command, returning results for waiting commands it made redundant (possibly itself)."""
+
+        superseded: list[Command] = []
+        if cmd.cmd == b"P" and (toggle := next((c for c in self._waiting if c.cmd == b"P"), None)):
+            self._waiting.remove(toggle)
+            superseded += (toggle, cmd)
+        else:
+            redundant = _SUPERSEDES.get(cmd.cmd[0], frozenset())
+            superseded += (c for c in self._waiting if c.cmd[0] in redundant)
+            self._waiting = deque(c for c in self._waiting if c.cmd[0] not in redundant)
+            self._waiting.append(cmd)
+
+        return [c.result("superseded") for c in superseded]
+
+    def next_to_send(self) -> tuple[Command, bytes] | None:
+        """Return next command & its wire bytes, if one is waiting & the ack window has room.
+
+        Call sent() or failed() once the bytes are written.
+        """
+
+        if not self._waiting:
+            return None
+        if not self.acks_supported:
+            cmd = self._waiting.popleft()
+            return cmd, cmd.cmd
+
+        if len(self._in_flight) >= CommandTracker.WINDOW:
+            return None
+
+        cmd = self._waiting.popleft()
+        cmd.wire_id = next(self._ids)
+        self._timed_out.pop(cmd.wire_id, None)  # ID reused - too late for that ack now
+        return cmd, CommandTracker.TAG + bytes([cmd.wire_id]) + cmd.cmd
+
+    def sent(self, cmd: Command) -> CommandResult | None:
+        """Record that command was written. Returns its result if it won't be acked (untagged)."""
+
+        cmd.sent_at = time.perf_counter()
+        if cmd.wire_id is None:
+            return cmd.result("sent")
+        self._in_flight[cmd.wire_id] = cmd
+        return None
+
+    @staticmethod
+    def failed(cmd: Command) -> CommandResult:
+        """Record that command couldn't be written."""
+        return cmd.result("failed")
+
+    def ack(self, wire_id: int, *, ok: bool) -> CommandResult | None:
+        """Match device's ack to its command. Returns the result (None if unknown/duplicate ID)."""
+
+        cmd = self._in_flight.pop(wire_id, None) or self._timed_out.pop(wire_id, None)
+        return None if cmd is None else cmd.result("applied" if ok else "dropped")
+
+    def expire(self) -> list[CommandResult]:
+        """Time out commands unacked for ACK_TIMEOUT (freeing their window slots)."""
+
+        deadline = time.perf_counter() - CommandTracker.ACK_TIMEOUT
+        expired = [c for c in self._in_flight.values() if c.sent_at is not None and c.sent_at < deadline]
+        for cmd in expired:
+            assert cmd.wire_id is not None  # noqa: S101 - in-flight commands are tagged
+            del self._in_flight[cmd.wire_id]
+            self._timed_out[cmd.wire_id] = cmd
+        return [c.result("timeout") for c in expired]
+
+    def next_expiry(self) -> float | None:
+        """Return secs until the oldest in-flight command times out (None if nothing is in flight)."""
+
+        sent = [c.sent_at for c in self._in_flight.values() if c.sent_at is not None]
+        return None if not sent else max(0.0, min(sent) + CommandTracker.ACK_TIMEOUT - time.perf_counter())
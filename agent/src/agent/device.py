@@ -0,0 +1,862 @@
+"""
+Per-device UART pipeline for the Whac-A-Mole bridge.
+
+One DevicePipeline owns one transport (serial port, TCP, pty or in-memory; see transport.py):
+it identifies the device, then shuttles lines to a (possibly shared) MqttClient and commands
+back to the device until the port goes away.
+
+Protocol:
+    - Device sends JSONL events over UART (one JSON object per line)
+    - Events are published to MQTT topic: whac/<device_id>/game_events
+    - Dashboard sends commands via MQTT topic: whac/<device_id>/commands
+    - Single-byte commands are forwarded to the device via UART, tagged with an ID the device
+      acks once applied; waiting commands are coalesced & results published to
+      whac/<device_id>/command_acks (see commands.py)
+    - Device status snapshots (b"?") are published retained to: whac/<device_id>/status
+    - Events carry device ticks ("t"); converted to wall-clock "ts" via clock sync (b"Y")
+
+Pipeline (asyncio):
+    - Serial reader task: blocking chunked reads run on the pipeline's own I/O threads; lines
+      are framed in place (see framing.py), validated and put on a bounded queue (backpressure
+      rather than loss if publishing lags). Raw line bytes are forwarded, not re-encoded
+    - Publisher task: drains the queue in batches, handing each batch to paho in a worker thread
+    - Command, keepalive, clock sync & heartbeat tasks run independently of the reader
+    - Queue depth & per-stage latency (see pipeline.py) are reported with every heartbeat
+    - Line/error/reconnect counters go to the process-wide metrics (see metrics.py)
+
+Connection Handling:
+    - Optional auto-reconnect on serial disconnect (10 minute timeout; single-port mode)
+    - Heartbeat messages every 20s to indicate bridge is alive (with clock & pipeline stats)
+    - Keepalive (b"K") every 2s so the device knows the bridge is alive (else it buffers)
+    - Device heartbeat every 5s; marked unresponsive (& re-identified) if silent for 12s
+    - Graceful cleanup on shutdown (unpause, send 'D' to start buffering)
+"""
+
+from __future__ import annotations
+
+import asyncio
+import contextlib
+import functools
+import logging
+import time
+from concurrent.futures import ThreadPoolExecutor
+from dataclasses import dataclass
+from json import JSONDecodeError
+from pathlib import Path
+from typing import TYPE_CHECKING, Any, ClassVar, Final, override
+
+from rich.status import Status
+
+from agent import fastjson
+from agent.clock import ClockSync
+from agent.commands import Command, CommandTracker
+from agent.framing import LineReader
+from agent.hotplug import HotplugMonitor
+from agent.metrics import METRICS
+from agent.pipeline import PipelineStats
+from agent.transport import TransportError
+
+if TYPE_CHECKING:
+    from collections.abc import Callable, MutableMapping
+
+    from agent.commands import CommandResult
+    from agent.mqtt import DevStatus, MqttClient
+    from agent.transport import Transport
+
+
+RECONNECT_TIMEOUT: Final = 600  # 10 min sto reconnect before giving up
+RECONNECT_RETRY_INTERVAL: Final = 2  # Max secs between reconnect attempts (sooner on a hot-plug event)
+
+DEVICE_ID_TIMEOUT: Final = 10  # Secs to wait for identify response
+DEVICE_ID_RETRY_INTERVAL: Final = 0.1
+
+# Heartbeat to indicate bridge is alive (MQTT retained message)
+HEARTBEAT_INTERVAL: Final = 20
+
+# Keepalive to device (must be well under AGENT_TIMEOUT_MS in emb/include/rtos_queues.h)
+KEEPALIVE_INTERVAL: Final = 2
+
+# Device considered stalled if no line received within this window (device heartbeats every 5s)
+DEVICE_STALL_TIMEOUT: Final = 12
+
+# Clock sync: burst on (re)connect, then one exchange every interval to track drift
+CLOCK_SYNC_BURST: Final = 5
+CLOCK_SYNC_INTERVAL: Final = 30
+CLOCK_SYNC_REPLY_TIMEOUT: Final = 0.5
+
+# Blocking serial I/O threads per device (one parked in read, one for writes/handshakes)
+SERIAL_IO_THREADS: Final = 2
+
+# Max wait for the broker to ack a state change (online/offline/serial_error)
+STATE_PUBLISH_TIMEOUT: Final = 2
+
+# Device -> MQTT event queue (reader blocks when full) & max events handed to paho at once
+EVENT_QUEUE_SIZE: Final = 256
+PUBLISH_BATCH_MAX: Final = 32
+
+
+@dataclass(frozen=True, slots=True)
+class _QueuedLine:
+    jsonl: dict[str, Any]
+    raw: bytes  # Line as received (forwarded as-is, with bridge fields spliced in)
+    ts: int | None  # Wall-clock ms of device tick (None if not synced)
+    read_at: float  # perf_counter() when read from serial
+    queued_at: float  # perf_counter() when queued
+
+
+class DevicePipeline:
+    """
+    Bridges one UART device to an MQTT broker.
+
+    Manages the device side of the lifecycle:
+        1. Connect to serial port
+        2. Request device ID (identify handshake) - see open()
+        3. Forward events (Device -> MQTT) and commands (MQTT -> Device) - see run()
+        4. Handle disconnects (auto-reconnect if enabled, else return)
+        5. Graceful cleanup on shutdown
+    """
+
+    TOPIC_NAMESPACE: ClassVar = "whac"
+
+    # Format: {byte: description} for logging/validation
+    BOARD_COMMANDS: ClassVar[dict[bytes, str]] = {
+        b"I": "identify",
+        b"P": "pause toggle",
+        b"R": "reset game",
+        b"S": "start game",
+        b"D": "disconnect (start buffering)",
+        b"K": "keepalive",
+        b"Q": "summary-only telemetry",
+        b"V": "verbose telemetry",
+        b"?": "status snapshot",
+        b"Y": "clock sync",
+        b"1": "set level 1",
+        b"2": "set level 2",
+        b"3": "set level 3",
+        b"4": "set level 4",
+        b"5": "set level 5",
+        b"6": "set level 6",
+        b"7": "set level 7",
+        b"8": "set level 8",
+    }
+
+    # Device -> bridge lines that are consumed here (not forwarded as game events)
+    CONTROL_EVENTS: ClassVar[frozenset[str]] = frozenset({"identify", "heartbeat", "status", "sync", "cmd_ack"})
+
+    transport: Transport
+    port: str  # Transport name (e.g. /dev/ttyACM0)
+    summary_only: bool
+    reconnect: bool
+    device_id: str
+    superseded: bool  # Set if device re-appeared on another port (don't publish "offline")
+
+    _log: logging.Logger | _PortLogAdapter
+    _mqtt: MqttClient
+    _loop: asyncio.AbstractEventLoop
+    _events: asyncio.Queue[_QueuedLine]
+    _cmd_wakeup: asyncio.Event  # Set when the command task has something to do (queued, acked, ...)
+    _cmd_results: list[CommandResult]  # Waiting to be published by the command task
+    _serial_ready: asyncio.Event  # Cleared while reconnecting (writers wait on it)
+
+    def __init__(
+        self,
+        *,
+        transport: Transport,
+        summary_only: bool = False,
+        reconnect: bool = True,
+        log_port: bool = False,
+    ) -> None:
+        self.transport = transport
+        self.port = transport.name
+        self.summary_only = summary_only
+        self.reconnect = reconnect
+        self.device_id: str
+        self.superseded = False
+
+        logger = logging.getLogger("Bridge")
+        self._log = _PortLogAdapter(logger, {"port": Path(self.port).name}) if log_port else logger
+        self._mqtt: MqttClient
+        self._io_pool = ThreadPoolExecutor(SERIAL_IO_THREADS, thread_name_prefix=f"serial-{Path(self.port).name}")
+        self._paused: bool = False  # As of the device's last status reply
+        self._clock = ClockSync()
+        self._cmds = CommandTracker()
+        self._stats = PipelineStats(EVENT_QUEUE_SIZE)
+        self._lines = LineReader()
+        self._held_lines: list[tuple[bytes, float]] = []  # (line, received_at) read while the reader wasn't running
+        self._stalled: bool = False
+        self._last_rx: float = 0.0
+        self._metrics_label = self.port  # Device ID once identified
+
+    # ==================== Public API ====================
+
+    async def open(self) -> bool:
+        """Open transport & identify device (sets device_id). Returns True on success."""
+
+        self._loop = asyncio.get_running_loop()
+        self._events = asyncio.Queue(maxsize=EVENT_QUEUE_SIZE)
+        self._cmd_wakeup = asyncio.Event()
+        self._cmd_results = []
+        self._serial_ready = asyncio.Event()
+
+        if not await self._io(self._open_transport):
+            return False
+
+        # Sync before identify, since identify flushes the device's offline buffer
+        await self._io(self._sync_clock_burst)
+        if not await self._io(self._request_device_id):
+            self.transport.close()
+            return False
+
+        return True
+
+    async def run(self, mqtt: MqttClient) -> None:
+        """Forward events/commands between device & MQTT until the device goes away (or cancelled).
+
+        Args:
+            mqtt: Connected MQTT client (may be shared with other pipelines)
+        """
+
+        self._mqtt = mqtt
+        try:
+            await asyncio.to_thread(self._publish_state_acked, "online")
+            await self._io(self._configure_device)
+            await self._run_pipeline()
+        finally:
+            # Runs on cancellation too (detach/Ctrl-C); shielded so a second cancel can't cut it short
+            await asyncio.shield(self._io(self._disconnect))
+
+    def on_command(self, payload: bytes) -> None:
+        """Queue MQTT command for the command task (thread-safe; called from paho's thread)."""
+        self._loop.call_soon_threadsafe(self._queue_command, payload)
+
+    def close(self) -> None:
+        """Close transport (if still open) & release the pipeline's serial I/O threads."""
+
+        self.transport.close()
+        self._io_pool.shutdown(wait=False, cancel_futures=True)
+
+    # ==================== Pipeline ====================
+
+    async def _run_pipeline(self) -> None:
+        """Run the reader until the device is gone, with publisher/command/timer tasks alongside.
+
+        Whatever was read before the device went away is published before returning.
+        """
+
+        self._reset_liveness()
+        self._serial_ready.set()
+
+        workers = [
+            asyncio.create_task(self._publish_events(), name="publisher"),
+            asyncio.create_task(self._forward_commands(), name="commands"),
+            asyncio.create_task(self._keep_device_alive(), name="keepalive"),
+            asyncio.create_task(self._sync_clock_periodically(), name="clock-sync"),
+            asyncio.create_task(self._publish_heartbeats(), name="heartbeat"),
+        ]
+
+        try:
+            await self._handle_held_lines()
+            await self._read_events()
+            await self._events.join()
+        finally:
+            for worker in workers:
+                worker.cancel()
+            await asyncio.gather(*workers, return_exceptions=True)
+
+    async def _read_events(self) -> None:
+        """Read JSONL lines from serial (chunked reads in a worker thread) & queue them for the publisher.
+
+        - Game events & status snapshots: Queued for the publisher
+        - Control lines (identify, heartbeat, sync): Handled here, never queued
+        - Serial errors: Attempt reconnect or return
+        """
+
+        self._log.debug("Listening for events")
+
+        received_at = time.perf_counter()
+        while True:
+            # Drain every buffered line before reading more (whatever the last fill() returned)
+            while (frame := self._lines.next_frame()) is not None:
+                with frame:  # Released before the next fill() compacts the buffer
+                    await self._handle_line(frame, received_at)
+
+            try:
+                n_bytes = await self._io(self._lines.fill, self.transport)
+            except TransportError as e:
+                self._log.error("Serial error while reading line: %s", e)
+                METRICS.inc("serial_errors", self._metrics_label)
+                if await self._recover_serial():
+                    continue
+                return
+
+            if n_bytes:
+                received_at = time.perf_counter()
+                METRICS.inc("bytes_read", self._metrics_label, n_bytes)
+
+    async def _handle_line(self, frame: memoryview, received_at: float) -> None:
+        """Decode a serial line & route it (queue for MQTT or handle locally).
+
+        Args:
+            frame: Raw line from serial (view into the reader's buffer; copied if queued)
+            received_at: perf_counter() when line's chunk was read
+        """
+
+        METRICS.inc("lines_read", self._metrics_label)
+        try:
+            jsonl = self._decode_jsonl(frame)
+        except (UnicodeDecodeError, JSONDecodeError):
+            return  # Malformed data - skip (logged in _decode_jsonl)
+
+        self._mark_device_alive()
+
+        event_type = jsonl.get("event_type")
+        if event_type == "sync":
+            self._on_clock_sync_reply(jsonl)
+            return
+        if event_type == "cmd_ack":
+            self._on_command_ack(jsonl)
+            return
+        if event_type == "identify":
+            self._on_identify(jsonl)
+            return
+        if event_type == "status":
+            self._paused = jsonl.get("paused") is True  # Device's word, not ours (a P may be nacked)
+        elif event_type in DevicePipeline.CONTROL_EVENTS:
+            return
+
+        if self._events.full():
+            self._log.warning("Event queue full (%d), serial reads paused until publisher catches up", EVENT_QUEUE_SIZE)
+
+        queued_at = time.perf_counter()
+        self._stats.record("read", queued_at - received_at)
+        await self._events.put(_QueuedLine(jsonl, bytes(frame), self._event_ts(jsonl), received_at, queued_at))
+        self._stats.queue_depth(self._events.qsize())
+
+    async def _handle_held_lines(self) -> None:
+        """Route lines that arrived during a handshake (see _sync_clock_burst) as the reader would have."""
+
+        held, self._held_lines = self._held_lines, []
+        for line, received_at in held:
+            await self._handle_line(memoryview(line), received_at)
+
+    async def _publish_events(self) -> None:
+        """Drain the event queue in batches, publishing each batch from a worker thread."""
+
+        while True:
+            batch = [await self._events.get()]
+            while len(batch) < PUBLISH_BATCH_MAX and not self._events.empty():
+                batch.append(self._events.get_nowait())
+
+            try:
+                await asyncio.to_thread(self._publish_batch, batch)
+            finally:
+                for _ in batch:
+                    self._events.task_done()
+                self._stats.queue_depth(self._events.qsize())
+
+    def _publish_batch(self, batch: list[_QueuedLine]) -> None:
+        """Publish queued lines to MQTT in order (runs in worker thread).
+
+        Consecutive game events go to MqttClient.publish_events() together, so they can share
+        one message if batch publishing is enabled; status snapshots are published on their own.
+        """
+
+        start = time.perf_counter()
+        events: list[_QueuedLine] = []
+        for line in batch:
+            self._stats.record("queue", start - line.queued_at)
+            if line.jsonl.get("event_type") != "status":
+                events.append(line)
+                continue
+
+            self._publish_event_run(events, start)
+            events = []
+            self._mqtt.publish_status(self.device_id, line.raw)
+            self._stats.record("publish", time.perf_counter() - start)
+
+        self._publish_event_run(events, start)
+
+    def _publish_event_run(self, events: list[_QueuedLine], start: float) -> None:
+        """Publish a run of consecutive game events (runs in worker thread via _publish_batch)."""
+
+        if not events:
+            return
+
+        self._mqtt.publish_events(self.device_id, [(line.raw, line.ts, line.read_at) for line in events])
+        elapsed = time.perf_counter() - start
+        for _ in events:
+            self._stats.record("publish", elapsed)
+
+    async def _forward_commands(self) -> None:
+        """Forward MQTT commands to the device as the ack window allows & publish their results."""
+
+        while True:
+            self._cmd_results += self._cmds.expire()
+            for result in self._cmd_results:
+                self._publish_command_result(result)
+            self._cmd_results.clear()
+
+            if (next_cmd := self._cmds.next_to_send()) is None:
+                self._cmd_wakeup.clear()
+                with contextlib.suppress(TimeoutError):
+                    await asyncio.wait_for(self._cmd_wakeup.wait(), self._cmds.next_expiry())
+                continue
+
+            cmd, wire = next_cmd
+            await self._serial_ready.wait()
+            if await self._io(self._handle_command, cmd.cmd, wire):
+                result = self._cmds.sent(cmd)
+            else:
+                result = self._cmds.failed(cmd)
+            if result is not None:
+                self._cmd_results.append(result)
+
+    def _queue_command(self, payload: bytes) -> None:
+        """Validate MQTT command & hand it to the command task (on the event loop)."""
+
+        try:
+            cmd = Command.parse(payload)
+        except ValueError as e:
+            self._log.warning("[MQTT -> Device] INVALID COMMAND: %s", e)
+            return
+
+        if cmd.cmd not in DevicePipeline.BOARD_COMMANDS:
+            self._log.warning("[MQTT -> Device] INVALID COMMAND: %r", cmd.cmd)
+            self._cmd_results.append(cmd.result("invalid"))
+        else:
+            superseded = self._cmds.submit(cmd)
+            for result in superseded:
+                self._log.debug("[MQTT -> Device] %r superseded before sending", result["cmd"])
+            METRICS.inc("commands_coalesced", self._metrics_label, len(superseded))
+            self._cmd_results += superseded
+        self._cmd_wakeup.set()
+
+    def _on_command_ack(self, jsonl: dict[str, Any]) -> None:
+        """Match device's cmd_ack to its command (result published by the command task)."""
+
+        wire_id = jsonl.get("id")
+        if not isinstance(wire_id, int) or (result := self._cmds.ack(wire_id, ok=jsonl.get("ok") is True)) is None:
+            self._log.debug("Ignoring ack for unknown command ID %r", wire_id)
+            return
+
+        if result["rtt_ms"] is not None:
+            METRICS.observe("command_rtt", result["rtt_ms"] / 1000)
+        self._cmd_results.append(result)
+        self._cmd_wakeup.set()
+
+    def _publish_command_result(self, result: CommandResult) -> None:
+        """Publish a command's outcome (applied/dropped/superseded/...) for the dashboard."""
+
+        match result["status"]:
+            case "dropped":
+                self._log.warning("[Device] Dropped command %r (device command queue full)", result["cmd"])
+                METRICS.inc("commands_dropped", self._metrics_label)
+            case "timeout":
+                self._log.warning(
+                    "[Device] No ack for command %r within %gs", result["cmd"], CommandTracker.ACK_TIMEOUT
+                )
+                METRICS.inc("command_timeouts", self._metrics_label)
+            case _:
+                pass
+
+        self._mqtt.publish_command_result(self.device_id, result)
+
+    async def _publish_heartbeats(self) -> None:
+        """Publish bridge state (with clock & pipeline stats) every HEARTBEAT_INTERVAL."""
+
+        while True:
+            await asyncio.sleep(HEARTBEAT_INTERVAL)
+            status = "unresponsive" if self._stalled else "online"
+            pipeline = self._stats.report()
+            self._log.debug("Pipeline: %s", pipeline)
+            self._mqtt.publish_state(
+                self.device_id, status, heartbeat=True, clock=self._clock.report(), pipeline=pipeline
+            )
+
+    async def _recover_serial(self) -> bool:
+        """Handle a serial error: wait for reconnect (if enabled & still plugged in). Returns True if recovered."""
+
+        self._serial_ready.clear()
+        failed_at = time.perf_counter()
+        if not await self._io(self._device_connected):
+            self._log.log(logging.CRITICAL if self.reconnect else logging.INFO, "Device unplugged, exiting")
+            return False
+
+        if not self.reconnect or not await self._io(self._wait_for_reconnect):
+            await asyncio.to_thread(self._publish_state_acked, "serial_error")
+            return False
+
+        recovered_in = time.perf_counter() - failed_at
+        self._log.info("Recovered from serial error in %.3fs", recovered_in)
+        METRICS.observe("recover", recovered_in)
+        await asyncio.to_thread(self._publish_state_acked, "online")
+        METRICS.inc("reconnects", self._metrics_label)
+        self._reset_liveness()
+        self._serial_ready.set()
+        await self._handle_held_lines()
+        return True
+
+    def _io[T](self, fn: Callable[..., T], /, *args: Any, **kwargs: Any) -> asyncio.Future[T]:  # noqa: ANN401
+        """Run blocking (serial) call on this pipeline's I/O threads.
+
+        Each device gets its own threads so one board parked in readline (or a slow handshake)
+        can't starve the others of the loop's default executor.
+        """
+        return self._loop.run_in_executor(self._io_pool, functools.partial(fn, *args, **kwargs))
+
+    # ==================== Clock Sync ====================
+
+    def _sync_clock_burst(self) -> None:
+        """Run several back-to-back sync exchanges (blocking) so events can be timestamped at once.
+
+        Only called while the reader task isn't running (startup & reconnect). A device still
+        streaming (e.g. the bridge restarted within AGENT_TIMEOUT_MS) can send game events in
+        between the replies; they're held & handled once the reader runs (see _handle_held_lines).
+        """
+
+        for _ in range(CLOCK_SYNC_BURST):
+            if not self._serial_write(b"Y", ctx="syncing clock"):
+                return
+            self._clock.request_sent()
+
+            deadline = time.monotonic() + CLOCK_SYNC_REPLY_TIMEOUT
+            while time.monotonic() < deadline:
+                try:
+                    line = self._serial_read_line(ctx="syncing clock")
+                except TransportError:
+                    return
+                if line is None:
+                    continue
+
+                received_at = time.perf_counter()
+                try:
+                    jsonl = self._decode_jsonl(line, ctx="syncing clock")
+                except (UnicodeDecodeError, JSONDecodeError):
+                    continue
+
+                if jsonl.get("event_type") == "sync":
+                    self._on_clock_sync_reply(jsonl)
+                    break
+                self._held_lines.append((line, received_at))
+
+    async def _sync_clock_periodically(self) -> None:
+        """Send a sync request every CLOCK_SYNC_INTERVAL (reply handled by the reader)."""
+
+        while True:
+            await asyncio.sleep(CLOCK_SYNC_INTERVAL)
+            await self._serial_ready.wait()
+            # Mark sent before writing so the reader can't see the reply first
+            self._clock.request_sent()
+            await self._io(self._serial_write, b"Y", ctx="syncing clock")
+
+    def _on_clock_sync_reply(self, jsonl: dict[str, Any]) -> None:
+        if not isinstance(t := jsonl.get("t"), int) or not self._clock.reply_received(t):
+            return
+        self._log.debug("Clock sync: %s", self._clock.report())
+
+    def _event_ts(self, jsonl: dict[str, Any]) -> int | None:
+        """Return wall-clock ms for event's device tick (None if no tick/not synced yet)."""
+
+        t = jsonl.get("t")
+        return self._clock.to_wall_ms(t) if isinstance(t, int) else None
+
+    # ==================== Liveness ====================
+
+    def _reset_liveness(self) -> None:
+        """Reset stall timer (on start & after reconnect)."""
+        self._last_rx = time.monotonic()
+        self._stalled = False
+
+    def _mark_device_alive(self) -> None:
+        """Record that a line was received; publish recovery if device was stalled."""
+        self._last_rx = time.monotonic()
+        if self._stalled:
+            self._log.info("Device responsive again")
+            self._mqtt.publish_state(self.device_id, "online")
+            self._stalled = False
+
+    async def _keep_device_alive(self) -> None:
+        """Send keepalive to device every KEEPALIVE_INTERVAL & detect a stalled device."""
+
+        while True:
+            await asyncio.sleep(KEEPALIVE_INTERVAL)
+            await self._serial_ready.wait()
+            await self._io(self._serial_write, b"K", ctx="sending keepalive")
+
+            if time.monotonic() - self._last_rx < DEVICE_STALL_TIMEOUT:
+                continue
+
+            self._log.warning("No data from device in %ds, re-identifying", DEVICE_STALL_TIMEOUT)
+            METRICS.inc("stalls", self._metrics_label)
+            if not self._stalled:
+                self._mqtt.publish_state(self.device_id, "unresponsive")
+                self._stalled = True
+
+            # Device may have dropped to buffering mode - re-identify to resync & flush
+            await self._io(self._serial_write, b"I", ctx="re-identifying stalled device")
+            await self._io(self._configure_device)
+            self._last_rx = time.monotonic()
+
+    def _wait_for_reconnect(self) -> bool:
+        """Wait for serial device to reconnect. Returns True if reconnected."""
+
+        with HotplugMonitor([self.port]) as hotplug, Status("") as status:
+            self._log.debug("Waiting for device to reconnect (%s)", hotplug.describe())
+            start = time.monotonic()
+            while (elapsed := time.monotonic() - start) < RECONNECT_TIMEOUT:
+                left = int(RECONNECT_TIMEOUT - elapsed)
+                status.update(f"  [dim]>[/] Reconnecting ({left}s remaining)")
+                try:
+                    self.transport.open()
+                    self._lines.reset()  # Partial line from before the drop
+                except TransportError:
+                    hotplug.wait(RECONNECT_RETRY_INTERVAL)  # Returns as soon as the port's node changes
+                else:
+                    status.stop()
+                    self._log.info("Reconnected to %s", self.port)
+                    # Device may have rebooted (restarting its ticks) - resync before flush
+                    self._clock.reset()
+                    self._sync_clock_burst()
+                    # Re-identify to flush any buffered events on device
+                    self._serial_write(b"I", ctx="re-identifying after reconnect")
+                    self._configure_device()  # Device may have reset
+                    return True
+
+        self._log.critical("Failed to reconnect (timeout after %ds)", RECONNECT_TIMEOUT)
+        return False
+
+    def _request_device_id(self) -> bool:
+        """Send identify command and wait for response. Returns True on success."""
+
+        self._log.debug("Requesting device ID")
+        if not self._serial_write(b"I", ctx="requesting device ID"):  # Identify
+            self._log.critical("Failed to get device ID")
+            return False
+
+        start = time.monotonic()
+        while (time.monotonic() - start) < DEVICE_ID_TIMEOUT:
+            try:
+                jsonl = self._serial_read_jsonl(ctx="getting device ID")
+            except (TransportError, UnicodeDecodeError):
+                return False
+            except JSONDecodeError:
+                continue  # Could be a partial line (e.g. if connecting while device middle of game)
+
+            if jsonl is None:
+                continue
+
+            if jsonl.get("event_type") == "identify" and "device_id" in jsonl:
+                self.device_id = self._metrics_label = jsonl["device_id"]
+                self._log.info("Device ID received: [bright_green]%s[/]", self.device_id)
+                self._on_identify(jsonl)
+                if not self._cmds.acks_supported:
+                    self._log.warning("Device firmware doesn't acknowledge commands; sending them untagged")
+                return True
+
+            time.sleep(DEVICE_ID_RETRY_INTERVAL)
+
+        self._log.critical("Failed to get device ID (timeout after %ds)", DEVICE_ID_TIMEOUT)
+        return False
+
+    def _on_identify(self, jsonl: dict[str, Any]) -> None:
+        """Tag commands for acks iff the firmware says it sends them (rechecked on every identify)."""
+
+        self._cmds.acks_supported = jsonl.get("acks") is True
+
+    def _configure_device(self) -> None:
+        """Set telemetry mode & request a state snapshot (after every identify).
+
+        The status reply is published retained so the dashboard resyncs in one round-trip.
+        """
+
+        byte = b"Q" if self.summary_only else b"V"
+        self._log.debug("Setting telemetry mode: %s", DevicePipeline.BOARD_COMMANDS[byte])
+        self._serial_write(byte, ctx="setting telemetry mode")
+        self._serial_write(b"?", ctx="requesting device status")
+
+    def _handle_command(self, byte: bytes, wire: bytes) -> bool:
+        """Write MQTT command to the device (runs in worker thread via _forward_commands).
+
+        Args:
+            byte: Single-byte MQTT Command (validated)
+            wire: Bytes to write (byte, tagged with its ID if acks are in use)
+
+        Returns:
+            True if written
+        """
+
+        desc = DevicePipeline.BOARD_COMMANDS[byte]
+        self._log.info("[bright_white on grey30][MQTT -> Device][/] %r (%s)", byte, desc)
+
+        if not self._serial_write(wire, ctx=f"writing {byte!r}"):
+            return False
+        METRICS.inc("commands", self._metrics_label)
+
+        match byte:
+            case b"P":  # Status reply updates _paused (once the device has actually toggled)
+                self._serial_write(b"?", ctx="refreshing status after pause toggle")
+        return True
+
+    def _open_transport(self) -> bool:
+        """Open transport to device. Returns True on success."""
+
+        self._log.debug("Connecting to %s", self.port)
+        try:
+            self.transport.open()
+        except TransportError as e:
+            self._log.critical("Failed to connect to %s: %s", self.port, e)
+            return False
+
+        self._log.info("Connected to %s", self.port)
+        return True
+
+    def _serial_read_line(self, *, ctx: str = "reading line") -> bytes | None:
+        """Read line from serial device (via the line reader), copied out of its buffer.
+
+        Args:
+            ctx: Context for logging
+
+        Returns:
+            Raw line from serial device. If no complete line within the port timeout, returns None
+
+        Raises:
+            TransportError: Read error
+        """
+
+        if (frame := self._lines.next_frame()) is None:
+            try:
+                self._lines.fill(self.transport)
+            except TransportError as e:
+                self._log.error("Serial error while %s: %s", ctx, e)
+                raise
+
+            if (frame := self._lines.next_frame()) is None:
+                return None
+
+        with frame:
+            return bytes(frame)
+
+    def _serial_read_jsonl(self, *, ctx: str = "reading line") -> dict[str, Any] | None:
+        """Read line from serial device (see _serial_read_line) and decode as JSON.
+
+        Args:
+            ctx: Context for logging
+
+        Returns:
+            Decoded JSON line from serial device. If no complete line within the port timeout, returns None
+
+        Raises:
+            TransportError: Read error
+            UnicodeDecodeError: Decode error
+            JSONDecodeError: Invalid JSON
+        """
+
+        line = self._serial_read_line(ctx=ctx)
+        return None if line is None else self._decode_jsonl(line, ctx=ctx)
+
+    def _decode_jsonl(self, line: bytes | memoryview, *, ctx: str = "reading line") -> dict[str, Any]:
+        """Decode line from serial device as a JSON object (see fastjson.py).
+
+        Args:
+            line: Raw line from serial device (surrounding whitespace ok)
+            ctx: Context for logging
+
+        Returns:
+            Decoded JSON line
+
+        Raises:
+            UnicodeDecodeError: Decode error (not UTF-8; with orjson this is a JSONDecodeError)
+            JSONDecodeError: Invalid JSON
+        """
+
+        try:
+            jsonl = fastjson.loads(line)
+            if not isinstance(jsonl, dict):
+                msg = f"expected dict, got {type(jsonl)}"
+                raise JSONDecodeError(msg, doc=bytes(line).decode(errors="replace"), pos=0)  # noqa: TRY301
+
+        except UnicodeDecodeError as e:
+            self._log.error("Decode error while %s: %s", ctx, e)
+            METRICS.inc("decode_errors", self._metrics_label)
+            raise
+
+        except JSONDecodeError as e:
+            METRICS.inc("json_errors", self._metrics_label)
+            self._log.warning(
+                "[bright_yellow on grey30][IGNORING][/] Invalid JSON received (%s): %r (error: %s)",
+                ctx,
+                bytes(line).strip(),
+                e,
+            )
+            raise
+
+        return jsonl
+
+    def _serial_write(self, byte: bytes, *, ctx: str | None = None) -> bool:
+        """Write byte(s) to serial device.
+
+        Args:
+            byte: Command byte (or tagged command) to write to serial device
+            ctx: Context for logging
+
+        Returns:
+            True on success
+        """
+
+        try:
+            self.transport.write(byte)
+        except TransportError as e:
+            ctx = f"writing {byte!r}" if ctx is None else ctx
+            self._log.error("Serial error while %s: %s", ctx, e)
+            return False
+
+        return True
+
+    def _device_connected(self) -> bool:
+        """Return True if device is still attached (e.g. USB serial port still listed)."""
+        return self.transport.present()
+
+    def _disconnect(self) -> None:
+        """Tell device to start buffering, publish "offline" (unless superseded) & close port."""
+
+        self._cleanup_before_disconnect()
+        if not self.superseded:
+            self._publish_state_acked("offline")
+        self.transport.close()
+
+    def _publish_state_acked(self, status: DevStatus) -> None:
+        """Publish state & wait (bounded) for the broker's ack (blocking).
+
+        If the broker is unreachable, paho keeps the message & sends it on reconnect.
+        """
+
+        with contextlib.suppress(RuntimeError, ValueError):
+            self._mqtt.publish_state(self.device_id, status).wait_for_publish(STATE_PUBLISH_TIMEOUT)
+
+    def _cleanup_before_disconnect(self) -> None:
+        """Send unpause and disconnect command before disconnecting.
+
+        Only sends commands if device is still physically connected.
+        If unplugged, device has reset anyway so no point sending commands.
+        """
+
+        if not self._device_connected():
+            self._log.debug("Skipping cleanup commands")
+            return
+
+        if self._paused:
+            self._log.info("[bright_white on grey30][Agent -> Device][/] Unpausing device before disconnect")
+            if self._serial_write(b"P", ctx="attempting to unpause device"):
+                self._paused = False
+
+        # Notify device to start buffering events
+        self._log.info("[bright_white on grey30][Agent -> Device][/] Sending disconnect command")
+        self._serial_write(b"D", ctx="attempting to disconnect device")
+
+
+class _PortLogAdapter(logging.LoggerAdapter[logging.Logger]):
+    """Prefix log messages with the serial port (when several devices share one process)."""
+
+    @override
+    def process(self, msg: Any, kwargs: MutableMapping[str, Any]) -> tuple[Any, MutableMapping[str, Any]]:
+        return f"[dim]({self.extra['port']})[/] {msg}", kwargs  # type: ignore[index]
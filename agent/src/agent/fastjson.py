@@ -0,0 +1,64 @@
+"""
+JSON codec for the bridge hot path.
+
+Uses orjson if installed (`pip install agent[fast]`), else the stdlib json module; both raise
+json.JSONDecodeError (orjson's error subclasses it), so callers don't care which is active.
+
+Device lines are forwarded without a decode/re-encode round-trip: splice() appends the
+bridge's fields (device_id, ts, seq, ...) to the raw JSON object bytes. Keys already in the
+line are shadowed by the spliced ones, since JSON parsers keep the last duplicate key - the
+same result as merging dicts (event | fields) before encoding.
+"""
+
+from __future__ import annotations
+
+import json
+from typing import TYPE_CHECKING, Any, Final
+
+if TYPE_CHECKING:
+    from collections.abc import Mapping
+
+try:
+    import orjson
+except ImportError:  # pragma: no cover - depends on install
+    orjson = None
+
+BACKEND: Final = "orjson" if orjson is not None else "json"
+
+
+def loads(data: bytes | bytearray | memoryview) -> Any:  # noqa: ANN401
+    """Decode JSON from raw bytes (memoryview accepted without copying when using orjson).
+
+    Raises:
+        JSONDecodeError: Invalid JSON (or, with orjson, invalid UTF-8)
+        UnicodeDecodeError: Invalid UTF-8 (stdlib only)
+    """
+
+    if orjson is not None:
+        return orjson.loads(data)
+    return json.loads(str(data, "utf-8"))  # Decodes straight from the buffer (no bytes copy)
+
+
+def dumps(obj: Any) -> bytes:  # noqa: ANN401
+    """Encode obj as compact UTF-8 JSON."""
+
+    if orjson is not None:
+        return orjson.dumps(obj)
+    return json.dumps(obj, separators=(",", ":"), ensure_ascii=False).encode()
+
+
+def splice(obj: Mapping[str, Any] | bytes, fields: Mapping[str, Any]) -> bytes:
+    """Return JSON for obj with fields added (overriding obj's own).
+
+    Args:
+        obj: Dict, or raw bytes of an already-validated JSON object (surrounding whitespace ok)
+        fields: Fields to add
+    """
+
+    if not isinstance(obj, bytes):
+        return dumps({**obj, **fields})
+
+    body = obj.rstrip()
+    extra = dumps(fields)[1:]  # '"k":v,...}' (fields is a non-empty dict)
+    sep = b"" if body[:-1].rstrip().endswith(b"{") else b","
+    return body[:-1] + sep + extra
@@ -0,0 +1,76 @@
+"""
+Chunked line framing for the serial reader.
+
+pyserial's readline() reads one byte per call and allocates a bytes object per line. Instead,
+LineReader pulls whatever the transport has buffered in one read() into a reusable bytearray and
+hands out complete lines as memoryview slices of it, so a flushed burst of events costs one
+read and no per-line copies until a line is actually queued for publishing.
+
+Frames are only valid until the next fill() (which compacts the buffer in place): callers
+release them (`with frame:`) or copy (`bytes(frame)`) before reading more.
+"""
+
+from __future__ import annotations
+
+import logging
+from typing import TYPE_CHECKING, ClassVar
+
+if TYPE_CHECKING:
+    from .transport import Transport
+
+
+class LineReader:
+    """Splits serial input into newline-terminated frames (one per reader; not thread-safe)."""
+
+    CHUNK_MAX: ClassVar = 64 * 1024  # Max bytes per read()
+    LINE_MAX: ClassVar = 4096  # Longer "lines" are line noise - dropped
+
+    dropped: int  # Bytes discarded as overlong lines (since start)
+
+    def __init__(self) -> None:
+        self.dropped = 0
+
+        self._log = logging.getLogger("Bridge")
+        self._buf = bytearray()
+        self._pos = 0  # Start of first unconsumed byte in _buf
+
+    def fill(self, transport: Transport) -> int:
+        """Read what the transport has buffered (blocking up to its read timeout for the first byte).
+
+        Returns:
+            Number of bytes read (0 on timeout)
+
+        Raises:
+            TransportError: Read error
+        """
+
+        chunk = transport.read(LineReader.CHUNK_MAX)
+
+        # Compact: drop consumed lines (no frames may be held at this point)
+        if self._pos:
+            del self._buf[: self._pos]
+            self._pos = 0
+
+        self._buf += chunk
+        if len(self._buf) > LineReader.LINE_MAX and self._buf.find(b"\n") < 0:
+            self._log.warning("Dropping %d bytes of unterminated serial input", len(self._buf))
+            self.dropped += len(self._buf)
+            self._buf.clear()
+
+        return len(chunk)
+
+    def next_frame(self) -> memoryview | None:
+        """Return next complete line (without newline) from the buffer, or None if there isn't one."""
+
+        end = self._buf.find(b"\n", self._pos)
+        if end < 0:
+            return None
+
+        start, self._pos = self._pos, end + 1
+        return memoryview(self._buf)[start:end]
+
+    def reset(self) -> None:
+        """Discard buffered input (e.g. partial line from before a reconnect)."""
+
+        self._buf.clear()
+        self._pos = 0
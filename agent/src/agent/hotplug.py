@@ -0,0 +1,168 @@
+"""
+Hot-plug notifications for serial device nodes.
+
+USB serial ports come & go as nodes under /dev (created by devtmpfs, then chmod'd/linked by
+udev), so an inotify watch on the port's directory says within milliseconds that a port appeared
+or vanished - rather than finding out at the next poll. inotify is called through libc (no
+extra dependency). Where it isn't available (non-Linux, or a port that isn't a device node, e.g.
+tcp://) HotplugMonitor falls back to plain timeouts, i.e. the caller's polling interval.
+
+Waits wake on any matching change; callers still (re)scan/open themselves, so a spurious or
+missed event costs at most one poll interval, never correctness.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import contextlib
+import ctypes
+import ctypes.util
+import logging
+import os
+import select
+import struct
+import time
+from fnmatch import fnmatch
+from pathlib import Path
+from typing import TYPE_CHECKING, ClassVar, Final, Literal, Self
+
+if TYPE_CHECKING:
+    from collections.abc import Iterable
+
+type HotplugSource = Literal["inotify", "poll"]
+
+# <sys/inotify.h>
+_IN_ATTRIB: Final = 0x004  # udev fixes up permissions after the node is created
+_IN_MOVED_FROM: Final = 0x040
+_IN_MOVED_TO: Final = 0x080
+_IN_CREATE: Final = 0x100
+_IN_DELETE: Final = 0x200
+_IN_Q_OVERFLOW: Final = 0x4000
+_IN_NONBLOCK: Final = os.O_NONBLOCK
+_IN_CLOEXEC: Final = os.O_CLOEXEC
+_WATCH_MASK: Final = _IN_ATTRIB | _IN_MOVED_FROM | _IN_MOVED_TO | _IN_CREATE | _IN_DELETE
+_EVENT: Final = struct.Struct("iIII")  # wd, mask, cookie, len (name follows, NUL-padded)
+
+
+def _libc() -> ctypes.CDLL | None:
+    """Return libc if it has inotify (else None)."""
+
+    name = ctypes.util.find_library("c")
+    try:
+        libc = ctypes.CDLL(name, use_errno=True)
+    except OSError:
+        return None
+    return libc if hasattr(libc, "inotify_init1") else None
+
+
+class HotplugMonitor:
+    """Wakes waiters when device nodes matching the given paths/globs change (see module docstring)."""
+
+    READ_SIZE: ClassVar = 64 * 1024
+
+    source: HotplugSource
+
+    def __init__(self, paths: Iterable[str]) -> None:
+        """Watch directories of absolute paths/globs (e.g. /dev/ttyACM0, /dev/ttyUSB*); others are ignored."""
+
+        self._log = logging.getLogger("Bridge")
+        self._fd: int | None = None
+        self._patterns: dict[str, set[str]] = {}  # Watched dir -> basename patterns
+        self._dirs: dict[int, str] = {}  # Watch descriptor -> dir
+        for path in paths:
+            if Path(path).is_absolute() and Path(path).parent.is_dir():
+                self._patterns.setdefault(str(Path(path).parent), set()).add(Path(path).name)
+
+        if self._patterns and (libc := _libc()) is not None:
+            self._fd = self._open_inotify(libc)
+        self.source = "poll" if self._fd is None else "inotify"
+
+    def __enter__(self) -> Self:
+        return self
+
+    def __exit__(self, *_: object) -> None:
+        self.close()
+
+    def close(self) -> None:
+        if self._fd is not None:
+            os.close(self._fd)
+            self._fd = None
+
+    def wait(self, secs: float) -> bool:
+        """Block until a matching node changes, for at most secs. Returns True on a change."""
+
+        if self._fd is None:
+            time.sleep(secs)
+            return False
+
+        deadline = time.monotonic() + secs
+        while (left := deadline - time.monotonic()) > 0:
+            readable, _, _ = select.select([self._fd], [], [], left)
+            if readable and self._drain():
+                return True
+        return False
+
+    async def wait_async(self, secs: float) -> bool:
+        """Like wait(), on the running event loop."""
+
+        if self._fd is None:
+            await asyncio.sleep(secs)
+            return False
+
+        fd = self._fd
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + secs
+        while (left := deadline - loop.time()) > 0:
+            ready = loop.create_future()
+            loop.add_reader(fd, lambda f=ready: f.done() or f.set_result(None))
+            try:
+                await asyncio.wait_for(ready, left)
+            except TimeoutError:
+                return False
+            finally:
+                loop.remove_reader(fd)
+            if self._drain():
+                return True
+        return False
+
+    def describe(self) -> str:
+        """Return a short description for logging."""
+
+        if self._fd is None:
+            return "polling"
+        return f"inotify on {', '.join(sorted(self._patterns))}"
+
+    def _open_inotify(self, libc: ctypes.CDLL) -> int | None:
+        """Create inotify instance watching the pattern dirs. Returns its fd (None on failure)."""
+
+        fd = libc.inotify_init1(_IN_NONBLOCK | _IN_CLOEXEC)
+        if fd < 0:
+            self._log.debug("inotify unavailable (%s), polling", os.strerror(ctypes.get_errno()))
+            return None
+
+        for d in self._patterns:
+            wd = libc.inotify_add_watch(fd, os.fsencode(d), _WATCH_MASK)
+            if wd < 0:
+                self._log.debug("Can't watch %s (%s), polling", d, os.strerror(ctypes.get_errno()))
+                os.close(fd)
+                return None
+            self._dirs[wd] = d
+        return fd
+
+    def _drain(self) -> bool:
+        """Read pending inotify events. Returns True if any matched (or events were lost)."""
+
+        assert self._fd is not None  # noqa: S101 - only called in inotify mode
+        matched = False
+        with contextlib.suppress(BlockingIOError):
+            while data := os.read(self._fd, HotplugMonitor.READ_SIZE):
+                pos = 0
+                while pos + _EVENT.size <= len(data):
+                    wd, mask, _, name_len = _EVENT.unpack_from(data, pos)
+                    name = data[pos + _EVENT.size : pos + _EVENT.size + name_len].rstrip(b"\0").decode(errors="replace")
+                    pos += _EVENT.size + name_len
+                    if mask & _IN_Q_OVERFLOW:
+                        matched = True  # Missed events - caller should rescan anyway
+                    elif (d := self._dirs.get(wd)) is not None:
+                        matched |= any(fnmatch(name, pat) for pat in self._patterns[d])
+        return matched
@@ -0,0 +1,201 @@
+"""
+Bridge metrics: throughput/error counters & per-stage latency histograms.
+
+Counters are labelled by device (device ID once identified, else serial port). Latency
+histograms are per stage, shared by all devices:
+
+    read        serial line received -> decoded & queued
+    queue       waiting in the device's event queue
+    publish     handed to paho
+    broker_ack  handed to paho -> acknowledged by broker (written to socket for QoS 0)
+    end_to_end  serial line received -> acknowledged by broker
+    command_rtt command written to serial -> acked by device (see commands.py)
+    recover     serial error/detach -> device serving again (reconnected & re-identified)
+
+Histograms use HDR-style log-linear buckets (HIST_SUB_BUCKETS per power of two, from HIST_MIN_S), so
+relative error stays within ~19% from microseconds to minutes at a fixed memory cost.
+
+Exposed via an optional local HTTP endpoint (Prometheus text format, see serve()) and a
+periodic MQTT message (see snapshot()).
+"""
+
+from __future__ import annotations
+
+import bisect
+import logging
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import ClassVar, Final, Literal, TypedDict, override
+
+type Stage = Literal["read", "queue", "publish", "broker_ack", "end_to_end", "command_rtt", "recover"]
+
+# Counter name -> help text (Prometheus name is whac_bridge_<name>_total)
+COUNTERS: Final = {
+    "lines_read": "Lines read from serial",
+    "bytes_read": "Bytes read from serial",
+    "decode_errors": "Serial lines that weren't valid UTF-8",
+    "json_errors": "Serial lines that weren't a JSON object",
+    "serial_errors": "Serial read errors",
+    "reconnects": "Serial reconnects after an error",
+    "stalls": "Times the device went silent (re-identified)",
+    "commands": "Commands forwarded to the device",
+    "commands_coalesced": "Commands superseded by a later one before being sent",
+    "commands_dropped": "Commands the device dropped (its command queue was full)",
+    "command_timeouts": "Commands the device didn't ack in time",
+    "published": "Messages handed to paho",
+    "publish_failures": "Publishes paho rejected (not connected, queue full, ...)",
+    "spooled": "Messages written to the disk spool",
+    "replayed": "Spooled messages delivered after an outage",
+    "mqtt_disconnects": "Unexpected MQTT broker disconnects",
+}
+
+STAGES: Final[tuple[Stage, ...]] = ("read", "queue", "publish", "broker_ack", "end_to_end", "command_rtt", "recover")
+
+# Histogram buckets: HIST_SUB_BUCKETS per power of two from 10us, up to ~168s (+Inf beyond)
+HIST_MIN_S: Final = 1e-5
+HIST_SUB_BUCKETS: Final = 4
+HIST_OCTAVES: Final = 24
+HIST_BOUNDS: Final = tuple(HIST_MIN_S * 2 ** (i / HIST_SUB_BUCKETS) for i in range(HIST_SUB_BUCKETS * HIST_OCTAVES))
+
+
+class HistogramSnapshot(TypedDict):
+    count: int
+    p50_ms: float
+    p90_ms: float
+    p99_ms: float
+    max_ms: float
+
+
+class MetricsSnapshot(TypedDict):
+    counters: dict[str, dict[str, int]]  # name -> {device: value}
+    latency: dict[str, HistogramSnapshot]  # stage -> summary
+
+
+class Histogram:
+    """Log-linear (HDR-style) latency histogram; not thread-safe (Metrics holds the lock)."""
+
+    def __init__(self) -> None:
+        self.counts = [0] * (len(HIST_BOUNDS) + 1)  # Last bucket is +Inf
+        self.count = 0
+        self.sum = 0.0
+        self.max = 0.0
+
+    def observe(self, secs: float) -> None:
+        self.counts[bisect.bisect_left(HIST_BOUNDS, secs)] += 1
+        self.count += 1
+        self.sum += secs
+        self.max = max(self.max, secs)
+
+    def quantile(self, q: float) -> float:
+        """Return upper bound (secs) of the bucket holding the q-th quantile (0 if empty)."""
+
+        if not self.count:
+            return 0.0
+
+        rank = q * self.count
+        seen = 0
+        for i, n in enumerate(self.counts):
+            seen += n
+            if seen >= rank and n:
+                return min(HIST_BOUNDS[i], self.max) if i < len(HIST_BOUNDS) else self.max
+        return self.max
+
+    def snapshot(self) -> HistogramSnapshot:
+        return {
+            "count": self.count,
+            "p50_ms": round(self.quantile(0.5) * 1000, 3),
+            "p90_ms": round(self.quantile(0.9) * 1000, 3),
+            "p99_ms": round(self.quantile(0.99) * 1000, 3),
+            "max_ms": round(self.max * 1000, 3),
+        }
+
+
+class Metrics:
+    """Process-wide metrics registry (thread-safe)."""
+
+    PREFIX: ClassVar = "whac_bridge"
+
+    def __init__(self) -> None:
+        self._lock = threading.Lock()
+        self._counters: dict[str, dict[str, int]] = {name: {} for name in COUNTERS}
+        self._histograms: dict[Stage, Histogram] = {stage: Histogram() for stage in STAGES}
+
+    def inc(self, name: str, device: str = "", n: int = 1) -> None:
+        """Increment counter (see COUNTERS) for device."""
+
+        with self._lock:
+            per_dev = self._counters[name]
+            per_dev[device] = per_dev.get(device, 0) + n
+
+    def observe(self, stage: Stage, secs: float) -> None:
+        """Record a latency sample (seconds) for stage."""
+
+        with self._lock:
+            self._histograms[stage].observe(secs)
+
+    def snapshot(self) -> MetricsSnapshot:
+        """Return counters & latency percentiles (for the periodic MQTT metrics message)."""
+
+        with self._lock:
+            return {
+                "counters": {name: dict(per_dev) for name, per_dev in self._counters.items() if per_dev},
+                "latency": {stage: h.snapshot() for stage, h in self._histograms.items() if h.count},
+            }
+
+    def render_prometheus(self) -> str:
+        """Return all metrics in Prometheus text exposition format."""
+
+        lines: list[str] = []
+        with self._lock:
+            for name, per_dev in self._counters.items():
+                metric = f"{Metrics.PREFIX}_{name}_total"
+                lines += [f"# HELP {metric} {COUNTERS[name]}", f"# TYPE {metric} counter"]
+                lines += [f'{metric}{{device="{_escape(dev)}"}} {val}' for dev, val in sorted(per_dev.items())]
+
+            metric = f"{Metrics.PREFIX}_stage_seconds"
+            lines += [f"# HELP {metric} Bridge pipeline stage latency", f"# TYPE {metric} histogram"]
+            for stage, h in self._histograms.items():
+                cumulative = 0
+                for bound, n in zip((*HIST_BOUNDS, float("inf")), h.counts, strict=True):
+                    cumulative += n
+                    le = "+Inf" if bound == float("inf") else f"{bound:.6g}"
+                    lines.append(f'{metric}_bucket{{stage="{stage}",le="{le}"}} {cumulative}')
+                lines.append(f'{metric}_sum{{stage="{stage}"}} {h.sum:.9g}')
+                lines.append(f'{metric}_count{{stage="{stage}"}} {h.count}')
+
+        return "\n".join(lines) + "\n"
+
+
+# Shared by all pipelines & the MQTT client (like logging's registry)
+METRICS: Final = Metrics()
+
+
+def serve(host: str, port: int) -> ThreadingHTTPServer:
+    """Serve METRICS at http://<host>:<port>/metrics from a daemon thread. Returns the server."""
+
+    server = ThreadingHTTPServer((host, port), _MetricsHandler)
+    threading.Thread(target=server.serve_forever, name="metrics-http", daemon=True).start()
+    logging.getLogger("Metrics").info("Serving metrics on [cyan]http://%s:%d/metrics[/]", host, port)
+    return server
+
+
+class _MetricsHandler(BaseHTTPRequestHandler):
+    def do_GET(self) -> None:
+        if self.path.split("?", 1)[0] != "/metrics":
+            self.send_error(404)
+            return
+
+        body = METRICS.render_prometheus().encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    @override
+    def log_message(self, format: str, *args: object) -> None:
+        """Silence per-request logging (scrapes every few seconds would flood the console)."""
+
+
+def _escape(label: str) -> str:
+    return label.replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n")
@@ -1,6 +1,8 @@
 from __future__ import annotations
 
-from argparse import ArgumentParser
+import os
+from argparse import ArgumentParser, ArgumentTypeError
+from pathlib import Path
 from typing import TYPE_CHECKING, NamedTuple, cast
 
 from rich_argparse import RichHelpFormatter
@@ -8,9 +10,25 @@ from rich_argparse import RichHelpFormatter
 from .logging_conf import LOG_ABBREV_2_LVL, LOG_LVL_2_COLOR
 
 if TYPE_CHECKING:
+    from agent.mqtt import QosKey
+
     from .logging_conf import LogLvl
 
 
+_QOS_KINDS = ("state", "heartbeat", "status", "game_events")
+_QOS_LEVELS = (0, 1, 2)
+
+
+def _qos_override(val: str) -> tuple[QosKey, int]:
+    """Parse a [cyan]KIND=N[/] QoS override."""
+
+    kind, _, level = val.partition("=")
+    if kind not in _QOS_KINDS or not level.isdigit() or int(level) not in _QOS_LEVELS:
+        msg = f"expected KIND=N with KIND in {{{', '.join(_QOS_KINDS)}}} & N in {{0, 1, 2}}, got {val!r}"
+        raise ArgumentTypeError(msg)
+    return cast("QosKey", kind), int(level)
+
+
 def _mk_parser() -> ArgumentParser:
     RichHelpFormatter.usage_markup = True
     RichHelpFormatter.styles.update(
@@ -26,12 +44,29 @@ def _mk_parser() -> ArgumentParser:
     parser = ArgumentParser(
         description="UART bridge for Whac-A-Mole device",
         formatter_class=RichHelpFormatter,
-        usage="%(prog)s [cyan]-s [dim]P[/] \\[options][/]",
+        usage="%(prog)s [cyan](-s [dim]P[/] | -w [dim]GLOB[/]) \\[options][/]",
     )
 
     arg = parser.add_argument
 
-    arg("-s", "--serial-port", required=True, help="serial port (e.g. [cyan]/dev/ttyUSB0[/])", metavar="P")
+    port = parser.add_mutually_exclusive_group(required=True)
+    port.add_argument(
+        "-s",
+        "--serial-port",
+        help=(
+            "device port: serial (e.g. [cyan]/dev/ttyUSB0[/]), [cyan]tcp://HOST:PORT[/],"
+            " [cyan]pty:[/] (new pseudo-terminal for a simulator), or [cyan]replay://FILE[?speed=N][/]"
+            " (replay a capture at N x recorded pace; [yellow]0[/] = max speed)"
+        ),
+        metavar="P",
+    )
+    port.add_argument(
+        "-w",
+        "--watch",
+        help="bridge every serial port matching glob, with hot-plug (e.g. [cyan]'/dev/ttyACM*'[/])",
+        dest="port_glob",
+        metavar="GLOB",
+    )
     arg(
         "-b",
         "--baud",
@@ -42,6 +77,112 @@ def _mk_parser() -> ArgumentParser:
         metavar="RATE",
     )
 
+    arg(
+        "--summary-only",
+        action="store_true",
+        help="only send per-session summaries (suppresses per-pop events)",
+        dest="summary_only",
+    )
+
+    arg(
+        "--qos",
+        type=_qos_override,
+        action="append",
+        default=[],
+        help=(
+            "MQTT QoS per message kind, repeatable (e.g. [cyan]game_events=2[/]; default: [yellow]state=1[/],"
+            " [yellow]heartbeat=0[/], [yellow]status=1[/], [yellow]game_events=1[/])"
+        ),
+        dest="qos",
+        metavar="KIND=N",
+    )
+    arg(
+        "--batch",
+        type=int,
+        default=0,
+        help="pack up to N events per message on [cyan]whac/<id>/game_events_batch[/] (default: [yellow]0[/] = off)",
+        dest="batch_max",
+        metavar="N",
+    )
+    arg(
+        "--max-inflight",
+        type=int,
+        default=20,
+        help="max unacknowledged QoS 1/2 messages in flight ([yellow]0[/] = unlimited, default: [yellow]20[/])",
+        dest="max_inflight",
+        metavar="N",
+    )
+    arg(
+        "--max-queued",
+        type=int,
+        default=0,
+        help="max messages queued in paho beyond that; overflow is spooled (default: [yellow]0[/] = unlimited)",
+        dest="max_queued",
+        metavar="N",
+    )
+
+    default_spool = Path(os.getenv("XDG_STATE_HOME") or Path.home() / ".local/state") / "whac-agent/spool"
+    arg(
+        "--spool-dir",
+        type=Path,
+        default=default_spool,
+        help="where to spool events while MQTT broker is unreachable (default: [yellow]%(default)s[/])",
+        dest="spool_dir",
+        metavar="DIR",
+    )
+    arg(
+        "--spool-max-mb",
+        type=int,
+        default=64,
+        help="spool size cap; oldest events dropped beyond it ([yellow]0[/] disables spooling, default: [yellow]64[/])",
+        dest="spool_max_mb",
+        metavar="MB",
+    )
+    arg(
+        "--spool-max-age",
+        type=int,
+        default=24,
+        help="drop spooled events older than this many hours (default: [yellow]24[/])",
+        dest="spool_max_age_h",
+        metavar="H",
+    )
+
+    arg(
+        "--capture",
+        type=Path,
+        default=None,
+        help="record each device's raw traffic to [cyan]DIR/<port>-<time>.whcap[/] (for [cyan]-s replay://[/])",
+        dest="capture_dir",
+        metavar="DIR",
+    )
+
+    arg(
+        "--metrics-port",
+        type=int,
+        default=0,
+        help="serve Prometheus metrics on [cyan]http://HOST:PORT/metrics[/] (default: [yellow]0[/] = off)",
+        dest="metrics_port",
+        metavar="PORT",
+    )
+    arg(
+        "--metrics-host",
+        default="127.0.0.1",
+        help="address for the metrics endpoint (default: [yellow]%(default)s[/])",
+        dest="metrics_host",
+        metavar="HOST",
+    )
+    arg(
+        "--metrics-interval",
+        type=int,
+        default=60,
+        help=(
+            "publish metrics to [cyan]whac/<client_id>/metrics[/] every S secs"
+            " ([yellow]0[/] = off, default: [yellow]60[/])"
+        ),
+        dest="metrics_interval",
+        metavar="S",
+    )
+
     log_lvl_choices = ", ".join(
         f"[{clr}]{abbr}[/]" for abbr, clr in zip(LOG_ABBREV_2_LVL, LOG_LVL_2_COLOR.values(), strict=True)
     )
@@ -60,8 +201,21 @@ def _mk_parser() -> ArgumentParser:
 
 
 class _Args(NamedTuple):
-    serial_port: str
+    serial_port: str | None
+    port_glob: str | None
     baud_rate: int
+    summary_only: bool
+    spool_dir: Path
+    spool_max_bytes: int
+    spool_max_age_s: int
+    qos: dict[QosKey, int]
+    batch_max: int
+    max_inflight: int
+    max_queued: int
+    metrics_port: int
+    metrics_host: str
+    metrics_interval: int
+    capture_dir: Path | None
     log_level: LogLvl
 
 
@@ -73,6 +227,19 @@ def get_cli_args() -> _Args:
 
     return _Args(
         serial_port=args.serial_port,
+        port_glob=args.port_glob,
         baud_rate=args.baud_rate,
+        summary_only=args.summary_only,
+        spool_dir=args.spool_dir,
+        spool_max_bytes=args.spool_max_mb * 1024 * 1024,
+        spool_max_age_s=args.spool_max_age_h * 3600,
+        qos=dict(args.qos),
+        batch_max=args.batch_max,
+        max_inflight=args.max_inflight,
+        max_queued=args.max_queued,
+        metrics_port=args.metrics_port,
+        metrics_host=args.metrics_host,
+        metrics_interval=args.metrics_interval,
+        capture_dir=args.capture_dir,
         log_level=LOG_ABBREV_2_LVL[cast("str", args.log_level)],
     )
@@ -1,87 +1,207 @@
 from __future__ import annotations
 
+import itertools
 import json
 import logging
-from typing import TYPE_CHECKING, Any, ClassVar, Literal, TypedDict
+import threading
+import time
+from types import MappingProxyType
+from typing import TYPE_CHECKING, Any, ClassVar, Final, Literal, NamedTuple, NotRequired, TypedDict
 
 from paho.mqtt.client import Client, ConnectFlags, DisconnectFlags, MQTTMessage, MQTTMessageInfo
 from paho.mqtt.enums import CallbackAPIVersion, MQTTErrorCode
 
+from . import fastjson
+from .metrics import METRICS
 from .misc import time_now_ms
 
 if TYPE_CHECKING:
-    from collections.abc import Callable
+    from collections.abc import Callable, Mapping
     from logging import Logger
 
     from paho.mqtt.properties import Properties
     from paho.mqtt.reasoncodes import ReasonCode
 
-    type Topic = Literal["state", "commands", "game_events"]
-    type CommandCallback = Callable[[bytes], None]
+    from .clock import ClockReport
+    from .commands import CommandResult
+    from .metrics import MetricsSnapshot
+    from .pipeline import PipelineReport
+    from .spool import Spool, SpoolReport
 
-    type DevStatus = Literal["online", "serial_error", "offline"]
+    type Topic = Literal["state", "status", "commands", "command_acks", "game_events", "game_events_batch", "metrics"]
+    type QosKey = Literal["state", "heartbeat", "status", "game_events"]
+    type CommandCallback = Callable[[str, bytes], None]  # (device_id, command)
+    type RawEvent = dict[str, Any] | bytes  # Decoded, or raw JSON object bytes as read from device
+    type OutEvent = tuple[RawEvent, int | None, float | None]  # (event, ts, read_at) - see publish_events()
+
+    type DevStatus = Literal["online", "unresponsive", "serial_error", "offline"]
 
     class CommonPayload(TypedDict):
         device_id: str
         ts: int
 
+    # Wire format of device messages (device's own fields are forwarded as-is, see fastjson.splice)
+    class EventPayload(CommonPayload):
+        seq: int  # Per-device, per-bridge-run event number (lets subscribers drop QoS 1 redeliveries)
+        seq_epoch: int  # Bridge run (ms since Epoch it started) the seq belongs to
+
+    class BatchPayload(CommonPayload):
+        events: list[EventPayload]
+
     class StatusPayload(CommonPayload):
         status: DevStatus
+        clock: NotRequired[ClockReport]
+        pipeline: NotRequired[PipelineReport]
+        spool: NotRequired[SpoolReport]
+
+    class CommandAckPayload(CommonPayload, CommandResult): ...
+
+    class MetricsPayload(MetricsSnapshot):
+        bridge: str  # MQTT client ID
+        ts: int
+
+
+# Default QoS per message kind: events at-least-once (deduped by seq), heartbeats best-effort
+DEFAULT_QOS: Final[Mapping[QosKey, int]] = MappingProxyType(
+    {"state": 1, "heartbeat": 0, "status": 1, "game_events": 1},
+)
+
+
+class PublishConf(NamedTuple):
+    qos: Mapping[QosKey, int] = DEFAULT_QOS
+    batch_max: int = 0  # Max events per game_events_batch message (0 = one message per event)
+    max_inflight: int = 20  # Paho's unacked QoS 1/2 window (0 = unlimited)
+    max_queued: int = 0  # Paho's outgoing queue cap (0 = unlimited); overflow goes to spool
+
+
+# Spool replay: records published per batch & max wait for the broker to ack a batch
+SPOOL_REPLAY_BATCH: Final = 100
+SPOOL_REPLAY_ACK_TIMEOUT: Final = 10
+
+# Max publishes tracked for broker ack latency (QoS 0 messages dropped while offline never ack)
+ACK_TRACK_MAX: Final = 4096
 
 
 class MqttClient:
-    """Wrapper around paho-mqtt with connection management."""
+    """Wrapper around paho-mqtt with connection management.
+
+    One connection can serve many devices: every publish takes the device ID, and commands for
+    each device registered via add_device() are routed to on_command with that ID.
+
+    With a spool, device messages (events & status) published while the broker is unreachable
+    go to disk instead, and a replay thread re-publishes them in order once it's back. Live
+    messages keep going to the spool until it has drained, so ordering is preserved.
+
+    QoS is set per message kind (see PublishConf). Game events carry a per-device sequence
+    number, so QoS 1 (or spool replay) duplicates can be dropped by subscribers. With
+    batch_max set, events read together are packed into one game_events_batch message.
+
+    Device lines may be passed as raw bytes: bridge fields are spliced in without decoding and
+    re-encoding them (see fastjson.py).
+
+    Publish/spool counters and broker ack latency (from on_publish) go to the process-wide
+    metrics (see metrics.py).
+    """
 
     KEEPALIVE: ClassVar = 30
 
     broker: str
     port: int
-    device_id: str
+    client_id: str
     topic: str
     on_command: CommandCallback
 
     _log: Logger
     _client: Client
+    _devices: set[str]
+    _spool: Spool | None
+    _awaiting_ack: dict[int, tuple[float, float | None]]  # mid -> (published at, read at)
+    _early_acks: dict[int, float]  # mid -> acked at (on_publish beat _track)
 
     def __init__(
         self,
         *,
         broker: str,
         port: int,
-        device_id: str,
+        client_id: str,
         topic: str,
         on_command: CommandCallback,
-        last_will: DevStatus,
+        spool: Spool | None = None,
+        publish: PublishConf | None = None,
     ) -> None:
         self.broker = broker
         self.port = port
-        self.device_id = device_id
+        self.client_id = client_id
         self.topic = topic
         self.on_command = on_command
 
         self._log = logging.getLogger("MqttClient")
+        self._devices = set()
+        self._devices_lock = threading.Lock()
+        self._spool = spool
+        self._conf = publish if publish is not None else PublishConf()
+        self._seq_epoch = time_now_ms()
+        self._seqs: dict[str, itertools.count[int]] = {}
+        self._replay_wake = threading.Event()
+        self._replay_stop = threading.Event()
+        self._replay_thread = threading.Thread(target=self._replay_spool, name="spool-replay", daemon=True)
+        self._ack_lock = threading.Lock()
+        self._awaiting_ack = {}
+        self._early_acks = {}
         self._client = Client(
-            client_id=f"bridge-{device_id}",
+            client_id=client_id,
             callback_api_version=CallbackAPIVersion.VERSION2,
         )
         self._client.on_message = self._on_message
         self._client.on_connect = self._on_connect
         self._client.on_disconnect = self._on_disconnect
+        self._client.on_publish = self._on_publish
         self._client.reconnect_delay_set(min_delay=1, max_delay=30)
+        self._client.max_inflight_messages_set(self._conf.max_inflight)
+        self._client.max_queued_messages_set(self._conf.max_queued)
+
+    def set_last_will(self, device_id: str, status: DevStatus) -> None:
+        """Set state broker publishes for device on ungraceful disconnect (call before connect).
+
+        MQTT allows one will per connection, so a shared connection can only cover one device.
+        """
 
-        # Set last will
-        pload = self._status_payload(last_will)
-        topic = f"{self.topic}/{self.device_id}/state"
-        self._client.will_set(topic, payload=json.dumps(pload), qos=2, retain=False)
-        self._log.debug("Last will set to [bright_yellow]%s[/]", last_will)
+        pload = self._status_payload(device_id, status)
+        topic = f"{self.topic}/{device_id}/state"
+        self._client.will_set(topic, payload=json.dumps(pload), qos=self._conf.qos["state"], retain=False)
+        self._log.debug("Last will set to [bright_yellow]%s[/]", status)
+
+    def add_device(self, device_id: str) -> None:
+        """Subscribe to device's command topic (now, and again after every reconnect)."""
+
+        with self._devices_lock:
+            self._devices.add(device_id)
+        if self._client.is_connected():
+            self._sub(self._client, f"{self.topic}/{device_id}/commands")
+
+    def remove_device(self, device_id: str) -> None:
+        """Unsubscribe from device's command topic."""
+
+        with self._devices_lock:
+            self._devices.discard(device_id)
+        self._client.unsubscribe(f"{self.topic}/{device_id}/commands")
 
     def connect(self) -> bool:
         """Connect to MQTT broker. Return True on success."""
 
         self._log.debug("Connecting to MQTT broker [bright_magenta]%s:%d[/]", self.broker, self.port)
-        res1 = self._client.connect(self.broker, self.port, keepalive=MqttClient.KEEPALIVE)
-
-        if res1 != MQTTErrorCode.MQTT_ERR_SUCCESS:
+        try:
+            res1 = self._client.connect(self.broker, self.port, keepalive=MqttClient.KEEPALIVE)
+        except OSError as e:
+            if self._spool is None:
+                self._log.critical("MQTT connect failed: %s", e)
+                return False
+            # Broker down at startup - keep retrying in the background & spool meanwhile
+            self._log.warning("MQTT broker unreachable (%s), spooling until it's back", e)
+            self._client.connect_async(self.broker, self.port, keepalive=MqttClient.KEEPALIVE)
+            res1 = None
+
+        if res1 not in (MQTTErrorCode.MQTT_ERR_SUCCESS, None):
             self._log.critical("MQTT connect failed with rc=%s", res1)
             return False
 
@@ -89,13 +209,22 @@ class MqttClient:
             self._log.critical("MQTT connect (loop start) failed with rc=%s", res2)
             return False
 
-        self._log.info("Connected to [bright_magenta]%s:%d[/]", self.broker, self.port)
+        if self._spool is not None:
+            self._replay_thread.start()
+
+        if res1 is not None:
+            self._log.info("Connected to [bright_magenta]%s:%d[/]", self.broker, self.port)
         return True
 
     def disconnect(self) -> None:
         """Disconnect from MQTT broker and stop loop."""
 
         self._log.debug("Disconnecting from MQTT broker [bright_magenta]%s:%d[/]", self.broker, self.port)
+        if self._replay_thread.is_alive():
+            self._replay_stop.set()
+            self._replay_wake.set()
+            self._replay_thread.join()
+
         res1 = self._client.disconnect()
 
         if res1 != MQTTErrorCode.MQTT_ERR_SUCCESS:
@@ -108,60 +237,267 @@ class MqttClient:
 
         self._log.info("Disconnected from [bright_magenta]%s:%d", self.broker, self.port)
 
-    def publish_state(self, status: DevStatus) -> MQTTMessageInfo:
+    def publish_state(
+        self,
+        device_id: str,
+        status: DevStatus,
+        *,
+        heartbeat: bool = False,
+        clock: ClockReport | None = None,
+        pipeline: PipelineReport | None = None,
+    ) -> MQTTMessageInfo:
         """Publish device state to MQTT.
 
         Args:
+            device_id: Device the state is for
             status: Device status
+            heartbeat: Periodic refresh rather than a state change (published at heartbeat QoS)
+            clock: Latest clock sync estimate (offset/drift), if any
+            pipeline: Bridge queue depth & per-stage latency, if any
 
         Returns:
             MQTTMessageInfo for caller to wait on if needed
         """
 
-        return self._pub("state", self._status_payload(status), frm="Agent", to="MQTT")
-
-    def publish_event(self, event: Any) -> None:  # noqa: ANN401
+        pload = self._status_payload(device_id, status)
+        if clock is not None:
+            pload["clock"] = clock
+        if pipeline is not None:
+            pload["pipeline"] = pipeline
+        if self._spool is not None:
+            pload["spool"] = self._spool.report()
+        qos = self._conf.qos["heartbeat" if heartbeat else "state"]
+        return self._pub(device_id, "state", pload, frm="Agent", to="MQTT", qos=qos)
+
+    def publish_event(
+        self,
+        device_id: str,
+        event: RawEvent,
+        *,
+        ts: int | None = None,
+        read_at: float | None = None,
+    ) -> None:
         """Publish game event to MQTT.
 
         Args:
-            event: Game event
+            device_id: Device the event came from
+            event: Game event (dict, or raw JSON object bytes from device)
+            ts: Wall-clock ms when event happened on device (defaults to now)
+            read_at: perf_counter() when event was read from serial (for end-to-end latency)
         """
 
-        pload = event | self._common_payload()
-        self._pub("game_events", pload, frm="Device", to="MQTT")
+        pload = self._event_payload(device_id, event, ts)
+        self._pub_or_spool(device_id, "game_events", pload, frm="Device", read_at=read_at)
+
+    def publish_events(self, device_id: str, events: list[OutEvent]) -> None:
+        """Publish game events to MQTT, packed into game_events_batch messages if batching is enabled.
+
+        Args:
+            device_id: Device the events came from
+            events: (event, ts, read_at) in order (see publish_event); a batch's latency is its oldest read
+        """
+
+        if not self._conf.batch_max:
+            for event, ts, read_at in events:
+                self.publish_event(device_id, event, ts=ts, read_at=read_at)
+            return
+
+        for i in range(0, len(events), self._conf.batch_max):
+            chunk = events[i : i + self._conf.batch_max]
+            # BatchPayload, assembled from the already-encoded events
+            events_json = b",".join(self._event_payload(device_id, event, ts) for event, ts, _ in chunk)
+            pload = fastjson.dumps(self._common_payload(device_id))[:-1] + b',"events":[' + events_json + b"]}"
+            read_at = min((r for _, _, r in chunk if r is not None), default=None)
+            self._pub_or_spool(device_id, "game_events_batch", pload, frm="Device", read_at=read_at)
+
+    def publish_status(self, device_id: str, snapshot: RawEvent) -> None:
+        """Publish device status snapshot to MQTT (retained, so late subscribers resync).
+
+        Args:
+            device_id: Device the snapshot came from
+            snapshot: Status line from device (game state, pause, buffer fill; dict or raw bytes)
+        """
+
+        pload = fastjson.splice(snapshot, self._common_payload(device_id))
+        self._pub_or_spool(device_id, "status", pload, frm="Device", retain=True)
+
+    def publish_command_result(self, device_id: str, result: CommandResult) -> None:
+        """Publish a command's outcome (applied, superseded, ...; see commands.py) at status QoS.
+
+        Not spooled: results are only useful to a dashboard that's waiting on them.
+
+        Args:
+            device_id: Device the command was for
+            result: Command's result
+        """
+
+        pload: CommandAckPayload = {**self._common_payload(device_id), **result}
+        self._pub(device_id, "command_acks", pload, frm="Device", to="MQTT", qos=self._conf.qos["status"])
+
+    def publish_metrics(self, snapshot: MetricsSnapshot) -> None:
+        """Publish bridge metrics to MQTT (at heartbeat QoS, on <namespace>/<client_id>/metrics).
+
+        Args:
+            snapshot: Counters & latency percentiles (see Metrics.snapshot())
+        """
+
+        pload: MetricsPayload = {**snapshot, "bridge": self.client_id, "ts": time_now_ms()}
+        self._pub(self.client_id, "metrics", pload, frm="Agent", to="MQTT", qos=self._conf.qos["heartbeat"])
 
     ################################################# Utility Methods ##################################################
 
-    def _common_payload(self) -> CommonPayload:
-        """Return common payload for outgoing MQTT messages."""
-        return {"device_id": self.device_id, "ts": time_now_ms()}
+    @staticmethod
+    def _common_payload(device_id: str, ts: int | None = None) -> CommonPayload:
+        """Return common payload for outgoing MQTT messages (ts defaults to now)."""
+        return {"device_id": device_id, "ts": time_now_ms() if ts is None else ts}
 
-    def _status_payload(self, status: DevStatus) -> StatusPayload:
+    def _event_payload(self, device_id: str, event: RawEvent, ts: int | None) -> bytes:
+        """Return encoded game event payload (EventPayload), stamped with device's next sequence number."""
+
+        if (seq := self._seqs.get(device_id)) is None:
+            seq = self._seqs.setdefault(device_id, itertools.count())
+        fields = self._common_payload(device_id, ts) | {"seq": next(seq), "seq_epoch": self._seq_epoch}
+        return fastjson.splice(event, fields)
+
+    @staticmethod
+    def _status_payload(device_id: str, status: DevStatus) -> StatusPayload:
         """Return status payload for bridge state messages."""
-        return {**self._common_payload(), "status": status}
+        return {**MqttClient._common_payload(device_id), "status": status}
 
-    def _pub(self, topic: str, pload: CommonPayload | StatusPayload, *, frm: str, to: str) -> MQTTMessageInfo:
+    def _pub(
+        self,
+        device_id: str,
+        topic: Topic,
+        pload: CommonPayload | StatusPayload | CommandAckPayload | MetricsPayload | bytes,
+        *,
+        frm: str,
+        to: str,
+        qos: int,
+        retain: bool = False,
+        read_at: float | None = None,
+    ) -> MQTTMessageInfo:
         """Publish payload to given topic.
 
         Args:
-            topic: MQTT topic
-            pload: Payload
+            device_id: Device the message is about
+            topic: MQTT topic (under device's namespace)
+            pload: Payload (or already-encoded JSON)
 
         Keywords Args:
             frm: Source
             to: Destination
+            qos: MQTT QoS level
+            retain: Whether broker should retain the message
+            read_at: perf_counter() when the payload was read from serial (None if not from device)
 
         Returns:
             MQTTMessageInfo for caller to wait on if needed
         """
         self._log.debug("[bright_white on grey30][%s -> %s][/] %s", frm, to, pload)
-        res = self._client.publish(f"{self.topic}/{self.device_id}/{topic}", json.dumps(pload), qos=2)
+        data = pload if isinstance(pload, bytes) else fastjson.dumps(pload)
+        res = self._client.publish(f"{self.topic}/{device_id}/{topic}", data, qos=qos, retain=retain)
 
         if res.rc != MQTTErrorCode.MQTT_ERR_SUCCESS:
             self._log.error("MQTT publish failed with rc=%s", res.rc)
+            METRICS.inc("publish_failures", device_id)
+        else:
+            METRICS.inc("published", device_id)
+        self._track(res, read_at)
 
         return res
 
+    def _pub_or_spool(
+        self,
+        device_id: str,
+        topic: Topic,
+        pload: bytes,
+        *,
+        frm: str,
+        retain: bool = False,
+        read_at: float | None = None,
+    ) -> None:
+        """Publish encoded payload, or append it to the spool if the broker is unreachable (or spool not drained)."""
+
+        if self._spool is None or (self._client.is_connected() and not self._spool.depth):
+            qos = self._topic_qos(topic)
+            res = self._pub(device_id, topic, pload, frm=frm, to="MQTT", qos=qos, retain=retain, read_at=read_at)
+            # NO_CONN (dropped since the check) is fine - paho keeps it & sends it on reconnect
+            if self._spool is None or res.rc != MQTTErrorCode.MQTT_ERR_QUEUE_SIZE:
+                return
+
+        self._log.debug("[bright_white on grey30][%s -> Spool][/] %s", frm, pload)
+        self._spool.append(f"{self.topic}/{device_id}/{topic}", pload.decode(), retain=retain)
+        METRICS.inc("spooled", device_id)
+        self._replay_wake.set()
+
+    def _replay_spool(self) -> None:
+        """Re-publish spooled messages in order whenever connected (runs in replay thread).
+
+        A batch is acked in the spool only once the broker has acked it; anything unacked is
+        re-sent after the next reconnect (at-least-once).
+        """
+
+        assert self._spool is not None  # noqa: S101 - thread only started with a spool
+        while not self._replay_stop.is_set():
+            if not self._client.is_connected() or not (batch := self._spool.pending(SPOOL_REPLAY_BATCH)):
+                self._replay_wake.wait(1)
+                self._replay_wake.clear()
+                continue
+
+            sent: list[tuple[int, MQTTMessageInfo]] = []
+            for rec in batch:
+                info = self._client.publish(rec.topic, rec.payload, qos=self._topic_qos(rec.topic), retain=rec.retain)
+                self._track(info, None)
+                sent.append((rec.seq, info))
+            acked = 0
+            for (seq, info), rec in zip(sent, batch, strict=True):
+                try:
+                    info.wait_for_publish(SPOOL_REPLAY_ACK_TIMEOUT)
+                except (RuntimeError, ValueError):
+                    break
+                if not info.is_published():
+                    break
+                acked = seq
+                METRICS.inc("replayed", rec.topic.split("/")[1])
+
+            if acked:
+                self._spool.ack(acked)
+                self._log.debug("Replayed spooled messages up to #%d (%d left)", acked, self._spool.depth)
+            else:
+                self._replay_wake.wait(1)  # Broker not acking - back off
+
+    def _track(self, info: MQTTMessageInfo, read_at: float | None) -> None:
+        """Start timing a publish until the broker acks it (see _on_publish)."""
+
+        if info.rc != MQTTErrorCode.MQTT_ERR_SUCCESS:
+            return
+
+        now = time.perf_counter()
+        with self._ack_lock:
+            if (acked_at := self._early_acks.pop(info.mid, None)) is None:
+                if len(self._awaiting_ack) >= ACK_TRACK_MAX:
+                    del self._awaiting_ack[next(iter(self._awaiting_ack))]  # Oldest - never acked
+                self._awaiting_ack[info.mid] = (now, read_at)
+                return
+        MqttClient._observe_ack(now, read_at, acked_at)
+
+    @staticmethod
+    def _observe_ack(published_at: float, read_at: float | None, acked_at: float) -> None:
+        METRICS.observe("broker_ack", max(0.0, acked_at - published_at))
+        if read_at is not None:
+            METRICS.observe("end_to_end", acked_at - read_at)
+
+    def _topic_qos(self, topic: str) -> int:
+        """Return QoS for a device message topic (bare or full; batches use the game event QoS)."""
+
+        match topic.rsplit("/", 1)[-1]:
+            case "status":
+                return self._conf.qos["status"]
+            case "game_events" | "game_events_batch":
+                return self._conf.qos["game_events"]
+            case _:
+                return self._conf.qos["state"]
+
     def _sub(self, client: Client, topic: str) -> None:
         """Subscribe to given topic.
 
@@ -195,7 +531,12 @@ class MqttClient:
             self._log.warning("MQTT connect failed with rc=%s", reason_code)
             return
 
-        self._sub(client, f"{self.topic}/{self.device_id}/commands")
+        with self._devices_lock:
+            devices = list(self._devices)
+        for device_id in devices:
+            self._sub(client, f"{self.topic}/{device_id}/commands")
+
+        self._replay_wake.set()  # Drain anything spooled while disconnected
         # self._sub(client, f"{self.topic}/all/commands")  # noqa: ERA001
         _ = userdata, connect_flags, properties
 
@@ -211,11 +552,35 @@ class MqttClient:
 
         if reason_code.is_failure:
             self._log.warning("MQTT disconnect failed with rc=%s", reason_code)
+            METRICS.inc("mqtt_disconnects")
 
         _ = client, userdata, disconnect_flags, properties
 
+    def _on_publish(
+        self,
+        client: Client,
+        userdata: Any,  # noqa: ANN401
+        mid: int,
+        reason_code: ReasonCode,
+        properties: Properties,
+    ) -> None:
+        """Record broker ack latency (QoS 1/2 ack, or socket write for QoS 0)."""
+
+        acked_at = time.perf_counter()
+        with self._ack_lock:
+            if (sent := self._awaiting_ack.pop(mid, None)) is None:
+                # Acked before publish() returned to _track (paho's thread is quicker)
+                if len(self._early_acks) >= ACK_TRACK_MAX:
+                    del self._early_acks[next(iter(self._early_acks))]
+                self._early_acks[mid] = acked_at
+                return
+        MqttClient._observe_ack(*sent, acked_at)
+        _ = client, userdata, reason_code, properties
+
     def _on_message(self, client: Client, userdata: Any, message: MQTTMessage) -> None:  # noqa: ANN401
-        """Forward MQTT command to registered callback."""
+        """Forward MQTT command to registered callback (with device ID from topic)."""
 
-        self.on_command(message.payload)
+        # Topic: <namespace>/<device_id>/commands
+        device_id = message.topic.split("/")[1]
+        self.on_command(device_id, message.payload)
         _ = client, userdata
@@ -0,0 +1,98 @@
+"""
+Bridge pipeline instrumentation.
+
+Every device line passes through three stages on its way to the broker:
+
+    read     line received from serial -> decoded & queued (serial reader task)
+    queue    waiting in the bounded event queue
+    publish  handed to paho (publisher task, in a worker thread)
+
+Latencies are aggregated per heartbeat window and reported on the state topic along with
+the event queue's depth, so a slow broker shows up as queue growth before it becomes loss.
+Every sample also goes into the process-wide histograms in metrics.py (cumulative, for the
+metrics endpoint).
+"""
+
+from __future__ import annotations
+
+import threading
+from typing import ClassVar, Literal, TypedDict
+
+from .metrics import METRICS
+
+type Stage = Literal["read", "queue", "publish"]
+
+
+class StageReport(TypedDict):
+    count: int
+    mean_ms: float
+    max_ms: float
+
+
+class PipelineReport(TypedDict):
+    queue_depth: int  # Events waiting right now
+    queue_peak: int  # Highest depth seen this window
+    queue_max: int  # Queue capacity (reader blocks when reached)
+    read: StageReport
+    queue: StageReport
+    publish: StageReport
+
+
+class PipelineStats:
+    """Per-stage latency & queue depth, shared between the event loop and publisher thread."""
+
+    STAGES: ClassVar[tuple[Stage, ...]] = ("read", "queue", "publish")
+
+    queue_max: int
+
+    def __init__(self, queue_max: int) -> None:
+        self.queue_max = queue_max
+
+        self._lock = threading.Lock()
+        self._depth = 0
+        self._peak = 0
+        self._count: dict[Stage, int] = dict.fromkeys(PipelineStats.STAGES, 0)
+        self._total: dict[Stage, float] = dict.fromkeys(PipelineStats.STAGES, 0.0)
+        self._max: dict[Stage, float] = dict.fromkeys(PipelineStats.STAGES, 0.0)
+
+    def record(self, stage: Stage, secs: float) -> None:
+        """Record time (in seconds) one line spent in given stage."""
+
+        METRICS.observe(stage, secs)
+        with self._lock:
+            self._count[stage] += 1
+            self._total[stage] += secs
+            self._max[stage] = max(self._max[stage], secs)
+
+    def queue_depth(self, depth: int) -> None:
+        """Record current event queue depth."""
+
+        with self._lock:
+            self._depth = depth
+            self._peak = max(self._peak, depth)
+
+    def report(self) -> PipelineReport:
+        """Return stats for the current window & start a new one."""
+
+        with self._lock:
+            stages = {stage: self._stage_report(stage) for stage in PipelineStats.STAGES}
+            report: PipelineReport = {
+                "queue_depth": self._depth,
+                "queue_peak": self._peak,
+                "queue_max": self.queue_max,
+                "read": stages["read"],
+                "queue": stages["queue"],
+                "publish": stages["publish"],
+            }
+
+            self._peak = self._depth
+            for stage in PipelineStats.STAGES:
+                self._count[stage] = 0
+                self._total[stage] = self._max[stage] = 0.0
+
+        return report
+
+    def _stage_report(self, stage: Stage) -> StageReport:
+        count = self._count[stage]
+        mean = self._total[stage] / count if count else 0.0
+        return {"count": count, "mean_ms": round(mean * 1000, 3), "max_ms": round(self._max[stage] * 1000, 3)}
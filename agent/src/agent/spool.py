@@ -0,0 +1,267 @@
+"""
+Disk-backed spool for device messages published while the MQTT broker is unreachable.
+
+Records are appended (and fsync'd) to JSONL segment files named after their first sequence
+number. A cursor file holds the last sequence number the broker acknowledged. After a crash
+or restart, replay resumes from the cursor, so delivery is at-least-once: a record can be
+re-sent if the bridge dies between the broker's ack and the cursor update.
+
+    <dir>/
+        00000000000000000001.jsonl   {"seq": 1, "at": <wall ms>, "topic": "...", "payload": "...", "retain": false}
+        00000000000000004097.jsonl
+        cursor                       last acknowledged seq
+
+Caps: once the spool exceeds max_bytes, the oldest segments are deleted. Records older than
+max_age are skipped at replay. Both count towards "dropped".
+"""
+
+from __future__ import annotations
+
+import json
+import logging
+import os
+import threading
+import time
+from collections import deque
+from dataclasses import dataclass
+from json import JSONDecodeError
+from typing import TYPE_CHECKING, ClassVar, NamedTuple, TypedDict
+
+from .misc import time_now_ms
+
+if TYPE_CHECKING:
+    from collections.abc import Iterator
+    from logging import Logger
+    from pathlib import Path
+
+
+class SpoolReport(TypedDict):
+    depth: int  # Records waiting for replay
+    bytes: int  # Size on disk (all segments)
+    dropped: int  # Records lost to size/age caps (since start)
+    replay_rate: float  # Records/s replayed since last report
+
+
+@dataclass(frozen=True, slots=True)
+class SpoolRecord:
+    seq: int
+    at: int  # Wall-clock ms when spooled
+    topic: str
+    payload: str
+    retain: bool
+
+
+class SpoolConf(NamedTuple):
+    dir: Path
+    max_bytes: int  # 0 disables spooling
+    max_age_s: int
+
+    def open(self, name: str) -> Spool | None:
+        """Open (or recover) named spool under dir (None if spooling disabled)."""
+        return Spool(self.dir / name, max_bytes=self.max_bytes, max_age_s=self.max_age_s) if self.max_bytes else None
+
+
+class Spool:
+    """Append-only, size/age-capped message spool (thread-safe)."""
+
+    SEGMENT_BYTES: ClassVar = 1 << 20
+    CURSOR_FILE: ClassVar = "cursor"
+
+    path: Path
+    max_bytes: int
+    max_age_ms: int
+
+    _log: Logger
+    _segments: deque[tuple[int, Path]]  # (first seq, path), oldest first
+
+    def __init__(self, path: Path, *, max_bytes: int, max_age_s: int) -> None:
+        self.path = path
+        self.max_bytes = max_bytes
+        self.max_age_ms = max_age_s * 1000
+
+        self._log = logging.getLogger("Spool")
+        self._lock = threading.Lock()
+        self._segments = deque()
+        self._acked = 0
+        self._next_seq = 1
+        self._bytes = 0
+        self._dropped = 0
+        self._replayed = 0
+        self._report_at = time.monotonic()
+
+        self.path.mkdir(parents=True, exist_ok=True)
+        self._recover()
+
+    # ==================== Public API ====================
+
+    @property
+    def depth(self) -> int:
+        """Number of records not yet acknowledged by the broker."""
+        return self._next_seq - 1 - self._acked
+
+    def append(self, topic: str, payload: str, *, retain: bool = False) -> None:
+        """Append a message (durable once this returns)."""
+
+        with self._lock:
+            rec = {"seq": self._next_seq, "at": time_now_ms(), "topic": topic, "payload": payload, "retain": retain}
+            data = (json.dumps(rec) + "\n").encode()
+
+            if not self._segments or self._segment_size(self._segments[-1][1]) + len(data) > Spool.SEGMENT_BYTES:
+                self._segments.append((self._next_seq, self.path / f"{self._next_seq:020d}.jsonl"))
+
+            with self._segments[-1][1].open("ab") as f:
+                f.write(data)
+                f.flush()
+                os.fsync(f.fileno())
+
+            self._next_seq += 1
+            self._bytes += len(data)
+            self._enforce_size_cap()
+
+    def pending(self, limit: int) -> list[SpoolRecord]:
+        """Return up to limit unacknowledged records, oldest first (records past max age are dropped)."""
+
+        with self._lock:
+            records: list[SpoolRecord] = []
+            expired = 0
+            cutoff = time_now_ms() - self.max_age_ms
+
+            for rec in self._iter_records(self._acked + 1):
+                if rec.at < cutoff:
+                    expired += 1
+                    continue
+                records.append(rec)
+                if len(records) >= limit:
+                    break
+
+            if expired:
+                # Stale records are never sent - ack them so depth reflects what can still be sent
+                self._ack_locked(records[0].seq - 1 if records else self._next_seq - 1)
+                self._dropped += expired
+                self._log.warning("Dropped %d spooled message(s) older than %ds", expired, self.max_age_ms // 1000)
+
+            return records
+
+    def ack(self, seq: int) -> None:
+        """Mark all records up to (and including) seq as delivered."""
+
+        with self._lock:
+            self._replayed += max(0, seq - self._acked)
+            self._ack_locked(seq)
+
+    def report(self) -> SpoolReport:
+        """Return current spool stats (replay rate is since the previous report)."""
+
+        with self._lock:
+            now = time.monotonic()
+            rate = self._replayed / max(now - self._report_at, 1e-3)
+            self._replayed = 0
+            self._report_at = now
+            return {"depth": self.depth, "bytes": self._bytes, "dropped": self._dropped, "replay_rate": round(rate, 1)}
+
+    # ==================== Internals ====================
+
+    def _recover(self) -> None:
+        """Load segments & cursor from disk (after restart or crash)."""
+
+        for seg in sorted(self.path.glob("*.jsonl")):
+            try:
+                self._segments.append((int(seg.stem), seg))
+            except ValueError:
+                self._log.warning("Ignoring unexpected file in spool: %s", seg)
+
+        cursor = self.path / Spool.CURSOR_FILE
+        if cursor.exists():
+            try:
+                self._acked = int(cursor.read_text().strip() or 0)
+            except ValueError:
+                self._log.warning("Corrupt spool cursor, replaying from start")
+
+        if self._segments:
+            self._truncate_partial_line(self._segments[-1][1])
+            last_seq = self._segments[-1][0] - 1
+            for rec in self._iter_segment(self._segments[-1][1]):
+                last_seq = rec.seq
+            self._next_seq = last_seq + 1
+
+        self._acked = min(max(self._acked, (self._segments[0][0] - 1) if self._segments else 0), self._next_seq - 1)
+        self._bytes = sum(self._segment_size(p) for _, p in self._segments)
+        self._delete_acked_segments()
+
+        if self.depth:
+            self._log.info("Spool has %d undelivered message(s) from a previous run", self.depth)
+
+    def _iter_records(self, start_seq: int) -> Iterator[SpoolRecord]:
+        """Yield records with seq >= start_seq in order."""
+
+        segments = list(self._segments)
+        for i, (_, seg) in enumerate(segments):
+            if i + 1 < len(segments) and segments[i + 1][0] <= start_seq:
+                continue  # Every record in this segment precedes start_seq
+            for rec in self._iter_segment(seg):
+                if rec.seq >= start_seq:
+                    yield rec
+
+    def _iter_segment(self, seg: Path) -> Iterator[SpoolRecord]:
+        try:
+            with seg.open("rb") as f:
+                for line in f:
+                    try:
+                        obj = json.loads(line)
+                        yield SpoolRecord(obj["seq"], obj["at"], obj["topic"], obj["payload"], obj.get("retain", False))
+                    except (JSONDecodeError, KeyError, TypeError):
+                        self._log.warning("Skipping corrupt spool record in %s", seg.name)
+        except FileNotFoundError:
+            return
+
+    def _ack_locked(self, seq: int) -> None:
+        if seq <= self._acked:
+            return
+
+        self._acked = seq
+        tmp = self.path / f"{Spool.CURSOR_FILE}.tmp"
+        tmp.write_text(str(seq))
+        tmp.replace(self.path / Spool.CURSOR_FILE)
+        self._delete_acked_segments()
+
+    def _delete_acked_segments(self) -> None:
+        """Delete segments whose records have all been acknowledged."""
+
+        while self._segments:
+            next_first = self._segments[1][0] if len(self._segments) > 1 else self._next_seq
+            if next_first - 1 > self._acked:
+                break
+            _, seg = self._segments.popleft()
+            self._bytes -= self._segment_size(seg)
+            seg.unlink(missing_ok=True)
+
+    def _enforce_size_cap(self) -> None:
+        """Delete oldest segments until under max_bytes (never the one being written)."""
+
+        while self._bytes > self.max_bytes and len(self._segments) > 1:
+            first, seg = self._segments.popleft()
+            next_first = self._segments[0][0]
+            lost = next_first - max(first, self._acked + 1)
+            self._bytes -= self._segment_size(seg)
+            seg.unlink(missing_ok=True)
+
+            if lost > 0:
+                self._dropped += lost
+                self._log.warning("Spool over %d bytes, dropped %d oldest message(s)", self.max_bytes, lost)
+            self._ack_locked(next_first - 1)
+
+    @staticmethod
+    def _truncate_partial_line(seg: Path) -> None:
+        """Cut off a half-written final line (crash mid-append) so new appends start cleanly."""
+
+        data = seg.read_bytes()
+        if data and not data.endswith(b"\n"):
+            with seg.open("r+b") as f:
+                f.truncate(data.rfind(b"\n") + 1)
+
+    @staticmethod
+    def _segment_size(seg: Path) -> int:
+        try:
+            return seg.stat().st_size
+        except FileNotFoundError:
+            return 0
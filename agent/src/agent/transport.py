@@ -0,0 +1,500 @@
+"""
+Byte transports between the bridge and a device.
+
+A DevicePipeline only needs a byte stream plus "is the device still there?", so the link is
+pluggable. Selected by the port spec given to -s:
+
+    /dev/ttyACM0        SerialTransport   real board (pyserial)
+    tcp://HOST:PORT     TcpTransport      firmware simulator / serial-over-TCP bridge
+    pty:                PtyTransport      new pseudo-terminal; a simulator opens the logged path
+    mem://NAME          MemoryTransport   in-process device end (see MemoryTransport.pair())
+    replay://PATH       ReplayTransport   recorded traffic (see capture.py); ?speed=N (0 = max)
+
+Any transport can be wrapped in a CaptureTransport to record its traffic for later replay.
+
+All transports raise TransportError (an OSError) for I/O failures, so reconnect handling is
+the same for all of them. Blocking calls are made from the pipeline's I/O threads.
+"""
+
+from __future__ import annotations
+
+import contextlib
+import logging
+import os
+import select
+import socket
+import threading
+import time
+from datetime import UTC, datetime
+from fnmatch import fnmatch
+from pathlib import Path
+from typing import TYPE_CHECKING, ClassVar, Protocol
+from urllib.parse import parse_qs, urlsplit
+
+from serial import Serial, SerialException
+from serial.tools import list_ports
+
+from .capture import CaptureReader, CaptureWriter, Kind, Record
+
+if TYPE_CHECKING:
+    from collections.abc import Iterator
+    from collections.abc import Set as AbstractSet
+
+# Max secs a read blocks waiting for the first byte (keeps reader tasks responsive to cancel)
+READ_TIMEOUT = 0.1
+
+
+class TransportError(OSError):
+    """Transport I/O failure (port gone, connection closed, ...)."""
+
+
+class Transport(Protocol):
+    """Bidirectional byte stream to one device."""
+
+    @property
+    def name(self) -> str:
+        """Human-readable endpoint (port path/address), used in logs & as the port key."""
+        ...
+
+    def open(self) -> None:
+        """(Re)open the link, discarding stale input. Raises TransportError on failure."""
+        ...
+
+    def close(self) -> None:
+        """Close the link (idempotent)."""
+        ...
+
+    def read(self, max_bytes: int) -> bytes:
+        """Return up to max_bytes, blocking up to READ_TIMEOUT for the first (b"" on timeout)."""
+        ...
+
+    def write(self, data: bytes) -> None:
+        """Write all of data."""
+        ...
+
+    def present(self) -> bool:
+        """Return False if the device is known to be gone for good (e.g. USB unplugged)."""
+        ...
+
+
+def make_transport(spec: str, baud_rate: int) -> Transport:
+    """Return (unopened) transport for a port spec (see module docstring)."""
+
+    scheme, sep, rest = spec.partition("://")
+    if spec.startswith("pty:") and not rest:
+        return PtyTransport()
+    if not sep:
+        return SerialTransport(spec, baud_rate)
+
+    match scheme:
+        case "tcp":
+            host, _, port = rest.rpartition(":")
+            if not host or not port.isdigit():
+                msg = f"expected tcp://HOST:PORT, got {spec!r}"
+                raise ValueError(msg)
+            return TcpTransport(host, int(port))
+        case "mem":
+            return MemoryTransport.lookup(rest)
+        case "replay":
+            url = urlsplit(spec)
+            speed = parse_qs(url.query).get("speed", ["1"])[0]
+            try:
+                return ReplayTransport(Path(url.netloc + url.path), speed=float(speed))
+            except (OSError, ValueError) as e:
+                msg = f"bad replay spec {spec!r}: {e}"
+                raise ValueError(msg) from e
+        case _:
+            msg = f"unknown transport {scheme!r} in {spec!r}"
+            raise ValueError(msg)
+
+
+class SerialTransport:
+    """UART via pyserial."""
+
+    port: str
+    baud_rate: int
+
+    def __init__(self, port: str, baud_rate: int) -> None:
+        self.port = port
+        self.baud_rate = baud_rate
+        self._serial: Serial | None = None
+
+    @staticmethod
+    def scan(glob: str) -> AbstractSet[str]:
+        """Return serial ports matching glob (for hot-plug discovery)."""
+        return {p.device for p in list_ports.comports() if fnmatch(p.device, glob)}
+
+    @property
+    def name(self) -> str:
+        return self.port
+
+    def open(self) -> None:
+        self.close()
+        try:
+            self._serial = Serial(self.port, self.baud_rate, timeout=READ_TIMEOUT)
+            self._serial.reset_input_buffer()
+        except (OSError, ValueError) as e:  # SerialException is an OSError
+            raise TransportError(str(e)) from e
+
+    def close(self) -> None:
+        if self._serial is not None:
+            self._serial.close()
+            self._serial = None
+
+    def read(self, max_bytes: int) -> bytes:
+        serial = self._require()
+        try:
+            return serial.read(max(1, min(serial.in_waiting, max_bytes)))
+        except (SerialException, OSError, TypeError) as e:  # TypeError: port closed under us
+            raise TransportError(str(e)) from e
+
+    def write(self, data: bytes) -> None:
+        serial = self._require()
+        try:
+            serial.write(data)
+        except (SerialException, OSError) as e:
+            raise TransportError(str(e)) from e
+
+    def present(self) -> bool:
+        # Device node check is a stat() (and follows /dev/serial/by-id links); COM ports have no node
+        if os.name == "posix":
+            return Path(self.port).exists()
+        return self.port in {p.device for p in list_ports.comports()}
+
+    def _require(self) -> Serial:
+        if self._serial is None:
+            msg = f"{self.port} not open"
+            raise TransportError(msg)
+        return self._serial
+
+
+class TcpTransport:
+    """Raw TCP byte stream (e.g. a firmware simulator, or ser2net in raw mode)."""
+
+    CONNECT_TIMEOUT: ClassVar = 5
+
+    host: str
+    port: int
+
+    def __init__(self, host: str, port: int) -> None:
+        self.host = host
+        self.port = port
+        self._sock: socket.socket | None = None
+
+    @property
+    def name(self) -> str:
+        return f"tcp://{self.host}:{self.port}"
+
+    def open(self) -> None:
+        self.close()
+        try:
+            sock = socket.create_connection((self.host, self.port), timeout=TcpTransport.CONNECT_TIMEOUT)
+        except OSError as e:
+            raise TransportError(str(e)) from e
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)  # Single-byte commands
+        sock.settimeout(READ_TIMEOUT)
+        self._sock = sock
+
+    def close(self) -> None:
+        if self._sock is not None:
+            self._sock.close()
+            self._sock = None
+
+    def read(self, max_bytes: int) -> bytes:
+        sock = self._require()
+        try:
+            data = sock.recv(max_bytes)
+        except TimeoutError:
+            return b""
+        except OSError as e:
+            raise TransportError(str(e)) from e
+        if not data:
+            msg = f"{self.name} closed by peer"
+            raise TransportError(msg)
+        return data
+
+    def write(self, data: bytes) -> None:
+        try:
+            self._require().sendall(data)
+        except OSError as e:
+            raise TransportError(str(e)) from e
+
+    def present(self) -> bool:
+        return True  # Can't tell from here - reconnect attempts decide
+
+    def _require(self) -> socket.socket:
+        if self._sock is None:
+            msg = f"{self.name} not connected"
+            raise TransportError(msg)
+        return self._sock
+
+
+class PtyTransport:
+    """New pseudo-terminal; the device side (e.g. a simulator) opens its path (see name).
+
+    The bridge keeps the slave end open too, so the simulator can come and go without the
+    master seeing EIO.
+    """
+
+    def __init__(self) -> None:
+        import pty  # noqa: PLC0415 - POSIX only (termios); the module must import on Windows
+        import tty  # noqa: PLC0415
+
+        self._master, self._slave = pty.openpty()
+        tty.setraw(self._slave)
+        self._path = os.ttyname(self._slave)
+
+    @property
+    def name(self) -> str:
+        return self._path
+
+    def open(self) -> None:
+        # Discard anything written before (re)open, like reset_input_buffer()
+        while select.select([self._master], [], [], 0)[0]:
+            if not os.read(self._master, 4096):
+                break
+
+    def close(self) -> None:
+        """Pty is kept for the transport's lifetime (its path must stay stable for the device)."""
+
+    def read(self, max_bytes: int) -> bytes:
+        try:
+            if not select.select([self._master], [], [], READ_TIMEOUT)[0]:
+                return b""
+            return os.read(self._master, max_bytes)
+        except OSError as e:
+            raise TransportError(str(e)) from e
+
+    def write(self, data: bytes) -> None:
+        try:
+            view = memoryview(data)
+            while view:
+                view = view[os.write(self._master, view) :]
+        except OSError as e:
+            raise TransportError(str(e)) from e
+
+    def present(self) -> bool:
+        return True
+
+    def __del__(self) -> None:
+        for fd in (self._master, self._slave):
+            with contextlib.suppress(OSError):
+                os.close(fd)
+
+
+class MemoryTransport:
+    """One end of an in-process byte pipe (for simulators & load tests without any OS device).
+
+    Create both ends with pair(name); the bridge end can then be opened as mem://<name>.
+    """
+
+    _registry: ClassVar[dict[str, MemoryTransport]] = {}
+    _registry_lock: ClassVar = threading.Lock()
+
+    _peer: MemoryTransport
+
+    def __init__(self, name: str) -> None:
+        self._name = name
+        self._rx = bytearray()
+        self._cond = threading.Condition()
+        self._closed = False
+
+    @classmethod
+    def pair(cls, name: str) -> tuple[MemoryTransport, MemoryTransport]:
+        """Create a connected (bridge end, device end) pair, registering the bridge end as mem://<name>."""
+
+        bridge, device = cls(f"mem://{name}"), cls(f"mem://{name}#device")
+        bridge._peer, device._peer = device, bridge
+        with cls._registry_lock:
+            cls._registry[name] = bridge
+        return bridge, device
+
+    @classmethod
+    def lookup(cls, name: str) -> MemoryTransport:
+        with cls._registry_lock:
+            if (end := cls._registry.get(name)) is None:
+                msg = f"no in-memory transport named {name!r} (create it with MemoryTransport.pair())"
+                raise ValueError(msg)
+        return end
+
+    @property
+    def name(self) -> str:
+        return self._name
+
+    def open(self) -> None:
+        with self._cond:
+            self._closed = False
+            self._rx.clear()
+
+    def close(self) -> None:
+        with self._cond:
+            self._closed = True
+            self._cond.notify_all()
+
+    def read(self, max_bytes: int) -> bytes:
+        with self._cond:
+            if not self._rx and not self._closed:
+                self._cond.wait(READ_TIMEOUT)
+            if self._closed:
+                msg = f"{self._name} closed"
+                raise TransportError(msg)
+            data = bytes(self._rx[:max_bytes])
+            del self._rx[:max_bytes]
+            return data
+
+    def write(self, data: bytes) -> None:
+        if self._closed:
+            msg = f"{self._name} closed"
+            raise TransportError(msg)
+        self._peer.deliver(data)
+
+    def deliver(self, data: bytes) -> None:
+        """Append data to this end's input (called by the peer's write())."""
+
+        with self._cond:
+            self._rx += data
+            self._cond.notify_all()
+
+    def present(self) -> bool:
+        return True
+
+
+class CaptureTransport:
+    """Wraps a transport, recording every chunk read & written (see capture.py).
+
+    Writes <dir>/<port>-<UTC start time>.whcap; replay it with replay://<file>. close() ends the
+    capture (and closes the file), so the wrapper isn't reopened after it: wrap the transport anew.
+    """
+
+    inner: Transport
+
+    def __init__(self, inner: Transport, capture_dir: Path, *, baud_rate: int | None = None) -> None:
+        self.inner = inner
+        started = datetime.now(UTC)
+        path = capture_dir / f"{Path(inner.name).name}-{started:%Y%m%dT%H%M%SZ}.whcap"
+        self._writer = CaptureWriter(path, {"port": inner.name, "baud_rate": baud_rate, "started": started.isoformat()})
+        logging.getLogger("Bridge").info("Capturing %s traffic to [cyan]%s[/]", inner.name, path)
+
+    @property
+    def name(self) -> str:
+        return self.inner.name
+
+    def open(self) -> None:
+        self.inner.open()
+        self._writer.write(Kind.OPEN)
+
+    def close(self) -> None:
+        self.inner.close()
+        self._writer.close()  # No-op if already closed
+
+    def read(self, max_bytes: int) -> bytes:
+        if data := self.inner.read(max_bytes):
+            self._writer.write(Kind.RX, data)
+        return data
+
+    def write(self, data: bytes) -> None:
+        self._writer.write(Kind.TX, data)
+        self.inner.write(data)
+
+    def present(self) -> bool:
+        return self.inner.present()
+
+
+class ReplayTransport:
+    """Feeds a capture's device -> bridge bytes back at the recorded pace, scaled by speed.
+
+    speed=1 reproduces the original timing, N replays N times faster, 0 as fast as the bridge
+    reads. Bytes the bridge writes are discarded (the device's answers are in the capture).
+    At the end of the capture reads fail and the device reports absent, so the bridge exits.
+    """
+
+    path: Path
+    speed: float
+
+    _records: Iterator[Record] | None
+    _current: Record | None
+
+    def __init__(self, path: Path, *, speed: float = 1.0) -> None:
+        if speed < 0:
+            msg = f"speed must be >= 0, got {speed}"
+            raise ValueError(msg)
+
+        self.path = path
+        self.speed = speed
+
+        self._log = logging.getLogger("Bridge")
+        self._reader = CaptureReader(path)
+        self._records = None
+        self._current = None
+        self._start = 0.0
+        self._done = False
+        self._rx_bytes = 0
+
+    @property
+    def name(self) -> str:
+        return f"replay://{self.path}"
+
+    def open(self) -> None:
+        if self._done:
+            msg = f"{self.name} already finished"
+            raise TransportError(msg)
+        if self._records is None:  # First open starts the clock; reopens carry on
+            self._log.info("Replaying %s (captured %s) at %s", self.path, self._reader.meta.get("port"), self._pace())
+            self._records = self._reader.records()
+            self._start = time.monotonic()
+
+    def close(self) -> None:
+        """Nothing to release (position is kept)."""
+
+    def read(self, max_bytes: int) -> bytes:
+        if self._records is None:
+            msg = f"{self.name} not open"
+            raise TransportError(msg)
+
+        out = bytearray()
+        deadline = time.monotonic() + READ_TIMEOUT
+        while len(out) < max_bytes:
+            if (rec := self._next_rx()) is None:
+                if out:
+                    break
+                self._done = True
+                self._log.info("Replay of %s finished (%d bytes)", self.path, self._rx_bytes)
+                msg = f"end of {self.name}"
+                raise TransportError(msg)
+
+            if (wait := self._due(rec) - time.monotonic()) > 0:
+                if out or wait > deadline - time.monotonic():
+                    time.sleep(0 if out else max(0.0, deadline - time.monotonic()))
+                    break  # Return what's due (or nothing, like a serial read timeout)
+                time.sleep(wait)
+
+            take = rec.data[: max_bytes - len(out)]
+            out += take
+            self._current = rec._replace(data=rec.data[len(take) :]) if len(take) < len(rec.data) else None
+
+        self._rx_bytes += len(out)
+        return bytes(out)
+
+    def write(self, data: bytes) -> None:
+        """Discard (see class docstring)."""
+
+    def present(self) -> bool:
+        return not self._done
+
+    def _next_rx(self) -> Record | None:
+        """Return the current partly-consumed or next RX record (None at end)."""
+
+        assert self._records is not None  # noqa: S101 - only called once open
+        rec = self._current
+        while rec is None or rec.kind is not Kind.RX or not rec.data:
+            if (rec := next(self._records, None)) is None:
+                break
+        self._current = rec
+        return rec
+
+    def _due(self, rec: Record) -> float:
+        """Return monotonic time rec should be delivered at."""
+        return self._start + rec.t_us / 1e6 / self.speed if self.speed else 0.0
+
+    def _pace(self) -> str:
+        return "max speed" if not self.speed else f"{self.speed:g}x"
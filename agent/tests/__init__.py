@@ -0,0 +1 @@
+"""Agent tests (stdlib unittest): `python -m unittest -v` from agent/."""
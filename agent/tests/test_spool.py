@@ -0,0 +1,344 @@
+"""Spool crash recovery: the bridge killed around Spool.append() & MqttClient._replay_spool().
+
+A kill is simulated by abandoning the Spool/MqttClient mid-call and reopening the spool from
+disk (all its state is there: appends are fsync'd, the cursor is replaced atomically). With
+mosquitto on PATH, the bridge is also run as a process against a local broker & SIGKILLed.
+"""
+
+import contextlib
+import itertools
+import multiprocessing as mp
+import shutil
+import socket
+import subprocess
+import tempfile
+import threading
+import time
+import unittest
+from collections import Counter
+from collections.abc import Callable
+from pathlib import Path
+from unittest import mock
+
+from paho.mqtt.client import Client, MQTTMessage
+from paho.mqtt.enums import CallbackAPIVersion, MQTTErrorCode
+
+from agent.mqtt import SPOOL_REPLAY_BATCH, MqttClient
+from agent.spool import Spool
+
+TOPIC = "whac/dev0/game_events"
+N_RECORDS = 250  # > 2 * SPOOL_REPLAY_BATCH, so replay spans several batches
+SEGMENT_BYTES = 2048  # Several segments, so acked ones get deleted along the way
+DRAIN_TIMEOUT = 10
+
+# Against mosquitto: records spooled, kills (each once the run has delivered KILL_AFTER records)
+BROKER_RECORDS = 2000
+BROKER_KILLS = 3
+KILL_AFTER = SPOOL_REPLAY_BATCH * 3 // 2  # Mid-batch
+QUIET_S = 0.3  # No deliveries for this long: the killed bridge's last publishes are all in
+
+# Replay steps (see _Client.step) to get a batch acked: a connection check, then per record a
+# publish & a wait for the broker's ack
+BATCH_STEPS = 1 + 2 * SPOOL_REPLAY_BATCH
+
+
+class _Crash(BaseException):
+    """The bridge dying (not an Exception, so nothing on the way up handles it)."""
+
+
+class _Info:
+    """Stand-in for paho's MQTTMessageInfo (the broker acks at once)."""
+
+    _mids = itertools.count(1)
+
+    def __init__(self, client: "_Client") -> None:
+        self.rc = MQTTErrorCode.MQTT_ERR_SUCCESS
+        self.mid = next(_Info._mids)
+        self._client = client
+
+    def wait_for_publish(self, timeout: float | None = None) -> None:
+        _ = timeout
+        self._client.step()
+
+    def is_published(self) -> bool:
+        return True
+
+
+class _Client:
+    """Stand-in for paho's Client: delivers to the broker, dying after crash_after steps (if set)."""
+
+    def __init__(self, broker: list[str], crash_after: int | None = None) -> None:
+        self.broker = broker  # Payloads the broker has received, in order
+        self.crash_after = crash_after
+
+    def step(self) -> None:
+        if self.crash_after is None:
+            return
+        if self.crash_after == 0:
+            raise _Crash
+        self.crash_after -= 1
+
+    def is_connected(self) -> bool:
+        self.step()
+        return True
+
+    def publish(self, topic: str, payload: str, qos: int = 0, *, retain: bool = False) -> _Info:
+        _ = topic, qos, retain
+        self.step()
+        self.broker.append(payload)
+        return _Info(self)
+
+
+class _Bridge:
+    """One bridge run: the spool opened from disk & an MqttClient replaying it to the broker."""
+
+    def __init__(self, path: Path, client: _Client) -> None:
+        self.spool = open_spool(path)
+        self.mqtt = MqttClient(broker="localhost", port=1883, client_id="test", topic="whac", on_command=print)
+        self.mqtt._spool = self.spool  # noqa: SLF001
+        self.mqtt._client = client  # type: ignore[assignment]  # noqa: SLF001
+
+    def run_until_killed(self) -> None:
+        with contextlib.suppress(_Crash):
+            self.mqtt._replay_spool()  # noqa: SLF001
+
+    def drain(self) -> None:
+        """Replay (in the replay thread, as when running) until the broker has acked everything."""
+
+        replay = threading.Thread(target=self.mqtt._replay_spool)  # noqa: SLF001
+        replay.start()
+        deadline = time.monotonic() + DRAIN_TIMEOUT
+        while self.spool.depth and time.monotonic() < deadline:
+            time.sleep(0.01)
+        self.mqtt._replay_stop.set()  # noqa: SLF001
+        self.mqtt._replay_wake.set()  # noqa: SLF001
+        replay.join()
+
+
+class _Subscriber:
+    """Client subscribed (QoS 1) to every game event at the broker; collects their payloads in order."""
+
+    def __init__(self, port: int) -> None:
+        self.payloads: list[str] = []
+        self._subscribed = threading.Event()
+        self._client = Client(callback_api_version=CallbackAPIVersion.VERSION2)
+        self._client.on_message = self._on_message
+        self._client.on_subscribe = lambda *_: self._subscribed.set()
+        self._client.connect("127.0.0.1", port)
+        self._client.subscribe(TOPIC.replace("dev0", "+"), qos=1)
+        self._client.loop_start()
+        if not self._subscribed.wait(DRAIN_TIMEOUT):
+            msg = "subscription not acked"
+            raise TimeoutError(msg)
+
+    def _on_message(self, client: Client, userdata: object, message: MQTTMessage) -> None:
+        _ = client, userdata
+        self.payloads.append(message.payload.decode())
+
+    def wait_quiet(self) -> None:
+        """Wait until deliveries stop (the killed bridge's last publishes have all come through)."""
+
+        n = -1
+        while n != len(self.payloads):
+            n = len(self.payloads)
+            time.sleep(QUIET_S)
+
+    def close(self) -> None:
+        self._client.disconnect()
+        self._client.loop_stop()
+
+
+def run_bridge(path: Path, port: int) -> None:
+    """One bridge run (in its own process): connect with the spool at path & replay it until killed."""
+
+    mqtt = MqttClient(broker="127.0.0.1", port=port, client_id="spool-test", topic="whac", on_command=print)
+    mqtt._spool = open_spool(path)  # noqa: SLF001
+    mqtt.connect()
+    threading.Event().wait()
+
+
+def free_port() -> int:
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def wait_until(condition: Callable[[], bool], what: str) -> None:
+    deadline = time.monotonic() + DRAIN_TIMEOUT
+    while not condition():
+        if time.monotonic() > deadline:
+            raise TimeoutError(what)
+        time.sleep(0.001)
+
+
+def open_spool(path: Path) -> Spool:
+    return Spool(path, max_bytes=1 << 30, max_age_s=3600)
+
+
+def payload(seq: int) -> str:
+    return f'{{"event_type":"pop_result","seq":{seq}}}'
+
+
+def spool_records(path: Path, first: int, last: int) -> None:
+    spool = open_spool(path)
+    for seq in range(first, last + 1):
+        spool.append(TOPIC, payload(seq))
+
+
+def cursor(path: Path) -> int:
+    """Return last seq the spool has recorded as acked by the broker."""
+    file = path / Spool.CURSOR_FILE
+    return int(file.read_text()) if file.exists() else 0
+
+
+def resent_after_kill(path: Path, received_by_run: list[str]) -> list[str]:
+    """Return records the broker got from a killed run that its spool hadn't recorded as acked."""
+    return [p for p in received_by_run if int(p.rsplit(":", 1)[1].rstrip("}")) > cursor(path)]
+
+
+class _DeliveryTest(unittest.TestCase):
+    def assert_delivered(self, broker: list[str], n: int, resent: list[str]) -> None:
+        """Every record reached the broker, in order, once - plus once per re-send after a kill."""
+
+        self.assertEqual(list(dict.fromkeys(broker)), [payload(seq) for seq in range(1, n + 1)])
+        self.assertEqual(Counter(broker), Counter(map(payload, range(1, n + 1))) + Counter(resent))
+
+
+class SpoolCrashRecoveryTest(_DeliveryTest):
+    def setUp(self) -> None:
+        tmp = tempfile.TemporaryDirectory()
+        self.addCleanup(tmp.cleanup)
+        self.tmp = Path(tmp.name)
+        patch = mock.patch.object(Spool, "SEGMENT_BYTES", SEGMENT_BYTES)
+        patch.start()
+        self.addCleanup(patch.stop)
+
+    def test_kill_at_every_replay_step(self) -> None:
+        """Kill at each step of replaying the first two batches, then restart & drain.
+
+        Delivery is at-least-once: records the broker got after the last cursor update are
+        re-sent (subscribers drop them by seq). Nothing is lost, nothing acked is re-sent.
+        """
+
+        template = self.tmp / "template"
+        spool_records(template, 1, N_RECORDS)
+
+        for crash_after in range(2 * BATCH_STEPS + 1):
+            with self.subTest(crash_after=crash_after):
+                path = self.tmp / f"spool-{crash_after}"
+                shutil.copytree(template, path)
+                broker: list[str] = []
+
+                _Bridge(path, _Client(broker, crash_after)).run_until_killed()
+                resent = resent_after_kill(path, broker)
+                self.assertEqual(cursor(path), (crash_after // BATCH_STEPS) * SPOOL_REPLAY_BATCH)
+
+                restarted = _Bridge(path, _Client(broker))
+                self.assertEqual(restarted.spool.depth, N_RECORDS - cursor(path))
+                restarted.drain()
+
+                self.assertEqual(restarted.spool.depth, 0)
+                self.assert_delivered(broker, N_RECORDS, resent)
+
+    def test_restart_after_drain_resends_nothing(self) -> None:
+        path = self.tmp / "spool"
+        spool_records(path, 1, N_RECORDS)
+        broker: list[str] = []
+        _Bridge(path, _Client(broker)).drain()
+
+        restarted = _Bridge(path, _Client(broker))
+        self.assertEqual(restarted.spool.depth, 0)
+        restarted.drain()
+        self.assert_delivered(broker, N_RECORDS, [])
+        self.assertEqual(list(path.glob("*.jsonl")), [])  # Acked segments deleted
+
+    def test_kill_mid_append(self) -> None:
+        """A half-written record (append never returned, so it was never durable) is cut off."""
+
+        path = self.tmp / "spool"
+        spool_records(path, 1, 10)
+        with max(path.glob("*.jsonl")).open("ab") as f:
+            f.write(b'{"seq": 11, "at": 0, "topic": "whac/dev0/game_ev')
+
+        spool_records(path, 11, 20)  # Restarted bridge spools more before the broker is back
+        broker: list[str] = []
+        _Bridge(path, _Client(broker)).drain()
+        self.assert_delivered(broker, 20, [])
+
+    def test_repeated_kills_while_spooling(self) -> None:
+        """Each run spools more records & is killed mid-replay; all arrive once drained."""
+
+        path = self.tmp / "spool"
+        broker: list[str] = []
+        resent: list[str] = []
+        for run in range(5):
+            spool_records(path, run * 50 + 1, run * 50 + 50)
+            received = len(broker)
+            _Bridge(path, _Client(broker, crash_after=37 * run)).run_until_killed()
+            resent += resent_after_kill(path, broker[received:])
+
+        _Bridge(path, _Client(broker)).drain()
+        self.assert_delivered(broker, 250, resent)
+
+
+@unittest.skipUnless(shutil.which("mosquitto"), "needs mosquitto")
+class BrokerCrashRecoveryTest(_DeliveryTest):
+    """The bridge as a process, SIGKILLed mid-replay & restarted, against a local mosquitto."""
+
+    def setUp(self) -> None:
+        tmp = tempfile.TemporaryDirectory()
+        self.addCleanup(tmp.cleanup)
+        self.path = Path(tmp.name) / "spool"
+
+        self.port = free_port()
+        mosquitto = shutil.which("mosquitto")
+        assert mosquitto is not None  # noqa: S101 - class is skipped without it
+        broker = subprocess.Popen(  # noqa: S603 - fixed args
+            [mosquitto, "-p", str(self.port)], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL
+        )
+        self.addCleanup(broker.wait)
+        self.addCleanup(broker.terminate)
+        wait_until(self.broker_up, "mosquitto not listening")
+
+        self.subscriber = _Subscriber(self.port)
+        self.addCleanup(self.subscriber.close)
+
+    def broker_up(self) -> bool:
+        with socket.socket() as s:
+            return s.connect_ex(("127.0.0.1", self.port)) == 0
+
+    def start_bridge(self) -> mp.process.BaseProcess:
+        bridge = mp.get_context("spawn").Process(target=run_bridge, args=(self.path, self.port), daemon=True)
+        bridge.start()
+        self.addCleanup(bridge.join)
+        self.addCleanup(bridge.kill)
+        return bridge
+
+    def kill(self, bridge: mp.process.BaseProcess) -> None:
+        bridge.kill()
+        bridge.join()
+        self.subscriber.wait_quiet()
+
+    def test_killed_mid_replay(self) -> None:
+        """Each run is killed partway into a batch; once a last run has drained, every record arrived."""
+
+        spool_records(self.path, 1, BROKER_RECORDS)
+        received = self.subscriber.payloads
+        resent: list[str] = []
+        for _ in range(BROKER_KILLS):
+            start = len(received)
+            bridge = self.start_bridge()
+            wait_until(lambda start=start: len(received) >= start + KILL_AFTER, "bridge not replaying")
+            self.kill(bridge)
+            self.assertLess(cursor(self.path), BROKER_RECORDS)  # Killed before the spool drained
+            resent += resent_after_kill(self.path, received[start:])
+
+        bridge = self.start_bridge()
+        wait_until(lambda: cursor(self.path) == BROKER_RECORDS, "spool not drained")
+        self.kill(bridge)
+
+        self.assert_delivered(received, BROKER_RECORDS, resent)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -4,12 +4,15 @@ Dashboard entry point - MQTT subscriber and device state management.
 This module coordinates the real-time dashboard backend:
     1. Subscribes to MQTT topics for device state and game events
     2. Maintains in-memory device state (status, sessions, game progress)
-    3. Updates leaderboard on session completion
-    4. Runs timeout watchdog to detect offline devices
+    3. Updates leaderboard & archives sessions on completion (sessions.py); records every pop for
+       analytics (events.py)
+    4. Pushes each change to connected frontends (see push.py)
+    5. Runs timeout watchdog to detect offline devices
 
 Architecture:
-    MQTT Broker --> handle_message() --> DeviceState (in-memory)
-                                     --> Leaderboard (persisted to JSON)
+    MQTT Broker --> Ingest queue (see ingest.py) --> handle_messages() --> DeviceState (in-memory)
+                                                                      --> Leaderboard (SQLite)
+                                                                      --> PushHub --> /stream (SSE)
 """
 
 import threading
@@ -19,15 +22,27 @@ from typing import Any, Final
 import uvicorn
 
 from .env import APP_PORT, APP_ROOT_PATH
-from .leaderboard import add_entry, calculate_score
+from .events import analytics, record_pop
+from .events import close as close_events
+from .events import init as init_events
+from .ingest import INGEST, Message
+from .leaderboard import add_entry, session_score
+from .leaderboard import close as close_leaderboard
 from .leaderboard import init as init_leaderboard
-from .mqtt import subscribe
+from .mqtt import PUBLISHER, subscribe
+from .push import push_device, push_event, push_leaderboard, push_session
+from .sessions import archive as archive_session
+from .sessions import close as close_sessions
+from .sessions import init as init_sessions
+from .sketches import init as init_sketches
+from .sketches import record_hit
 from .state import (
-    DEV_LOCK,
     MAX_PAST_SESSIONS,
+    DeviceEntry,
     DeviceState,
     Session,
-    devices,
+    device_entry,
+    registry,
 )
 
 # Device considered offline if no MQTT message received within this window
@@ -37,49 +52,121 @@ DEVICE_TIMEOUT_MS: Final = 45_000
 # How often to check for timed-out devices (seconds)
 TIMEOUT_CHECK_INTERVAL: Final = 5
 
+# Forget pending commands with no result after this long (agent gone/predates command acks)
+PENDING_CMD_TIMEOUT_MS: Final = 30_000
 
-def handle_message(data: dict[str, Any], topic: str) -> None:
+
+def handle_messages(device_id: str, messages: list[Message]) -> list[tuple[Message, Exception]]:
+    """Apply a batch of one device's messages (in order) in a single edit - see ingest.py.
+
+    Auto-discovers new devices. Returns the messages whose handler raised (the rest still apply).
+    """
+    if (entry := registry().get(device_id)) is None:
+        # A command result can't resolve anything on a device we don't know yet (see handle_command_ack)
+        messages = [msg for msg in messages if not msg.topic.endswith("/command_acks")]
+        if not messages:
+            return []
+        entry = device_entry(device_id)
+
+    failed: list[tuple[Message, Exception]] = []
+    with entry:
+        for msg in messages:
+            try:
+                handle_message(entry, msg)
+            except Exception as e:  # noqa: BLE001 - one bad message mustn't lose the rest of the batch
+                failed.append((msg, e))
+    return failed
+
+
+def handle_message(entry: DeviceEntry, msg: Message) -> None:
     """Route MQTT messages to appropriate handlers based on topic.
 
+    Caller must be editing the device (`with entry:`).
+
     Topics:
-        whac/<device_id>/state       -> handle_state()
-        whac/<device_id>/game_events -> handle_game_event()
+        whac/<device_id>/state             -> handle_state()
+        whac/<device_id>/status            -> handle_status()
+        whac/<device_id>/game_events       -> handle_game_event()
+        whac/<device_id>/game_events_batch -> handle_game_event() per event
+        whac/<device_id>/command_acks      -> handle_command_ack()
     """
-    if "/state" in topic:
-        handle_state(data)
+    topic, data = msg.topic, msg.data
+    if topic.endswith("/command_acks"):
+        handle_command_ack(entry, data)
+    elif "/state" in topic:
+        handle_state(entry, data, msg.received)
+    elif "/status" in topic:
+        handle_status(entry, data, msg.received)
+    elif topic.endswith("/game_events_batch"):
+        for event in data.get("events", []):
+            handle_game_event(entry, event, msg.received)
     elif "/game_events" in topic:
-        handle_game_event(data)
+        handle_game_event(entry, data, msg.received)
 
 
-def handle_state(data: dict[str, Any]) -> None:
+def handle_state(entry: DeviceEntry, data: dict[str, Any], now: int) -> None:
     """Handle device state messages from Python agent.
 
-    Auto-discovers new devices and updates connection status.
+    Updates connection status (now: receive time, not message timestamp).
     Agent publishes state on connect, disconnect, and serial errors.
     """
-    if "device_id" not in data:
-        return
-
-    device_id = data["device_id"]
+    device = entry.state
     status = data.get("status")
-    now = int(time.time() * 1000)  # Use receive time, not message timestamp
+    device.last_seen = now
+    device.clock = data.get("clock", device.clock)
 
-    with DEV_LOCK:
-        # Auto-discover: create DeviceState on first message from device
-        if device_id not in devices:
-            devices[device_id] = DeviceState(device_id=device_id, last_seen=now)
+    # Preserve error/offline/unresponsive status from agent; otherwise mark online
+    if status in ("unresponsive", "serial_error", "offline"):
+        device.status = status
+    else:
+        device.status = "online"
 
-        device = devices[device_id]
-        device.last_seen = now
+    push_device(entry)
 
-        # Preserve error/offline status from agent; otherwise mark online
-        if status in ("serial_error", "offline"):
-            device.status = status
-        else:
-            device.status = "online"
 
+def handle_status(entry: DeviceEntry, data: dict[str, Any], now: int) -> None:
+    """Handle device status snapshot (retained; sent by agent on connect & pause toggle).
 
-def handle_game_event(data: dict[str, Any]) -> None:
+    Resyncs game state without waiting for the next session. Doesn't touch connection
+    status/last_seen since a retained snapshot may be older than the agent's last heartbeat.
+    """
+    device = entry.state
+    ts = data.get("ts", now)
+
+    session = device.current_session
+    device.level = data.get("lvl", device.level)
+    device.lives = data.get("lives", device.lives)
+    device.paused = data.get("paused", False)
+    device.buffered = data.get("buffered", 0)
+
+    if data.get("state") == "playing":
+        device.game_state = "playing"
+        if device.current_session is None:
+            # Joined mid-session (e.g. bridge/dashboard restart) - start tracking from here
+            device.current_session = Session(started_at=ts)
+    elif data.get("state") == "idle":
+        device.game_state = "idle"
+        device.current_session = None  # Never saw its session_end; can't be scored
+
+    push_device(entry)
+    if device.current_session is not session:
+        push_session(entry)
+
+
+def handle_command_ack(entry: DeviceEntry, data: dict[str, Any]) -> None:
+    """Handle a command's result from the agent (applied, superseded, dropped, timeout, ...).
+
+    Resolves the pending command (see pub_cmd) so the frontend can show pending vs applied. A
+    timed-out command may still be applied later; its applied result then overwrites last_cmd.
+    """
+    device = entry.state
+    if data.get("id") is not None:
+        device.pending_cmds.pop(data["id"], None)
+    device.last_cmd = {k: data.get(k) for k in ("cmd", "id", "status", "rtt_ms", "total_ms", "ts")}
+    push_device(entry)
+
+
+def handle_game_event(entry: DeviceEntry, data: dict[str, Any], now: int) -> None:
     """Handle game events from embedded device (via agent).
 
     Tracks session lifecycle and calculates scores:
@@ -87,48 +174,95 @@ def handle_game_event(data: dict[str, Any]) -> None:
         pop_result    -> Append to current session events
         lvl_complete  -> Append to current session events
         session_end   -> Finalize session, calculate score, update leaderboard
+                         (device summary in session_end covers lost/suppressed pops)
+        buffer_loss   -> Count events the device dropped while offline
     """
-    if "device_id" not in data:
-        return
-
-    device_id = data["device_id"]
+    device = entry.state
     event_type = data.get("event_type")
-    now = int(time.time() * 1000)  # Use receive time, not message timestamp
     ts = data.get("ts", now)  # Keep message ts for session timestamps
+    device.last_seen = now  # Receive time, not message timestamp
 
-    with DEV_LOCK:
-        # Auto-discover device if first event
-        if device_id not in devices:
-            devices[device_id] = DeviceState(device_id=device_id)
+    if is_redelivery(device, data):
+        return
 
-        device = devices[device_id]
-        device.last_seen = now
+    if event_type == "session_start":
+        device.game_state = "playing"
+        device.current_session = Session(started_at=ts)
+        push_device(entry)
+        push_session(entry)
 
-        if event_type == "session_start":
-            device.game_state = "playing"
-            device.current_session = Session(started_at=ts)
+    elif event_type == "session_end":
+        end_session(entry, data, ts)
 
-        elif event_type == "session_end":
-            device.game_state = "idle"
-            if device.current_session:
-                device.current_session.ended_at = ts
-                device.current_session.won = data.get("win") == "true"
-                device.current_session.events.append(data)
-                device.current_session.score = calculate_score(device.current_session.events)
+    elif event_type in ("pop_result", "lvl_complete"):
+        device.level = data.get("lvl", device.level)
+        device.lives = data.get("lives", device.lives)
 
-                add_entry(device_id, device.current_session.score, ts)
+        # Only process mid-session events if session exists
+        # Drop orphaned events (e.g., late arrivals after session_end)
+        if device.current_session:
+            device.current_session.add_event(data)
+        if event_type == "pop_result":  # Kept for analytics even if orphaned
+            record_pop(device.device_id, data, ts, device.current_session.started_at if device.current_session else 0)
+            record_hit(device.device_id, data, ts)
+        push_device(entry)
+        push_event(entry, data)
+
+    elif event_type == "buffer_loss":
+        # Device's offline buffer overflowed and dropped its oldest events
+        device.events_lost += int(data.get("dropped", 0))
+        push_device(entry)
+
+
+def end_session(entry: DeviceEntry, data: dict[str, Any], ts: int) -> None:
+    """Finalize device's current session on session_end: score it, update leaderboard & archive it.
+
+    Caller must be editing the device (`with entry:`).
+    """
+    device = entry.state
+    device.game_state = "idle"
+
+    # Collapsed by the device while offline: its summary is the session. One that lost its summary
+    # too (device's summary buffer overflowed) can't be scored - its pops are in buffer_loss instead
+    compacted = bool(data.get("compacted"))
+    scorable = not compacted or "score" in data
+    if device.current_session is None and compacted and scorable:
+        device.current_session = Session(started_at=ts)  # session_start was collapsed too
+
+    archived = device.current_session is not None
+    if device.current_session:
+        device.current_session.ended_at = ts
+        device.current_session.won = data.get("win") == "true"
+        device.current_session.add_event(data)
+        if scorable:
+            device.current_session.score = session_score(device.current_session)
+            add_entry(device.device_id, device.current_session.score, ts)
+
+        # Archive session to disk (device keeps the last N sessions' summaries)
+        device.past_sessions.insert(0, archive_session(device.device_id, device.current_session))
+        device.past_sessions = device.past_sessions[:MAX_PAST_SESSIONS]
+    device.current_session = None
+
+    push_device(entry)
+    push_session(entry, archived=archived)
+    if archived and scorable:
+        push_leaderboard(entry)
+
+
+def is_redelivery(device: DeviceState, data: dict[str, Any]) -> bool:
+    """Return True if event was already handled (QoS 1 / spool replay duplicate); else record its seq.
+
+    The agent numbers events per device per run (seq_epoch); a new epoch means the agent restarted.
+    """
+    if "seq" not in data:
+        return False
 
-                # Archive session (keep last N sessions for history)
-                device.past_sessions.insert(0, device.current_session)
-                device.past_sessions = device.past_sessions[:MAX_PAST_SESSIONS]
-            device.current_session = None
+    key = (data.get("seq_epoch", 0), data["seq"])
+    if device.last_seq is not None and key[0] == device.last_seq[0] and key[1] <= device.last_seq[1]:
+        return True
 
-        elif event_type in ("pop_result", "lvl_complete"):
-            # Only process mid-session events if session exists
-            # Drop orphaned events (e.g., late arrivals after session_end)
-            if device.current_session:
-                device.current_session.events.append(data)
-                device.current_session.score = calculate_score(device.current_session.events)
+    device.last_seq = key
+    return False
 
 
 def check_device_timeouts() -> None:
@@ -136,35 +270,67 @@ def check_device_timeouts() -> None:
 
     Marks devices as "offline" if no MQTT message received within DEVICE_TIMEOUT_MS.
     Catches cases where agent crashes without sending disconnect message.
+    Also drops pending commands that never got a result (PENDING_CMD_TIMEOUT_MS).
+    Devices with nothing to change aren't edited (which would publish a new, identical snapshot).
     """
     while True:
         time.sleep(TIMEOUT_CHECK_INTERVAL)
         now = int(time.time() * 1000)
-        with DEV_LOCK:
-            for device in devices.values():
-                if device.status == "online" and (now - device.last_seen) > DEVICE_TIMEOUT_MS:
+        for entry in registry().values():
+            fields = entry.snapshot.fields
+            if not (fields["status"] == "online" and now - fields["last_seen"] > DEVICE_TIMEOUT_MS) and all(
+                now - cmd["sent_at"] <= PENDING_CMD_TIMEOUT_MS for cmd in fields["pending_cmds"].values()
+            ):
+                continue
+
+            with entry as device:
+                n_pending = len(device.pending_cmds)
+                timed_out = device.status == "online" and (now - device.last_seen) > DEVICE_TIMEOUT_MS
+                if timed_out:
                     device.status = "offline"
+                device.pending_cmds = {
+                    cmd_id: cmd
+                    for cmd_id, cmd in device.pending_cmds.items()
+                    if now - cmd["sent_at"] <= PENDING_CMD_TIMEOUT_MS
+                }
+                if timed_out or len(device.pending_cmds) != n_pending:
+                    push_device(entry)
 
 
 def main() -> None:
     """Application entry point.
 
-    1. Load persisted leaderboard from disk
+    1. Open persisted leaderboard, session archive & pop history (rebuilding reaction-time sketches from it)
     2. Subscribe to MQTT topics (wildcard '+' matches any device_id)
-    3. Start background threads for MQTT and timeout watchdog
+    3. Start background threads for MQTT (incl. the command publisher's) and timeout watchdog
     4. Launch FastAPI server via uvicorn
     """
     init_leaderboard()
+    init_sessions()
+    init_events()
+    init_sketches(analytics())
+    INGEST.start(handle_messages)
 
     # Subscribe to all device topics using MQTT wildcards
-    topics = ["whac/+/game_events", "whac/+/state"]
-    client = subscribe(topics, handle_message)
+    topics = [
+        "whac/+/game_events",
+        "whac/+/game_events_batch",
+        "whac/+/state",
+        "whac/+/status",
+        "whac/+/command_acks",
+    ]
+    client = subscribe(topics, INGEST.put)
 
     # Daemon threads auto-terminate when main exits
     threading.Thread(target=client.loop_forever, daemon=True).start()
     threading.Thread(target=check_device_timeouts, daemon=True).start()
+    PUBLISHER.start()
 
     uvicorn.run("dashboard.app:app", host="0.0.0.0", port=APP_PORT, root_path=APP_ROOT_PATH)  # noqa: S104
+    PUBLISHER.stop()
+    close_leaderboard()
+    close_sessions()
+    close_events()
 
 
 if __name__ == "__main__":
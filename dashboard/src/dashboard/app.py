@@ -2,7 +2,9 @@
 
 Provides endpoints for:
     - Serving the dashboard HTML/JS frontend
-    - Querying device state and leaderboard
+    - Querying device state, leaderboard and score history
+    - Analytics over every recorded pop (reaction times, hit rates, fleet comparison)
+    - Pushing device/leaderboard changes to the frontend (server-sent events)
     - Sending commands to devices via MQTT
 
 Commands are forwarded to devices through MQTT pub/sub. The Python agent
@@ -10,85 +12,248 @@ subscribed to the device's command topic receives the command and writes
 it to the embedded device via UART.
 """
 
-from dataclasses import asdict
+import uuid
 from importlib.resources import files
 from pathlib import Path
-from typing import Any, Final
+from typing import Any, Final, Literal
 
-from fastapi import FastAPI, HTTPException
-from fastapi.responses import HTMLResponse
-from fastapi.staticfiles import StaticFiles
+from fastapi import FastAPI, HTTPException, Query, Request
+from fastapi.responses import JSONResponse, Response, StreamingResponse
 
+from dashboard.assets import Asset, json_response, load_assets
 from dashboard.env import APP_ROOT_PATH
-from dashboard.leaderboard import get_leaderboard
-from dashboard.mqtt import pub_cmd
-from dashboard.state import DEV_LOCK, devices
-from dashboard.types import StatusOk
+from dashboard.events import GroupBy, analytics
+from dashboard.ingest import INGEST
+from dashboard.leaderboard import get_scores, leaderboard_json
+from dashboard.mqtt import PUBLISHER, PublishError, pub_cmd
+from dashboard.push import HUB, snapshot
+from dashboard.scores import ScoreWindow, window_start
+from dashboard.sessions import get_session, get_sessions
+from dashboard.sketches import SKETCHES, SketchWindow
+from dashboard.state import COMMIT_LOCK, registry, version
+from dashboard.types import (
+    CommandSent,
+    FleetStats,
+    HeatmapCell,
+    HitRateBucket,
+    IngestStats,
+    PublishStats,
+    ReactionQuantiles,
+    ScorePage,
+    SessionPage,
+)
 
 # Game level boundaries (embedded device supports levels 1-8)
 LVL_MIN: Final = 1
 LVL_MAX: Final = 8
 
+# Max score history entries per page
+SCORES_PAGE_MAX: Final = 100
+
+# Max archived session summaries per page
+SESSIONS_PAGE_MAX: Final = 100
+
 # Static files bundled with package (HTML, JS, CSS)
 STATIC_DIR: Final = Path(str(files("dashboard") / "static"))
 
 # Inject <base> tag for subpath deployment (e.g., behind reverse proxy)
 BASE_TAG: Final = f'<base href="{APP_ROOT_PATH}/">' if APP_ROOT_PATH else ""
 
-app: Final = FastAPI()
+# Static files & dashboard HTML (base tag injected), read & compressed once at startup
+STATIC: Final = load_assets(STATIC_DIR)
+_html = (STATIC_DIR / "html" / "dashboard.html").read_text()
+INDEX: Final = Asset.of(
+    (_html.replace("<head>", f"<head>\n  {BASE_TAG}", 1) if BASE_TAG else _html).encode(), "text/html; charset=utf-8"
+)
 
-# Mount static directory for JS/CSS assets
-app.mount("/static", StaticFiles(directory=STATIC_DIR), name="static")
+# Versions restart with the process, so their ETags carry this to never match an older run's
+BOOT_ID: Final = uuid.uuid4().hex[:8]
+
+app: Final = FastAPI()
 
 
 @app.get("/")
-async def dashboard() -> HTMLResponse:
+async def dashboard(request: Request) -> Response:
     """Serve main dashboard HTML with injected base tag for subpath support."""
-    html = (STATIC_DIR / "html" / "dashboard.html").read_text()
-    html = html.replace("<head>", f"<head>\n  {BASE_TAG}", 1) if BASE_TAG else html
-    return HTMLResponse(html)
+    return INDEX.response(request)
+
+
+@app.get("/static/{path:path}")
+async def get_static(path: str, request: Request) -> Response:
+    """Serve bundled JS/CSS/images (from memory; gzipped if the client accepts it)."""
+    if (asset := STATIC.get(path)) is None:
+        raise HTTPException(status_code=404, detail="Not Found")
+    return asset.response(request)
 
 
 @app.get("/devices")
-async def get_devices() -> list[dict[str, Any]]:
-    """Return all known devices with their current state (polled by frontend)."""
-    with DEV_LOCK:
-        return [asdict(dev) for dev in devices.values()]
+async def get_devices(request: Request) -> Response:
+    """Return all known devices with their current state (frontend uses /stream where it can).
+
+    Served from the devices' published snapshots, each serialized once - doesn't wait on (or hold
+    up) the MQTT handler. 304 if nothing changed since the client's copy (If-None-Match).
+    """
+    etag = f'"{BOOT_ID}-{version()}"'  # Before the snapshots (they're at least this new)
+    return json_response(request, etag, lambda: b"[" + b",".join(e.snapshot.json for e in registry().values()) + b"]")
+
+
+@app.get("/devices/{device_id}/sessions")
+def get_device_sessions(
+    device_id: str,
+    limit: int = Query(20, ge=1, le=SESSIONS_PAGE_MAX),
+    offset: int = Query(0, ge=0),
+) -> SessionPage:
+    """Return a page of device's finished sessions (summaries - events via /sessions/{id}), newest first.
+
+    Sync (not async) so SQLite reads run in the threadpool.
+    """
+    return get_sessions(device_id, limit, offset)
+
+
+@app.get("/sessions/{session_id}")
+def get_session_endpoint(session_id: int) -> dict[str, Any]:
+    """Return a finished session with its events & per-level tallies (loaded from the archive)."""
+    if (session := get_session(session_id)) is None:
+        raise HTTPException(status_code=404, detail="Session not found")
+    return session
 
 
 @app.get("/leaderboard")
-async def get_leaderboard_endpoint() -> list[dict[str, Any]]:
-    """Return top scores (persisted to disk, survives restart)."""
-    return get_leaderboard()
+async def get_leaderboard_endpoint(request: Request) -> Response:
+    """Return top scores (persisted to disk, survives restart). 304 if unchanged since the client's copy."""
+    lb_version, body = leaderboard_json()
+    return json_response(request, f'"{BOOT_ID}-lb{lb_version}"', lambda: body)
+
+
+@app.get("/scores")
+def get_scores_endpoint(
+    window: ScoreWindow = "all",
+    device_id: str | None = None,
+    limit: int = Query(20, ge=1, le=SCORES_PAGE_MAX),
+    offset: int = Query(0, ge=0),
+) -> ScorePage:
+    """Return a page of all recorded scores, highest first (optionally only today's/this week's/one device's).
+
+    Windows use the server's local time. Sync (not async) so SQLite reads run in the threadpool.
+    """
+    return get_scores(window, device_id, limit, offset)
+
+
+# === Analytics Endpoints ===
+# Over every pop recorded (see events.py), optionally only today's/this week's (server's local time).
+# Sync (not async) so the scans run in the threadpool.
+
+
+@app.get("/analytics/reaction")
+def get_reaction_times(
+    group_by: list[GroupBy] = Query(["device"]),  # noqa: B008 - FastAPI's list query parameter
+    window: ScoreWindow = "all",
+    device_id: str | None = None,
+) -> list[dict[str, Any]]:
+    """Return hit reaction-time percentiles per device/level/mole (any mix, e.g. ?group_by=lvl&group_by=mole)."""
+    return analytics().reaction_times(list(dict.fromkeys(group_by)), window_start(window), device_id)
+
+
+@app.get("/analytics/hit-rate")
+def get_hit_rates(
+    bucket: Literal["hour", "day"] = "day",
+    window: ScoreWindow = "all",
+    device_id: str | None = None,
+) -> list[HitRateBucket]:
+    """Return hit rate per hour/day (whole fleet, or one device), oldest first."""
+    return analytics().hit_rates(bucket, window_start(window), device_id)
+
+
+@app.get("/analytics/fleet")
+def get_fleet(window: ScoreWindow = "all") -> FleetStats:
+    """Return each device's pops, hit rate & median reaction time alongside the fleet's."""
+    return analytics().fleet(window_start(window))
+
+
+# Reaction-time sketches (see sketches.py): constant cost however much has been played.
+# Windows are rolling: the last hour/day/week (to within a slot), or all time.
+# Sync too: they wait on the sketches' lock (held by ingest) & merge histograms, off the event loop.
+
+
+@app.get("/analytics/quantiles")
+def get_reaction_quantiles(
+    window: SketchWindow = "day",
+    device_id: str | None = None,
+    lvl: int | None = None,
+    mole: int | None = None,
+) -> ReactionQuantiles:
+    """Return hit reaction-time p50/p90/p99 of any mix of device, level & mole (omitted: all)."""
+    return SKETCHES.quantiles(window, device_id, lvl, mole)
+
+
+@app.get("/analytics/heatmap/{device_id}")
+def get_reaction_heatmap(device_id: str, window: SketchWindow = "day") -> list[HeatmapCell]:
+    """Return device's hit reaction-time quantiles per (level, mole), e.g. to find its slow mole."""
+    return SKETCHES.heatmap(device_id, window)
+
+
+@app.get("/ingest/stats")
+async def get_ingest_stats() -> IngestStats:
+    """Return MQTT ingest queue depth, counters (dropped, decode/apply errors) & latencies."""
+    return INGEST.stats()
+
+
+@app.get("/stream")
+async def get_stream(request: Request, last_id: str | None = None) -> StreamingResponse:
+    """Stream device/leaderboard changes as server-sent events (snapshot first; see push.py).
+
+    Resumes after Last-Event-ID (sent by EventSource when it reconnects) or ?last_id=.
+    """
+    with COMMIT_LOCK:
+        client = HUB.connect(request.headers.get("last-event-id", last_id), snapshot)
+
+    return StreamingResponse(
+        client.stream(),
+        media_type="text/event-stream",
+        headers={"Cache-Control": "no-cache", "X-Accel-Buffering": "no"},  # No proxy buffering
+    )
 
 
 # === Command Endpoints ===
-# Commands are published to MQTT topic: whac/<device_id>/cmd
-# The Python agent subscribed to this topic forwards to UART
+# Commands are published to MQTT topic: whac/<device_id>/commands (with a request ID)
+# over one persistent connection (see mqtt.Publisher); 503 if the broker can't be reached.
+# The Python agent subscribed to this topic forwards to UART & reports each command's result
+# (applied/superseded/...) on whac/<device_id>/command_acks - see DeviceState.pending_cmds
+
+
+@app.exception_handler(PublishError)
+async def publish_error_handler(_: Request, exc: PublishError) -> JSONResponse:
+    return JSONResponse(status_code=503, content={"detail": str(exc)})
+
+
+@app.get("/command/stats")
+async def get_command_stats() -> PublishStats:
+    """Return command publish counts & latencies (publish to broker ack)."""
+    return PUBLISHER.stats()
 
 
 @app.post("/command/{device_id}/pause")
-async def post_pause_command(device_id: str) -> StatusOk:
+async def post_pause_command(device_id: str) -> CommandSent:
     """Toggle pause state on device. Sends 'P' command."""
-    return pub_cmd(device_id, "P")
+    return await pub_cmd(device_id, "P")
 
 
 @app.post("/command/{device_id}/reset")
-async def post_reset_command(device_id: str) -> StatusOk:
+async def post_reset_command(device_id: str) -> CommandSent:
     """Reset game to initial state. Sends 'R' command."""
-    return pub_cmd(device_id, "R")
+    return await pub_cmd(device_id, "R")
 
 
 @app.post("/command/{device_id}/start")
-async def post_start_command(device_id: str) -> StatusOk:
+async def post_start_command(device_id: str) -> CommandSent:
     """Start a new game session. Sends 'S' command."""
-    return pub_cmd(device_id, "S")
+    return await pub_cmd(device_id, "S")
 
 
 @app.post("/command/{device_id}/level/{level}")
-async def post_level_command(device_id: str, level: int) -> StatusOk:
+async def post_level_command(device_id: str, level: int) -> CommandSent:
     """Set difficulty level (1-8). Sends digit command."""
     if level < LVL_MIN or level > LVL_MAX:
         raise HTTPException(status_code=400, detail="Level must be between 1 and 8")
 
-    return pub_cmd(device_id, str(level))
+    return await pub_cmd(device_id, str(level))
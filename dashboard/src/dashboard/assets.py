@@ -0,0 +1,95 @@
+"""In-memory HTTP responses with strong ETags (304 Not Modified on a matching If-None-Match).
+
+Static files are read & gzipped once at startup instead of on every request; JSON endpoints
+pass their cached body & a version-derived ETag, so a client that already has the current
+version gets an empty 304.
+"""
+
+from __future__ import annotations
+
+import gzip
+import hashlib
+import mimetypes
+from dataclasses import dataclass
+from typing import TYPE_CHECKING, Final
+
+from fastapi.responses import Response
+
+if TYPE_CHECKING:
+    from collections.abc import Callable
+    from pathlib import Path
+
+    from fastapi import Request
+
+# Revalidate on every use (assets aren't fingerprinted), which is a 304 when nothing changed
+CACHE_CONTROL: Final = "no-cache"
+
+
+def not_modified(request: Request, etag: str) -> bool:
+    """Return True if request's If-None-Match matches etag (client's copy is current)."""
+    header = request.headers.get("if-none-match")
+    if header is None:
+        return False
+    tags = {tag.strip().removeprefix("W/") for tag in header.split(",")}  # Weak comparison (RFC 9110)
+    return "*" in tags or etag in tags
+
+
+def json_response(request: Request, etag: str, body: Callable[[], bytes]) -> Response:
+    """Return JSON from body() (serialized elsewhere), or 304 without calling it if the client has etag."""
+    headers = {"ETag": etag, "Cache-Control": CACHE_CONTROL}
+    if not_modified(request, etag):
+        return Response(status_code=304, headers=headers)
+    return Response(body(), media_type="application/json", headers=headers)
+
+
+def _accepts_gzip(request: Request) -> bool:
+    for coding in request.headers.get("accept-encoding", "").split(","):
+        name, _, params = coding.partition(";")
+        if name.strip().lower() == "gzip":
+            return params.replace(" ", "") not in ("q=0", "q=0.0", "q=0.00", "q=0.000")
+    return False
+
+
+@dataclass(frozen=True, slots=True)
+class Asset:
+    """A file's content, its gzipped form (if that's smaller) & their ETags."""
+
+    body: bytes
+    gzipped: bytes | None
+    media_type: str
+    etag: str  # Of body (strong)
+
+    @staticmethod
+    def of(body: bytes, media_type: str) -> Asset:
+        compressed = gzip.compress(body, compresslevel=9, mtime=0)
+        return Asset(
+            body=body,
+            gzipped=compressed if len(compressed) < len(body) else None,
+            media_type=media_type,
+            etag=f'"{hashlib.sha256(body).hexdigest()[:20]}"',
+        )
+
+    def response(self, request: Request) -> Response:
+        """Return asset (gzipped if the client accepts it), or 304 if the client's copy is current."""
+        use_gzip = self.gzipped is not None and _accepts_gzip(request)
+        etag = f'{self.etag[:-1]}-gz"' if use_gzip else self.etag  # Each encoding is its own representation
+        headers = {"ETag": etag, "Cache-Control": CACHE_CONTROL, "Vary": "Accept-Encoding"}
+
+        if not_modified(request, etag):
+            return Response(status_code=304, headers=headers)
+        if use_gzip:
+            headers["Content-Encoding"] = "gzip"
+            return Response(self.gzipped, media_type=self.media_type, headers=headers)
+        return Response(self.body, media_type=self.media_type, headers=headers)
+
+
+def load_assets(root: Path) -> dict[str, Asset]:
+    """Read (& compress) every file under root. Keys are paths relative to root (e.g. "js/app.js")."""
+    assets: dict[str, Asset] = {}
+    for path in sorted(root.rglob("*")):
+        if path.is_file():
+            media_type = mimetypes.guess_type(path.name)[0] or "application/octet-stream"
+            if media_type.startswith("text/"):
+                media_type += "; charset=utf-8"
+            assets[path.relative_to(root).as_posix()] = Asset.of(path.read_bytes(), media_type)
+    return assets
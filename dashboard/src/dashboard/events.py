@@ -0,0 +1,389 @@
+"""Columnar history of every pop_result, for analytics (reaction times, hit rates, fleet comparison).
+
+Sessions drop out of memory after MAX_PAST_SESSIONS (and only top scores outlive them), so every
+pop is also appended here. Pops are buffered in memory as columns (an array per field) and a
+writer thread appends them to disk as one row group every ROW_GROUP_SIZE pops or FLUSH_SECS,
+whichever comes first - recording a pop costs the ingest worker an append, never disk I/O.
+
+Layout: DATA_DIR/events/<YYYY-MM-DD>.col (UTC day of the row group's first pop), append-only,
+each a sequence of row groups:
+
+    MAGIC | header length (u32 LE) | header (JSON) | column | column | ...  (in COLUMNS order)
+
+    header: {"rows", "ts_min", "ts_max", "devices": [IDs the device column indexes], "sizes": [...]}
+
+Each column is a zlib-compressed little-endian array; "sizes" are their compressed lengths.
+Queries skip row groups outside the requested time range (by header), read (& cache) only the
+columns they use, and include pops not yet written. A row group cut short by a crash is
+truncated away at startup.
+"""
+
+from __future__ import annotations
+
+import functools
+import json
+import struct
+import sys
+import threading
+import time
+import zlib
+from array import array
+from collections import defaultdict
+from dataclasses import dataclass
+from datetime import UTC, datetime
+from typing import TYPE_CHECKING, Any, ClassVar, Final, Literal
+
+from .env import DATA_DIR
+
+if TYPE_CHECKING:
+    from collections.abc import Iterable, Iterator, Sequence
+    from pathlib import Path
+
+    from .types import FleetStats, HitRateBucket
+
+type GroupBy = Literal["device", "lvl", "mole"]
+type Bucket = Literal["hour", "day"]
+
+EVENTS_DIR: Final = DATA_DIR / "events"
+
+# Column name -> array typecode (fixed sizes: q = 8 bytes, H = 2, B = 1)
+COLUMNS: Final = {
+    "ts": "q",  # Unix ms
+    "session": "q",  # Session's started_at (0 if the pop arrived outside a session)
+    "device": "H",  # Index into row group's devices
+    "lvl": "B",
+    "mole": "B",
+    "outcome": "B",  # Index into OUTCOMES (len(OUTCOMES) if unknown)
+    "reaction_ms": "H",
+}
+OUTCOMES: Final = ("hit", "miss", "late")
+HIT: Final = 0
+
+_MAGIC: Final = b"WRG1"
+_PREFIX: Final = struct.Struct("<4sI")  # Magic, header length
+_BUCKET_MS: Final = {"hour": 3_600_000, "day": 86_400_000}
+
+
+def _le(arr: array) -> array:
+    """Return arr in little-endian byte order (the on-disk order)."""
+    if sys.byteorder == "big":
+        arr = array(arr.typecode, arr)
+        arr.byteswap()
+    return arr
+
+
+@functools.lru_cache(maxsize=512)  # Row groups never change once written (~1-64 KB per column)
+def _read_column(path: Path, offset: int, size: int, typecode: str) -> array:
+    with path.open("rb") as f:
+        f.seek(offset)
+        arr = array(typecode, zlib.decompress(f.read(size)))
+    return _le(arr)
+
+
+class _Buffer:
+    """Pops not yet written, as columns (becomes one row group)."""
+
+    def __init__(self) -> None:
+        self.columns = {name: array(typecode) for name, typecode in COLUMNS.items()}
+        self.devices: list[str] = []
+        self._device_idx: dict[str, int] = {}
+
+    def __len__(self) -> int:
+        return len(self.columns["ts"])
+
+    def append(self, ts: int, session: int, device_id: str, event: dict[str, Any]) -> None:
+        if (device := self._device_idx.get(device_id)) is None:
+            device = self._device_idx[device_id] = len(self.devices)
+            self.devices.append(device_id)
+        outcome = event.get("outcome")
+        cols = self.columns
+        cols["ts"].append(ts)
+        cols["session"].append(session)
+        cols["device"].append(device)
+        cols["lvl"].append(min(max(int(event.get("lvl", 1)), 0), 255))
+        cols["mole"].append(min(max(int(event.get("mole_id", 0)), 0), 255))
+        cols["outcome"].append(OUTCOMES.index(outcome) if outcome in OUTCOMES else len(OUTCOMES))
+        cols["reaction_ms"].append(min(max(int(event.get("reaction_ms", 0)), 0), 0xFFFF))
+
+    def copy(self) -> _Buffer:
+        buf = _Buffer()
+        buf.columns = {name: array(col.typecode, col) for name, col in self.columns.items()}
+        buf.devices = list(self.devices)
+        return buf
+
+    def encode(self) -> bytes:
+        blobs = [zlib.compress(_le(col).tobytes()) for col in self.columns.values()]
+        ts = self.columns["ts"]
+        header = json.dumps(
+            {
+                "rows": len(self),
+                "ts_min": min(ts),
+                "ts_max": max(ts),
+                "devices": self.devices,
+                "sizes": [len(b) for b in blobs],
+            },
+            separators=(",", ":"),
+        ).encode()
+        return _PREFIX.pack(_MAGIC, len(header)) + header + b"".join(blobs)
+
+
+@dataclass(frozen=True, slots=True)
+class _RowGroup:
+    """A written row group's location & header."""
+
+    path: Path
+    offset: int  # Of its first column
+    ts_min: int
+    ts_max: int
+    devices: list[str]
+    sizes: list[int]
+
+    def column(self, name: str) -> array:
+        i = list(COLUMNS).index(name)
+        return _read_column(self.path, self.offset + sum(self.sizes[:i]), self.sizes[i], COLUMNS[name])
+
+
+def _scan_file(path: Path, start: int, end: int) -> tuple[list[_RowGroup], int]:
+    """Return row groups in path's bytes [start, end) & where the last complete one ends."""
+    groups: list[_RowGroup] = []
+    with path.open("rb") as f:
+        f.seek(start)
+        pos = start
+        while pos + _PREFIX.size <= end:
+            magic, header_len = _PREFIX.unpack(f.read(_PREFIX.size))
+            if magic != _MAGIC or pos + _PREFIX.size + header_len > end:
+                break
+            try:
+                header = json.loads(f.read(header_len))
+            except ValueError:
+                break
+            data_at = pos + _PREFIX.size + header_len
+            sizes = header["sizes"]
+            if data_at + sum(sizes) > end:
+                break
+            groups.append(_RowGroup(path, data_at, header["ts_min"], header["ts_max"], header["devices"], sizes))
+            pos = data_at + sum(sizes)
+            f.seek(pos)
+    return groups, pos
+
+
+def _percentile(ordered: Sequence[int], p: float) -> int:
+    """Nearest-rank percentile of sorted, non-empty values."""
+    return ordered[min(len(ordered) - 1, int(p * len(ordered)))]
+
+
+class EventStore:
+    """Append-only columnar pop history (see module docstring)."""
+
+    ROW_GROUP_SIZE: ClassVar = 8192  # Pops per row group (fewer if FLUSH_SECS pass first)
+    FLUSH_SECS: ClassVar = 30
+
+    def __init__(self, root: Path) -> None:
+        root.mkdir(exist_ok=True)
+        self._root = root
+        self._lock = threading.Lock()  # Guards the fields below
+        self._buffer = _Buffer()
+        self._flushing: _Buffer | None = None  # Being written (still read from memory until it is)
+        self._groups: dict[Path, list[_RowGroup]] = {}
+        for path in sorted(root.glob("*.col")):
+            size = path.stat().st_size
+            self._groups[path], end = _scan_file(path, 0, size)
+            if end < size:
+                print(f"[Events] Truncating incomplete row group at end of {path} ({size - end} bytes)")
+                with path.open("r+b") as f:
+                    f.truncate(end)
+
+        self._flush_now = threading.Event()
+        self._closing = False
+        self._writer = threading.Thread(target=self._write_loop, name="event-writer", daemon=True)
+        self._writer.start()
+
+    def append(self, device_id: str, event: dict[str, Any], ts: int, session: int) -> None:
+        """Record a pop_result (in memory; written by the writer thread)."""
+        with self._lock:
+            self._buffer.append(ts, session, device_id, event)
+            full = len(self._buffer) >= EventStore.ROW_GROUP_SIZE
+        if full:
+            self._flush_now.set()
+
+    def close(self) -> None:
+        """Write buffered pops & stop the writer."""
+        self._closing = True
+        self._flush_now.set()
+        self._writer.join()
+
+    def _write_loop(self) -> None:
+        while not self._closing:
+            self._flush_now.wait(EventStore.FLUSH_SECS)
+            self._flush_now.clear()
+            self._flush()
+        self._flush()
+
+    def _flush(self) -> None:
+        with self._lock:
+            if not len(self._buffer):
+                return
+            buf, self._buffer = self._buffer, _Buffer()
+            self._flushing = buf
+
+        day = datetime.fromtimestamp(min(buf.columns["ts"]) / 1000, UTC).date()
+        path = self._root / f"{day.isoformat()}.col"
+        try:
+            with path.open("ab") as f:
+                start = f.tell()
+                try:
+                    f.write(buf.encode())
+                except OSError:
+                    f.truncate(start)  # Don't leave a partial row group for later ones to follow
+                    raise
+                end = f.tell()
+            groups, _ = _scan_file(path, start, end)
+        except OSError as e:
+            print(f"[Events] Failed to write {len(buf)} pop(s) to {path}: {e}")
+            with self._lock:
+                self._flushing = None
+            return
+
+        with self._lock:
+            self._groups.setdefault(path, []).extend(groups)
+            self._flushing = None
+
+    # === Queries ===
+
+    def _rows(self, columns: Iterable[str], since: int | None, device_id: str | None) -> Iterator[tuple[Any, ...]]:
+        """Yield (device_id, *columns) of every pop since `since` (and of device), written or not."""
+        columns = tuple(columns)
+        with self._lock:
+            groups = [g for gs in self._groups.values() for g in gs]
+            pending = [b.copy() for b in (self._flushing, self._buffer) if b is not None]
+
+        chunks: list[tuple[list[str], Any, int]] = [
+            (g.devices, g.column, g.ts_min) for g in groups if since is None or g.ts_max >= since
+        ]
+        chunks += [(b.devices, b.columns.__getitem__, min(b.columns["ts"])) for b in pending if len(b)]
+        for devices, column, ts_min in chunks:
+            if device_id is not None and device_id not in devices:
+                continue
+            if (since is None or ts_min >= since) and (device_id is None or len(devices) == 1):
+                # Every row matches: no per-row filtering
+                yield from zip(map(devices.__getitem__, column("device")), *map(column, columns), strict=True)
+                continue
+            want = None if device_id is None else devices.index(device_id)
+            for ts, device, *values in zip(column("ts"), column("device"), *map(column, columns), strict=True):
+                if (since is None or ts >= since) and (want is None or device == want):
+                    yield devices[device], *values
+
+    def hits(self) -> Iterator[tuple[str, int, int, int, int]]:
+        """Yield (device_id, ts, lvl, mole, reaction_ms) of every hit, oldest row group first."""
+        for device, ts, lvl, mole, outcome, reaction_ms in self._rows(
+            ("ts", "lvl", "mole", "outcome", "reaction_ms"), None, None
+        ):
+            if outcome == HIT:
+                yield device, ts, lvl, mole, reaction_ms
+
+    def reaction_times(
+        self, group_by: Sequence[GroupBy], since: int | None = None, device_id: str | None = None
+    ) -> list[dict[str, Any]]:
+        """Return hit reaction-time count/mean/percentiles (ms) grouped by any of device, level & mole."""
+        samples: dict[tuple[Any, ...], list[int]] = defaultdict(list)
+        pick = [("device", "lvl", "mole").index(g) for g in group_by]
+        for device, lvl, mole, outcome, reaction_ms in self._rows(
+            ("lvl", "mole", "outcome", "reaction_ms"), since, device_id
+        ):
+            if outcome == HIT:
+                row = (device, lvl, mole)
+                samples[tuple(row[i] for i in pick)].append(reaction_ms)
+
+        names = {"device": "device_id", "lvl": "lvl", "mole": "mole"}
+        stats: list[dict[str, Any]] = []
+        for key, values in sorted(samples.items()):
+            values.sort()
+            stats.append(
+                {
+                    **{names[g]: k for g, k in zip(group_by, key, strict=True)},
+                    "n": len(values),
+                    "mean_ms": round(sum(values) / len(values), 1),
+                    "p50_ms": _percentile(values, 0.5),
+                    "p90_ms": _percentile(values, 0.9),
+                    "p99_ms": _percentile(values, 0.99),
+                }
+            )
+        return stats
+
+    def hit_rates(self, bucket: Bucket, since: int | None = None, device_id: str | None = None) -> list[HitRateBucket]:
+        """Return pops & hit rate per hour/day (server's local time), oldest first."""
+        size = _BUCKET_MS[bucket]
+        utc_offset = datetime.now().astimezone().utcoffset()
+        offset = int(utc_offset.total_seconds() * 1000) if utc_offset else 0
+        pops: dict[int, int] = defaultdict(int)
+        hits: dict[int, int] = defaultdict(int)
+        for _, ts, outcome in self._rows(("ts", "outcome"), since, device_id):
+            start = ts - (ts + offset) % size
+            pops[start] += 1
+            hits[start] += outcome == HIT
+        return [
+            {"start": start, "pops": n, "hits": hits[start], "hit_rate": round(hits[start] / n, 4)}
+            for start, n in sorted(pops.items())
+        ]
+
+    def fleet(self, since: int | None = None) -> FleetStats:
+        """Return per-device pop/hit counts, hit rate & median reaction time, and fleet-wide totals."""
+        counts: dict[str, list[int]] = defaultdict(lambda: [0] * (len(OUTCOMES) + 1))
+        reactions: dict[str, list[int]] = defaultdict(list)
+        sessions: dict[str, set[int]] = defaultdict(set)
+        for device, session, outcome, reaction_ms in self._rows(("session", "outcome", "reaction_ms"), since, None):
+            counts[device][outcome] += 1
+            sessions[device].add(session)
+            if outcome == HIT:
+                reactions[device].append(reaction_ms)
+
+        def summary(n: list[int], rts: list[int], n_sessions: int) -> dict[str, Any]:
+            rts.sort()
+            total = sum(n)
+            return {
+                "pops": total,
+                "hits": n[0],
+                "misses": n[1],
+                "lates": n[2],
+                "hit_rate": round(n[0] / total, 4) if total else None,
+                "sessions": n_sessions,
+                "p50_ms": _percentile(rts, 0.5) if rts else None,
+            }
+
+        devices = [
+            {"device_id": d, **summary(n, reactions[d], len(sessions[d] - {0}))} for d, n in sorted(counts.items())
+        ]
+        totals = [sum(n[i] for n in counts.values()) for i in range(len(OUTCOMES) + 1)]
+        all_rts = [rt for rts in reactions.values() for rt in rts]
+        fleet = summary(totals, all_rts, sum(len(s - {0}) for s in sessions.values()))
+        return {"devices": devices, "fleet": fleet}
+
+
+# Pop history (opened by init())
+event_store: EventStore | None = None
+
+
+def record_pop(device_id: str, event: dict[str, Any], ts: int, session: int) -> None:
+    """Record a pop_result in the history (session: its session's started_at, or 0)."""
+    if event_store is not None:
+        event_store.append(device_id, event, ts, session)
+
+
+def analytics() -> EventStore:
+    """Return the pop history, for queries."""
+    assert event_store is not None  # noqa: S101 - init() runs before the API starts
+    return event_store
+
+
+def init() -> None:
+    """Open the pop history (creating its directory). Must be called once before accepting requests."""
+    global event_store  # noqa: PLW0603
+    started = time.perf_counter()
+    event_store = EventStore(EVENTS_DIR)
+    print(f"[Events] Opened {EVENTS_DIR} ({(time.perf_counter() - started) * 1000:.0f}ms)")
+
+
+def close() -> None:
+    """Write buffered pops (at shutdown)."""
+    if event_store is not None:
+        event_store.close()
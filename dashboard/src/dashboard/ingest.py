@@ -0,0 +1,169 @@
+"""MQTT ingest pipeline: paho's network thread only queues messages; a worker applies them.
+
+Decoding & handling messages on the network thread meant a slow handler held up socket reads
+and broker keepalives. Instead:
+
+    network thread  on_message -> Ingest.put()      Queue raw payload (never blocks)
+    worker thread   Ingest._run()                   Take a batch (up to BATCH_MAX), decode it,
+                                                    group it by device & apply each device's
+                                                    messages in one edit (one snapshot/commit)
+
+Overload: the queue holds QUEUE_SIZE messages; when it's full new messages are dropped (and
+counted) rather than blocking the network thread, which would only move the backlog into the
+broker's socket & time out the connection.
+
+Counters (stats()) are each written by a single thread (network thread: received/dropped;
+worker: the rest), so they need no lock. Problems are logged rate-limited (RateLimitedLog).
+"""
+
+from __future__ import annotations
+
+import json
+import queue
+import threading
+import time
+from collections import deque
+from dataclasses import dataclass
+from typing import TYPE_CHECKING, Any, ClassVar, Final
+
+if TYPE_CHECKING:
+    from collections.abc import Callable
+
+    from .types import IngestStats
+
+# Latency samples kept for stats() percentiles
+_SAMPLES: Final = 1024
+
+
+@dataclass(frozen=True, slots=True)
+class Message:
+    """A decoded MQTT message."""
+
+    topic: str
+    data: dict[str, Any]
+    received: int  # When the network thread got it (Unix ms) - i.e. device's last_seen
+
+
+# Applies one device's messages (in order) in a single edit; returns messages that raised
+type Apply = Callable[[str, list[Message]], list[tuple[Message, Exception]]]
+
+
+class RateLimitedLog:
+    """Prints structured log lines (`[Tag] event key=value ...`), at most one per key per interval.
+
+    Lines skipped in between are counted in the next one printed (suppressed=N).
+    """
+
+    def __init__(self, tag: str, interval: float = 10.0) -> None:
+        self._tag = tag
+        self._interval = interval
+        self._last: dict[str, float] = {}
+        self._suppressed: dict[str, int] = {}
+
+    def __call__(self, event: str, key: str | None = None, **fields: Any) -> None:  # noqa: ANN401
+        key = key or event
+        now = time.monotonic()
+        if now - self._last.get(key, -self._interval) < self._interval:
+            self._suppressed[key] = self._suppressed.get(key, 0) + 1
+            return
+
+        self._last[key] = now
+        if suppressed := self._suppressed.pop(key, 0):
+            fields["suppressed"] = suppressed
+        pairs = (f"{k}={json.dumps(v) if isinstance(v, str) else v}" for k, v in fields.items())
+        print(f"[{self._tag}] {event}", *pairs)
+
+
+def _percentiles(samples: deque[float]) -> dict[str, float | None]:
+    ordered = sorted(samples)
+
+    def pct(p: float) -> float | None:
+        return round(ordered[min(len(ordered) - 1, int(p * len(ordered)))], 2) if ordered else None
+
+    return {"p50": pct(0.5), "p95": pct(0.95), "max": pct(1)}
+
+
+class Ingest:
+    """Bounded queue of raw MQTT messages & the worker applying them (see module docstring)."""
+
+    QUEUE_SIZE: ClassVar = 10_000  # Messages the worker may fall behind before new ones are dropped
+    BATCH_MAX: ClassVar = 256  # Max messages taken (and grouped by device) per batch
+
+    def __init__(self) -> None:
+        self._queue: queue.Queue[tuple[str, bytes, int]] = queue.Queue(Ingest.QUEUE_SIZE)
+        self._log = RateLimitedLog("Ingest")
+
+        self._received = 0  # Network thread
+        self._dropped = 0
+        self._applied = 0  # Worker
+        self._decode_errors = 0
+        self._apply_errors = 0
+        self._batches = 0
+        self._max_depth = 0
+        self._lag_ms: deque[float] = deque(maxlen=_SAMPLES)  # Receive -> applied, per batch's oldest message
+        self._apply_ms: deque[float] = deque(maxlen=_SAMPLES)  # Per batch
+
+    def start(self, apply: Apply) -> None:
+        """Start the worker, applying messages with apply (messages put before this wait for it)."""
+        threading.Thread(target=self._run, args=(apply,), name="ingest", daemon=True).start()
+
+    def put(self, topic: str, payload: bytes) -> None:
+        """Queue a message (from paho's network thread). Never blocks: drops it if the queue is full."""
+        self._received += 1
+        try:
+            self._queue.put_nowait((topic, payload, int(time.time() * 1000)))
+        except queue.Full:
+            self._dropped += 1
+            self._log("overload", queue_size=Ingest.QUEUE_SIZE, dropped=self._dropped, topic=topic)
+
+    def stats(self) -> IngestStats:
+        """Return queue depth, counters & latencies (ms, over recent batches)."""
+        return {
+            "queue_depth": self._queue.qsize(),
+            "max_queue_depth": self._max_depth,
+            "received": self._received,
+            "dropped": self._dropped,
+            "applied": self._applied,
+            "decode_errors": self._decode_errors,
+            "apply_errors": self._apply_errors,
+            "batches": self._batches,
+            "lag_ms": _percentiles(self._lag_ms),
+            "apply_ms": _percentiles(self._apply_ms),
+        }
+
+    def _run(self, apply: Apply) -> None:
+        while True:
+            batch = [self._queue.get()]
+            self._max_depth = max(self._max_depth, self._queue.qsize() + 1)
+            while len(batch) < Ingest.BATCH_MAX:
+                try:
+                    batch.append(self._queue.get_nowait())
+                except queue.Empty:
+                    break
+
+            started = time.perf_counter()
+            by_device: dict[str, list[Message]] = {}  # Keeps each device's messages in arrival order
+            for topic, payload, received in batch:
+                try:
+                    data = json.loads(payload)
+                except (UnicodeDecodeError, json.JSONDecodeError) as e:
+                    self._decode_errors += 1
+                    self._log("decode_error", key=f"decode:{topic}", topic=topic, error=str(e))
+                    continue
+                if isinstance(data, dict) and isinstance(device_id := data.get("device_id"), str):
+                    by_device.setdefault(device_id, []).append(Message(topic, data, received))
+
+            for device_id, messages in by_device.items():
+                failed = apply(device_id, messages)
+                self._applied += len(messages) - len(failed)
+                self._apply_errors += len(failed)
+                for msg, e in failed:
+                    self._log("apply_error", key=f"apply:{msg.topic}", topic=msg.topic, error=repr(e))
+
+            self._batches += 1
+            self._apply_ms.append((time.perf_counter() - started) * 1000)
+            self._lag_ms.append(time.time() * 1000 - batch[0][2])
+
+
+# Global ingest queue - fed by the MQTT subscriber, started by main()
+INGEST: Final = Ingest()
@@ -1,18 +1,30 @@
 """Leaderboard persistence and scoring logic.
 
-Maintains top scores across sessions, persisted to JSON file.
+Maintains top scores across sessions in memory, backed by the full score history in SQLite
+(see scores.py), which also answers windowed/per-device queries.
 Thread-safe for concurrent access from MQTT handler and API.
 """
 
+from __future__ import annotations
+
 import json
 import threading
 from dataclasses import asdict, dataclass
-from typing import Any, Final
+from typing import TYPE_CHECKING, Any, Final
 
 from .env import DATA_DIR
+from .scores import ScoreStore
+
+if TYPE_CHECKING:
+    from .scores import ScoreWindow
+    from .state import Session
+    from .types import ScorePage
 
 # Persistent storage location
-LEADERBOARD_FILE: Final = DATA_DIR / "leaderboard.json"
+SCORES_DB: Final = DATA_DIR / "scores.db"
+
+# Pre-SQLite leaderboard (imported into SCORES_DB once, if that's empty)
+LEGACY_LEADERBOARD_FILE: Final = DATA_DIR / "leaderboard.json"
 
 # Thread safety for concurrent access
 LEADERBOARD_LOCK: Final = threading.Lock()
@@ -20,6 +32,9 @@ LEADERBOARD_LOCK: Final = threading.Lock()
 # Keep only top N scores
 MAX_ENTRIES: Final = 5
 
+# Reaction time (ms) from which a hit scores the minimum (as HIT_RT_CAP_MS on the device)
+HIT_RT_CAP_MS: Final = 1500
+
 
 @dataclass
 class LeaderboardEntry:
@@ -33,36 +48,75 @@ class LeaderboardEntry:
 # In-memory leaderboard (loaded from disk at startup)
 leaderboard: list[LeaderboardEntry] = []
 
+# Bumped whenever leaderboard changes; its JSON is serialized once per version (leaderboard_json())
+leaderboard_version = 0
+_leaderboard_json: tuple[int, bytes] | None = None
+
+# Full score history (opened by init())
+score_store: ScoreStore | None = None
+
+
+def hit_points(event: dict[str, Any]) -> int:
+    """Return points for a single event (100 * level * max(0.5, 2 - reaction_s) if it's a hit, else 0).
+
+    Integer-only, exactly as the device scores its session summary (game_hit_points(), emb/include/game.h).
+    """
+    if event.get("event_type") != "pop_result" or event.get("outcome") != "hit":
+        return 0
+    lvl = event.get("lvl", 1)
+    reaction_ms = event.get("reaction_ms", 1000)
+    return lvl * (2000 - min(reaction_ms, HIT_RT_CAP_MS)) // 10
+
 
 def calculate_score(events: list[dict[str, Any]]) -> int:
-    """Calculate score from session events (100 * level * speed_bonus per hit)."""
-    score = 0
-    for event in events:
-        if event.get("event_type") == "pop_result" and event.get("outcome") == "hit":
-            lvl = event.get("lvl", 1)
-            reaction_ms = event.get("reaction_ms", 1000)
-            speed_bonus = max(0.5, 2 - (reaction_ms / 1000))
-            score += int(100 * lvl * speed_bonus)
-    return score
+    """Calculate score from session events by rescanning them all.
+
+    Live sessions keep a running score instead (Session.add_event); this is the reference it matches.
+    """
+    return sum(hit_points(event) for event in events)
+
+
+def summary_pop_count(session_end: dict[str, Any]) -> int:
+    """Return number of pops covered by the device-side summary in a session_end event."""
+    return sum(sum(session_end.get(k, ())) for k in ("hits", "misses", "lates"))
+
+
+def session_score(session: Session) -> int:
+    """Calculate final score for a finished session (last event is session_end).
+
+    Uses the device's own score when fewer pop_results arrived than its summary covers
+    (events lost upstream, or device in summary-only telemetry mode).
+    """
+    end = session.events[-1] if session.events else {}
+    if end.get("event_type") != "session_end" or "score" not in end:
+        return session.score
+
+    return int(end["score"]) if session.pops < summary_pop_count(end) else session.score
 
 
 def add_entry(device_id: str, score: int, timestamp: int) -> None:
     """Add new score entry, maintaining sorted order and max size.
 
-    Called when a game session ends. Automatically persists to disk.
+    Called when a game session ends. Queued for writing to the score history (off this thread).
     Deduplicates entries within 2 seconds to prevent buffer flush duplicates.
     """
+    global leaderboard_version  # noqa: PLW0603
+
     with LEADERBOARD_LOCK:
         # Prevent duplicate entries (same device within 2 seconds)
         for existing in leaderboard:
-            if existing.device_id == device_id and abs(existing.timestamp - timestamp) < 2000:
+            if existing.device_id == device_id and abs(existing.timestamp - timestamp) < ScoreStore.DEDUP_MS:
                 return  # Duplicate, skip
 
         entry = LeaderboardEntry(score=score, device_id=device_id, timestamp=timestamp)
         leaderboard.append(entry)
-        leaderboard.sort(key=lambda e: e.score, reverse=True)
+        leaderboard.sort(key=lambda e: (-e.score, e.timestamp))  # Ties: earliest first (as ScoreStore.top)
         del leaderboard[MAX_ENTRIES:]  # Keep only top N
-        _save()
+        if entry in leaderboard:
+            leaderboard_version += 1
+
+    if score_store is not None:
+        score_store.add(device_id, score, timestamp)  # Store dedups against all history, not just top N
 
 
 def get_leaderboard() -> list[dict[str, Any]]:
@@ -71,19 +125,49 @@ def get_leaderboard() -> list[dict[str, Any]]:
         return [asdict(e) for e in leaderboard]
 
 
-def _save() -> None:
-    """Persist current leaderboard to JSON file."""
-    data = [asdict(e) for e in leaderboard]
-    LEADERBOARD_FILE.write_text(json.dumps(data, indent=2))
+def leaderboard_json() -> tuple[int, bytes]:
+    """Return (leaderboard_version, leaderboard as JSON) - serialized only when it has changed."""
+    global _leaderboard_json  # noqa: PLW0603
+
+    with LEADERBOARD_LOCK:
+        if _leaderboard_json is None or _leaderboard_json[0] != leaderboard_version:
+            body = json.dumps([asdict(e) for e in leaderboard], separators=(",", ":")).encode()
+            _leaderboard_json = (leaderboard_version, body)
+        return _leaderboard_json
+
+
+def get_scores(window: ScoreWindow, device_id: str | None, limit: int, offset: int) -> ScorePage:
+    """Return a page of the score history, ranked (all time/today/this week; optionally one device's)."""
+    assert score_store is not None  # noqa: S101 - init() runs before the API starts
+    return {
+        "entries": score_store.top(limit, offset, window=window, device_id=device_id),
+        "total": score_store.count(window=window, device_id=device_id),
+        "limit": limit,
+        "offset": offset,
+    }
 
 
 def init() -> None:
-    """Load leaderboard from disk at startup.
+    """Open score history & load leaderboard from it at startup.
 
-    Must be called once before accepting requests. Creates empty
-    leaderboard if file doesn't exist.
+    Must be called once before accepting requests. Creates the database if it doesn't exist,
+    importing the old leaderboard.json (if any) into it.
     """
-    global leaderboard  # noqa: PLW0603
-    if LEADERBOARD_FILE.exists():
-        data = json.loads(LEADERBOARD_FILE.read_text())
-        leaderboard = [LeaderboardEntry(**e) for e in data]
+    global leaderboard, leaderboard_version, score_store  # noqa: PLW0603
+    score_store = ScoreStore(SCORES_DB)
+
+    if score_store.count() == 0 and LEGACY_LEADERBOARD_FILE.exists():
+        for e in json.loads(LEGACY_LEADERBOARD_FILE.read_text()):
+            score_store.add(e["device_id"], e["score"], e["timestamp"])
+        score_store.flush()
+        print(f"[Scores] Imported {LEGACY_LEADERBOARD_FILE} into {SCORES_DB}")
+
+    with LEADERBOARD_LOCK:
+        leaderboard = [LeaderboardEntry(**e) for e in score_store.top(MAX_ENTRIES)]
+        leaderboard_version += 1
+
+
+def close() -> None:
+    """Write any queued scores (at shutdown)."""
+    if score_store is not None:
+        score_store.close()
@@ -2,12 +2,15 @@
 
 from __future__ import annotations
 
+import asyncio
 import json
 import os
 import socket
-from typing import TYPE_CHECKING, Any
+import time
+import uuid
+from collections import deque
+from typing import TYPE_CHECKING, Any, ClassVar, Final
 
-from paho.mqtt import publish
 from paho.mqtt.client import Client, ConnectFlags, DisconnectFlags
 from paho.mqtt.enums import CallbackAPIVersion
 
@@ -18,39 +21,181 @@ if TYPE_CHECKING:
     from paho.mqtt.properties import Properties
     from paho.mqtt.reasoncodes import ReasonCode
 
-    from dashboard.types import StatusOk
+    from dashboard.types import CommandSent, PublishStats
 
 
 from .env import BROKER, MQTT_PORT
+from .push import push_device
+from .state import device_entry
 
 
-def pub_cmd(device_id: str, cmd: str) -> StatusOk:
-    """Publish a command to a given device.
+class PublishError(Exception):
+    """Command couldn't be handed to the broker (not connected, or no ack in time)."""
+
+
+class Publisher:
+    """Long-lived MQTT connection publishing commands (shared by all requests).
+
+    Replaces a connection per command (TCP + CONNECT, publish, DISCONNECT): paho's network thread
+    keeps this one open & reconnects it. publish() waits on the server's event loop (never
+    blocking it) until the broker has the message, i.e. the QoS 2 handshake is done.
+    """
+
+    TIMEOUT: ClassVar = 5  # Secs to wait for the broker to take a message
+    SAMPLES: ClassVar = 256  # Recent publish latencies kept for stats()
+
+    def __init__(self) -> None:
+        client_id = f"dashboard-pub-{socket.gethostname()}-{os.getpid()}"
+        self._client = Client(client_id=client_id, callback_api_version=CallbackAPIVersion.VERSION2)
+        self._client.reconnect_delay_set(min_delay=1, max_delay=30)
+        self._client.on_connect = self._on_connect
+        self._client.on_disconnect = self._on_disconnect
+        self._client.on_publish = self._on_publish
+
+        # Used on the event loop only (on_publish hands acks over to it)
+        self._loop: asyncio.AbstractEventLoop | None = None
+        self._acks: dict[int, asyncio.Future[None]] = {}  # Message ID -> resolved on broker's ack
+        self._latencies: deque[float] = deque(maxlen=Publisher.SAMPLES)
+        self._sent = 0
+        self._failed = 0
+
+    def start(self) -> None:
+        """Connect (in the background; retried until the broker is up)."""
+        self._client.connect_async(BROKER, MQTT_PORT)
+        self._client.loop_start()
+
+    def stop(self) -> None:
+        self._client.disconnect()
+        self._client.loop_stop()
+
+    @property
+    def connected(self) -> bool:
+        return self._client.is_connected()
+
+    def require_connection(self) -> None:
+        """Raise PublishError if not connected (rather than queue a message to send whenever it is)."""
+        if not self.connected:
+            self._failed += 1
+            msg = f"Not connected to MQTT broker {BROKER}:{MQTT_PORT}"
+            raise PublishError(msg)
+
+    async def publish(self, topic: str, payload: str) -> None:
+        """Publish at QoS 2, returning once the broker has it. Raises PublishError if it can't be sent.
+
+        A message that times out may still be delivered (paho resends it on reconnect).
+        """
+        self.require_connection()
+        self._loop = asyncio.get_running_loop()
+        started = time.perf_counter()
+        info = self._client.publish(topic, payload, qos=2)
+        ack = self._acks[info.mid] = self._loop.create_future()  # Ack can't resolve it before we await
+        try:
+            await asyncio.wait_for(ack, Publisher.TIMEOUT)
+        except TimeoutError as e:
+            self._failed += 1
+            msg = f"No ack from MQTT broker within {Publisher.TIMEOUT}s"
+            raise PublishError(msg) from e
+        finally:
+            self._acks.pop(info.mid, None)
+
+        self._sent += 1
+        self._latencies.append((time.perf_counter() - started) * 1000)
+
+    def stats(self) -> PublishStats:
+        """Return publish counts & latencies (ms; over the last SAMPLES publishes)."""
+        latencies = sorted(self._latencies)
+
+        def pct(p: float) -> float | None:
+            return round(latencies[min(len(latencies) - 1, int(p * len(latencies)))], 2) if latencies else None
+
+        return {
+            "connected": self.connected,
+            "sent": self._sent,
+            "failed": self._failed,
+            "latency_ms": {"p50": pct(0.5), "p95": pct(0.95), "max": pct(1)},
+        }
+
+    def _on_connect(
+        self,
+        client: Client,
+        userdata: Any,  # noqa: ANN401
+        flags: ConnectFlags,
+        reason_code: ReasonCode,
+        properties: Properties | None = None,
+    ) -> None:
+        _ = client, userdata, flags, properties
+        if reason_code.is_failure:
+            print(f"[MQTT] Publisher connection failed: {reason_code}")
+        else:
+            print(f"[MQTT] Publisher connected to {BROKER}:{MQTT_PORT}")
+
+    def _on_disconnect(
+        self,
+        client: Client,
+        userdata: Any,  # noqa: ANN401
+        disconnect_flags: DisconnectFlags,
+        reason_code: ReasonCode,
+        properties: Properties | None = None,
+    ) -> None:
+        _ = client, userdata, disconnect_flags, properties
+        if reason_code.is_failure:
+            print(f"[MQTT] Publisher disconnected unexpectedly: {reason_code}, will reconnect...")
+
+    def _on_publish(
+        self,
+        client: Client,
+        userdata: Any,  # noqa: ANN401
+        mid: int,
+        reason_code: ReasonCode,
+        properties: Properties | None,
+    ) -> None:
+        _ = client, userdata, reason_code, properties
+        if self._loop is not None:
+            self._loop.call_soon_threadsafe(self._acked, mid)
+
+    def _acked(self, mid: int) -> None:
+        if (ack := self._acks.get(mid)) is not None and not ack.done():
+            ack.set_result(None)
+
+
+# Global command publisher (started by main())
+PUBLISHER: Final = Publisher()
+
+
+async def pub_cmd(device_id: str, cmd: str) -> CommandSent:
+    """Publish a command to a given device, tracking it as pending until the agent reports its result.
 
     Args:
         device_id: Device ID
         cmd: Command
 
     Returns:
-        StatusOk for caller to return
+        CommandSent (with the command's request ID) for caller to return
+
+    Raises:
+        PublishError: Broker unreachable (command not registered as pending) or didn't ack in time
     """
-    publish.single(
-        f"whac/{device_id}/commands",
-        cmd,
-        hostname=BROKER,
-        port=MQTT_PORT,
-        qos=2,
-    )
+    PUBLISHER.require_connection()  # Before registering: a command that never went out isn't pending
+    cmd_id = uuid.uuid4().hex[:12]
+
+    # Registered before publishing so even an instant result finds it
+    entry = device_entry(device_id)
+    with entry as device:
+        device.pending_cmds[cmd_id] = {"cmd": cmd, "sent_at": int(time.time() * 1000)}
+        push_device(entry)
 
-    return {"ok": True}
+    await PUBLISHER.publish(f"whac/{device_id}/commands", json.dumps({"cmd": cmd, "id": cmd_id}))
 
+    return {"ok": True, "id": cmd_id}
 
-def subscribe(topics: list[str], handler: Callable[[dict[str, Any], str], None]) -> Client:
+
+def subscribe(topics: list[str], handler: Callable[[str, bytes], None]) -> Client:
     """Subscribe to MQTT topics.
 
     Args:
         topics: List of topics to subscribe to
-        handler: Callback for when message is received
+        handler: Called with each message's topic & raw payload, on paho's network thread (so
+            it must be quick & not raise - see ingest.Ingest.put)
     """
 
     client_id = f"dashboard-{socket.gethostname()}-{os.getpid()}"
@@ -92,11 +237,7 @@ def subscribe(topics: list[str], handler: Callable[[dict[str, Any], str], None])
         message: MQTTMessage,
     ) -> None:
         _ = client, userdata
-        try:
-            print(f"[MQTT] Received message on {message.topic}")
-            handler(json.loads(message.payload.decode()), message.topic)
-        except Exception as e:
-            print(f"[MQTT] Error processing message on {message.topic}: {e}")
+        handler(message.topic, message.payload)
 
     mqttc.on_connect = on_connect
     mqttc.on_disconnect = on_disconnect
@@ -0,0 +1,213 @@
+"""Server-sent event push of device & leaderboard changes to dashboard clients.
+
+Rather than every browser polling /devices (every device's full state, incl. all session
+events, per browser per second), each change is recorded as a small delta by the thread that
+made it (push_*() while editing the device) and published with the device's new snapshot,
+serialized once & fanned out to every connected client's queue:
+
+    snapshot    {"devices": [...], "leaderboard": [...]}       First message on connect
+    device      Device's fields except its sessions            Status, level, commands, ...
+    event       {"device_id", "event", "session"}              Appended to current session (& its
+                                                               fields but events, as of the event)
+    session     {"device_id", "current_session"[, "past_sessions"]}
+    leaderboard {"entries": [...]}
+
+Every message's SSE id is "<epoch>-<seq>": a sequence number (consecutive per client, so gaps
+are detectable) and a per-process epoch. A client that reconnects (EventSource sends the last
+id as Last-Event-ID) is replayed what it missed if that's still in the replay buffer, else sent
+a fresh snapshot (as after a dashboard restart); clients that fall too far behind are
+disconnected to do just that.
+
+Thread Safety:
+    Changes are published as the edit's snapshot is, under COMMIT_LOCK (see state.py), and
+    clients connect under it, so a client's snapshot and the deltas that follow it are consistent.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import contextlib
+import json
+import threading
+import uuid
+from collections import deque
+from typing import TYPE_CHECKING, Any, ClassVar, Final
+
+from .leaderboard import get_leaderboard
+from .state import SessionSnapshot, on_commit, registry
+
+if TYPE_CHECKING:
+    from collections.abc import AsyncIterator, Callable
+
+    from .state import Change, DeviceEntry
+
+
+def _format(event_id: str, kind: str, data: dict[str, Any]) -> bytes:
+    return f"id: {event_id}\nevent: {kind}\ndata: {json.dumps(data, separators=(',', ':'))}\n\n".encode()
+
+
+class PushClient:
+    """One connected client's message queue (lives on the server's event loop)."""
+
+    QUEUE_SIZE: ClassVar = 1024  # Messages a client may fall behind before it's made to resync
+    KEEPALIVE: ClassVar = 15  # Secs between comments on an idle stream (keeps proxies from timing out)
+
+    def __init__(self, hub: PushHub, backlog: list[bytes]) -> None:
+        self._hub = hub
+        self._loop = asyncio.get_running_loop()
+        self._queue: asyncio.Queue[bytes | None] = asyncio.Queue(PushClient.QUEUE_SIZE)
+        self._backlog = backlog
+
+    def push(self, msg: bytes) -> None:
+        """Queue message for sending (from any thread)."""
+        with contextlib.suppress(RuntimeError):  # Loop closed (server shutting down)
+            self._loop.call_soon_threadsafe(self._put, msg)
+
+    def _put(self, msg: bytes) -> None:
+        if self._queue.full():
+            return
+        if self._queue.qsize() == PushClient.QUEUE_SIZE - 1:
+            self._queue.put_nowait(None)  # Too far behind: end stream; browser reconnects & resyncs
+        else:
+            self._queue.put_nowait(msg)
+
+    async def stream(self) -> AsyncIterator[bytes]:
+        """Yield SSE stream: reconnect delay, snapshot/replay, then deltas as they're published."""
+
+        try:
+            yield b"retry: 1000\n\n" + b"".join(self._backlog)
+            self._backlog = []
+            while True:
+                try:
+                    msg = await asyncio.wait_for(self._queue.get(), PushClient.KEEPALIVE)
+                except TimeoutError:
+                    yield b": keepalive\n\n"
+                    continue
+                if msg is None:
+                    return
+                yield msg
+        finally:
+            self._hub.disconnect(self)
+
+
+class PushHub:
+    """Sequences published changes & fans them out to connected clients (see module docstring)."""
+
+    REPLAY_SIZE: ClassVar = 1024  # Recent messages kept for reconnecting clients
+
+    def __init__(self) -> None:
+        self._lock = threading.Lock()
+        self._epoch = uuid.uuid4().hex[:8]
+        self._seq = 0
+        self._recent: deque[tuple[int, bytes]] = deque(maxlen=PushHub.REPLAY_SIZE)
+        self._clients: set[PushClient] = set()
+
+    def publish(self, changes: list[Change]) -> None:
+        """Sequence & send changes (an edit's) to all clients.
+
+        Each change is built & serialized once, whatever the number of clients (and not at all if
+        there are none - the next client gets a snapshot instead).
+        """
+
+        with self._lock:
+            for kind, build in changes:
+                self._seq += 1
+                if not self._clients:
+                    self._recent.clear()  # Can't replay this change: reconnecting clients need a snapshot
+                    continue
+                msg = _format(f"{self._epoch}-{self._seq}", kind, build())
+                self._recent.append((self._seq, msg))
+                for client in self._clients:
+                    client.push(msg)
+
+    def connect(self, last_id: str | None, capture: Callable[[], Callable[[], dict[str, Any]]]) -> PushClient:
+        """Register a client (on the server's event loop).
+
+        Its stream starts with what it missed after the message with id `last_id` if that's still
+        buffered, else with a snapshot: capture() is called to grab the state (cheaply) & returns
+        a function building the message from it, called after the hub's lock is released.
+
+        Caller must hold COMMIT_LOCK (so no change lands between snapshot and first delta).
+        """
+
+        epoch, _, seq_str = (last_id or "").partition("-")
+        since = int(seq_str) if epoch == self._epoch and seq_str.isdigit() else None
+
+        with self._lock:
+            oldest = self._recent[0][0] if self._recent else self._seq + 1
+            if since is not None and oldest - 1 <= since <= self._seq:
+                build = None
+                backlog = [msg for seq, msg in self._recent if seq > since]
+            else:
+                build, snapshot_id = capture(), f"{self._epoch}-{self._seq}"
+                backlog = []
+            client = PushClient(self, backlog)
+            self._clients.add(client)
+
+        if build is not None:
+            backlog.append(_format(snapshot_id, "snapshot", build()))
+        return client
+
+    def disconnect(self, client: PushClient) -> None:
+        with self._lock:
+            self._clients.discard(client)
+
+
+# Global hub - published to as devices' snapshots are, streamed by /stream
+HUB: Final = PushHub()
+on_commit(HUB.publish)
+
+
+def snapshot() -> Callable[[], dict[str, Any]]:
+    """Capture all devices' snapshots. Caller must hold COMMIT_LOCK.
+
+    Returns a function building a stream's first message (devices & leaderboard) from them.
+    """
+    snapshots = [entry.snapshot for entry in registry().values()]
+    return lambda: {"devices": [s.to_dict() for s in snapshots], "leaderboard": get_leaderboard()}
+
+
+# push_*() record a change to publish with the device's next snapshot (i.e. once the edit ends);
+# callers must be editing the device (`with entry:`). One edit may apply a batch of messages (see
+# ingest.py), so session & event messages capture the session as of the change (a SessionSnapshot:
+# its fields, and how many of its shared events) rather than reading the edit's final snapshot.
+# Device messages carry all the device's fields, so one per edit (the final ones) is enough.
+
+
+def push_device(entry: DeviceEntry) -> None:
+    """Publish device's fields except its sessions (once per edit, as of its end)."""
+    if not any(kind == "device" for kind, _ in entry.changes):
+        entry.changes.append(("device", lambda: entry.snapshot.fields))
+
+
+def push_event(entry: DeviceEntry, event: dict[str, Any]) -> None:
+    """Publish an event appended to device's current session (with the session's score & tallies so far)."""
+
+    if (session := entry.state.current_session) is None:
+        return
+    device_id, fields = entry.state.device_id, SessionSnapshot.of(session).fields
+    entry.changes.append(("event", lambda: {"device_id": device_id, "event": event, "session": fields}))
+
+
+def push_session(entry: DeviceEntry, *, archived: bool = False) -> None:
+    """Publish device's (new/ended) current session, and its past sessions' summaries if one was archived."""
+
+    state = entry.state
+    session = None if state.current_session is None else SessionSnapshot.of(state.current_session)
+    past_sessions = list(state.past_sessions) if archived else None
+
+    def build() -> dict[str, Any]:
+        data: dict[str, Any] = {
+            "device_id": state.device_id,
+            "current_session": None if session is None else session.to_dict(),
+        }
+        if past_sessions is not None:
+            data["past_sessions"] = past_sessions
+        return data
+
+    entry.changes.append(("session", build))
+
+
+def push_leaderboard(entry: DeviceEntry) -> None:
+    """Publish the leaderboard (after one of device's sessions ended)."""
+    entry.changes.append(("leaderboard", lambda: {"entries": get_leaderboard()}))
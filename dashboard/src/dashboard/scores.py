@@ -0,0 +1,147 @@
+"""Persistent score history (SQLite in WAL mode).
+
+Every finished session's score is kept - not just the leaderboard's top MAX_ENTRIES - so scores
+can be ranked over all time, today or this week, overall or per device.
+
+Thread Safety:
+    add() only queues the score: a single writer thread commits queued scores in batches (one
+    transaction each), so the MQTT thread never waits on disk. Queries use one connection per
+    calling thread; WAL lets them run while the writer commits.
+"""
+
+from __future__ import annotations
+
+import queue
+import sqlite3
+import threading
+from datetime import datetime, timedelta
+from typing import TYPE_CHECKING, Any, ClassVar, Final, Literal
+
+if TYPE_CHECKING:
+    from pathlib import Path
+
+type ScoreWindow = Literal["all", "today", "week"]
+
+_SCHEMA: Final = """
+CREATE TABLE IF NOT EXISTS scores (
+    id        INTEGER PRIMARY KEY,
+    device_id TEXT    NOT NULL,
+    score     INTEGER NOT NULL,
+    timestamp INTEGER NOT NULL  -- Unix timestamp (ms) when session ended
+);
+CREATE INDEX IF NOT EXISTS scores_by_score       ON scores (score DESC, timestamp);
+CREATE INDEX IF NOT EXISTS scores_by_time        ON scores (timestamp);
+CREATE INDEX IF NOT EXISTS scores_by_device      ON scores (device_id, score DESC, timestamp);
+CREATE INDEX IF NOT EXISTS scores_by_device_time ON scores (device_id, timestamp);
+"""
+
+
+def window_start(window: ScoreWindow) -> int | None:
+    """Return start of window as Unix timestamp (ms; server's local time), or None for all time."""
+    if window == "all":
+        return None
+    today = datetime.now().astimezone().replace(hour=0, minute=0, second=0, microsecond=0)
+    start = today if window == "today" else today - timedelta(days=today.weekday())  # Week starts Monday
+    return int(start.timestamp() * 1000)
+
+
+class ScoreStore:
+    """Score history in an SQLite database (see module docstring)."""
+
+    BATCH_MAX: ClassVar = 256  # Max scores committed per transaction
+    DEDUP_MS: ClassVar = 2000  # Same device's scores closer together are one session re-delivered
+
+    def __init__(self, path: Path) -> None:
+        self._path = path
+        self._local = threading.local()
+        self._queue: queue.Queue[tuple[str, int, int] | None] = queue.Queue()
+
+        self._db().executescript(_SCHEMA)
+        self._writer = threading.Thread(target=self._write_loop, name="score-writer", daemon=True)
+        self._writer.start()
+
+    def add(self, device_id: str, score: int, timestamp: int) -> None:
+        """Queue a finished session's score for writing (skipped if it duplicates one already stored)."""
+        self._queue.put((device_id, score, timestamp))
+
+    def flush(self) -> None:
+        """Block until all queued scores are written."""
+        self._queue.join()
+
+    def close(self) -> None:
+        """Write queued scores & stop the writer."""
+        self._queue.put(None)
+        self._writer.join()
+
+    def top(
+        self,
+        limit: int,
+        offset: int = 0,
+        *,
+        window: ScoreWindow = "all",
+        device_id: str | None = None,
+    ) -> list[dict[str, Any]]:
+        """Return scores ranked highest first (earliest first on ties), as leaderboard entries."""
+        where, params = _filter(window, device_id)
+        rows = self._db().execute(
+            f"SELECT score, device_id, timestamp FROM scores {where} "  # noqa: S608 - clauses are fixed strings
+            "ORDER BY score DESC, timestamp LIMIT ? OFFSET ?",
+            (*params, limit, offset),
+        )
+        return [{"score": s, "device_id": d, "timestamp": t} for s, d, t in rows]
+
+    def count(self, *, window: ScoreWindow = "all", device_id: str | None = None) -> int:
+        """Return number of scores in window (for pagination)."""
+        where, params = _filter(window, device_id)
+        return self._db().execute(f"SELECT COUNT(*) FROM scores {where}", params).fetchone()[0]  # noqa: S608
+
+    def _db(self) -> sqlite3.Connection:
+        """Return calling thread's connection (opened on first use)."""
+        db: sqlite3.Connection | None = getattr(self._local, "db", None)
+        if db is None:
+            db = sqlite3.connect(self._path, timeout=10)
+            db.execute("PRAGMA journal_mode=WAL")
+            db.execute("PRAGMA synchronous=NORMAL")  # Durable at checkpoints; can't corrupt in WAL mode
+            self._local.db = db
+        return db
+
+    def _write_loop(self) -> None:
+        db = self._db()
+        dedup_ms = ScoreStore.DEDUP_MS
+        while True:
+            batch = [self._queue.get()]
+            while len(batch) < ScoreStore.BATCH_MAX:
+                try:
+                    batch.append(self._queue.get_nowait())
+                except queue.Empty:
+                    break
+
+            scores = [s for s in batch if s is not None]
+            try:
+                with db:
+                    for device_id, score, timestamp in scores:
+                        db.execute(
+                            "INSERT INTO scores (device_id, score, timestamp) SELECT ?, ?, ? WHERE NOT EXISTS ("
+                            "SELECT 1 FROM scores WHERE device_id = ? AND timestamp > ? AND timestamp < ?)",
+                            (device_id, score, timestamp, device_id, timestamp - dedup_ms, timestamp + dedup_ms),
+                        )
+            except sqlite3.Error as e:
+                print(f"[Scores] Failed to write {len(scores)} score(s): {e}")
+
+            for _ in batch:
+                self._queue.task_done()
+            if len(scores) < len(batch):
+                return
+
+
+def _filter(window: ScoreWindow, device_id: str | None) -> tuple[str, tuple[Any, ...]]:
+    """Return WHERE clause & its parameters selecting scores in window (and for device)."""
+    clauses: list[str] = []
+    params: list[Any] = []
+    if (start := window_start(window)) is not None:
+        clauses.append("timestamp >= ?")
+        params.append(start)
+    if device_id is not None:
+        clauses.append("device_id = ?")
+        params.append(device_id)
+    return ("WHERE " + " AND ".join(clauses)) if clauses else "", tuple(params)
@@ -0,0 +1,238 @@
+"""Archive of finished sessions (SQLite in WAL mode), browsable page by page.
+
+Devices keep only summaries of their latest sessions in memory (DeviceState.past_sessions, as
+sent in /devices); each session's events & per-level tallies are stored here when it ends and
+loaded only when asked for (/sessions/{id}). So history grows on disk, not in memory or in
+every device payload, and survives restarts.
+
+Thread Safety:
+    As scores.py: add() numbers the session & queues it; a single writer thread stores queued
+    sessions in batches (serializing & compressing them off the MQTT thread). Sessions are
+    written in the order they're numbered, and served from memory until they are.
+    Queries use one connection per calling thread; WAL lets them run while the writer commits.
+"""
+
+from __future__ import annotations
+
+import json
+import queue
+import sqlite3
+import threading
+import zlib
+from typing import TYPE_CHECKING, Any, ClassVar, Final
+
+from .env import DATA_DIR
+
+if TYPE_CHECKING:
+    from pathlib import Path
+
+    from .state import Session
+    from .types import SessionPage, SessionSummary
+
+# Persistent storage location
+SESSIONS_DB: Final = DATA_DIR / "sessions.db"
+
+_SCHEMA: Final = """
+CREATE TABLE IF NOT EXISTS sessions (
+    id         INTEGER PRIMARY KEY,  -- In order archived
+    device_id  TEXT    NOT NULL,
+    started_at INTEGER NOT NULL,     -- Unix timestamps (ms)
+    ended_at   INTEGER NOT NULL,
+    won        INTEGER,              -- NULL if unknown
+    score      INTEGER NOT NULL,
+    pops       INTEGER NOT NULL,
+    n_events   INTEGER NOT NULL,
+    detail     BLOB    NOT NULL      -- zlib'd JSON of the session's DETAIL_FIELDS
+);
+CREATE INDEX IF NOT EXISTS sessions_by_device ON sessions (device_id, id DESC);
+"""
+
+# Session fields stored in detail (loaded only by get()); the rest are in its summary
+DETAIL_FIELDS: Final = ("hits", "misses", "lates", "rt_sum", "rt_min", "rt_max", "events")
+
+_SUMMARY_COLUMNS: Final = "id, started_at, ended_at, won, score, pops, n_events"
+
+type _Queued = tuple[str, SessionSummary, Session]  # (device_id, summary, session)
+
+
+def _summary(session_id: int, session: Session) -> SessionSummary:
+    return {
+        "id": session_id,
+        "started_at": session.started_at,
+        "ended_at": session.ended_at,
+        "won": session.won,
+        "score": session.score,
+        "pops": session.pops,
+        "n_events": len(session.events),
+    }
+
+
+def _detail(session: Session) -> dict[str, Any]:
+    return {name: getattr(session, name) for name in DETAIL_FIELDS}
+
+
+def _summary_row(row: tuple[Any, ...]) -> SessionSummary:
+    session_id, started_at, ended_at, won, score, pops, n_events = row
+    return {
+        "id": session_id,
+        "started_at": started_at,
+        "ended_at": ended_at,
+        "won": None if won is None else bool(won),
+        "score": score,
+        "pops": pops,
+        "n_events": n_events,
+    }
+
+
+class SessionArchive:
+    """Finished sessions in an SQLite database (see module docstring)."""
+
+    BATCH_MAX: ClassVar = 64  # Max sessions committed per transaction
+
+    def __init__(self, path: Path) -> None:
+        self._path = path
+        self._local = threading.local()
+        self._queue: queue.Queue[_Queued | None] = queue.Queue()
+        self._lock = threading.Lock()  # Guards _last_id & _pending
+        self._pending: dict[int, _Queued] = {}  # Session ID -> queued session, until written
+
+        db = self._db()
+        db.executescript(_SCHEMA)
+        self._last_id: int = db.execute("SELECT COALESCE(MAX(id), 0) FROM sessions").fetchone()[0]
+        self._writer = threading.Thread(target=self._write_loop, name="session-writer", daemon=True)
+        self._writer.start()
+
+    def add(self, device_id: str, session: Session) -> SessionSummary:
+        """Give a finished session its ID & queue it for writing; return its summary.
+
+        Session mustn't change after this (it's written later, from another thread).
+        """
+        with self._lock:  # Queued in ID order, so every session before the oldest pending one is written
+            self._last_id += 1
+            queued = (device_id, _summary(self._last_id, session), session)
+            self._pending[self._last_id] = queued
+            self._queue.put(queued)
+        return queued[1]
+
+    def close(self) -> None:
+        """Write queued sessions & stop the writer."""
+        self._queue.put(None)
+        self._writer.join()
+
+    def page(self, device_id: str, limit: int, offset: int = 0) -> tuple[list[SessionSummary], int]:
+        """Return a page of device's session summaries (newest first) & its total number of sessions."""
+        with self._lock:
+            oldest_pending = min(self._pending, default=self._last_id + 1)
+            pending = [summary for d, summary, _ in self._pending.values() if d == device_id]
+        pending.sort(key=lambda s: s["id"], reverse=True)
+
+        # Sessions older than the oldest pending one are all written (& pending ones maybe too)
+        db = self._db()
+        where = "WHERE device_id = ? AND id < ?"
+        stored = db.execute(f"SELECT COUNT(*) FROM sessions {where}", (device_id, oldest_pending)).fetchone()[0]  # noqa: S608
+        page = pending[offset : offset + limit]
+        if len(page) < limit:
+            rows = db.execute(
+                f"SELECT {_SUMMARY_COLUMNS} FROM sessions {where} ORDER BY id DESC LIMIT ? OFFSET ?",  # noqa: S608
+                (device_id, oldest_pending, limit - len(page), max(0, offset - len(pending))),
+            )
+            page += map(_summary_row, rows)
+        return page, len(pending) + stored
+
+    def get(self, session_id: int) -> dict[str, Any] | None:
+        """Return a session (device_id, summary & DETAIL_FIELDS), or None if there's no such session."""
+        with self._lock:
+            queued = self._pending.get(session_id)
+        if queued is not None:
+            device_id, summary, session = queued
+            return {"device_id": device_id, **summary, **_detail(session)}
+
+        query = f"SELECT device_id, {_SUMMARY_COLUMNS}, detail FROM sessions WHERE id = ?"  # noqa: S608
+        row = self._db().execute(query, (session_id,)).fetchone()
+        if row is None:
+            return None
+        return {"device_id": row[0], **_summary_row(row[1:-1]), **json.loads(zlib.decompress(row[-1]))}
+
+    def _db(self) -> sqlite3.Connection:
+        """Return calling thread's connection (opened on first use)."""
+        db: sqlite3.Connection | None = getattr(self._local, "db", None)
+        if db is None:
+            db = sqlite3.connect(self._path, timeout=10)
+            db.execute("PRAGMA journal_mode=WAL")
+            db.execute("PRAGMA synchronous=NORMAL")  # Durable at checkpoints; can't corrupt in WAL mode
+            self._local.db = db
+        return db
+
+    def _write_loop(self) -> None:
+        db = self._db()
+        while True:
+            batch = [self._queue.get()]
+            while len(batch) < SessionArchive.BATCH_MAX:
+                try:
+                    batch.append(self._queue.get_nowait())
+                except queue.Empty:
+                    break
+
+            sessions = [s for s in batch if s is not None]
+            rows = [  # Summary's values are in _SUMMARY_COLUMNS order
+                (
+                    device_id,
+                    *summary.values(),
+                    zlib.compress(json.dumps(_detail(session), separators=(",", ":")).encode()),
+                )
+                for device_id, summary, session in sessions
+            ]
+            try:
+                with db:
+                    db.executemany(
+                        f"INSERT INTO sessions (device_id, {_SUMMARY_COLUMNS}, detail) VALUES ({', '.join('?' * 9)})",  # noqa: S608
+                        rows,
+                    )
+            except sqlite3.Error as e:
+                print(f"[Sessions] Failed to write {len(rows)} session(s): {e}")
+
+            with self._lock:
+                for _, summary, _ in sessions:
+                    del self._pending[summary["id"]]
+            if len(sessions) < len(batch):
+                return
+
+
+# Session archive (opened by init())
+session_archive: SessionArchive | None = None
+
+
+def archive(device_id: str, session: Session) -> SessionSummary:
+    """Archive a finished session (which mustn't change after); return its summary."""
+    assert session_archive is not None  # noqa: S101 - init() runs before MQTT ingest starts
+    return session_archive.add(device_id, session)
+
+
+def recent(device_id: str, n: int) -> list[SessionSummary]:
+    """Return summaries of device's latest n archived sessions, newest first (none if not opened)."""
+    return [] if session_archive is None else session_archive.page(device_id, n)[0]
+
+
+def get_sessions(device_id: str, limit: int, offset: int) -> SessionPage:
+    """Return a page of device's archived sessions' summaries, newest first."""
+    assert session_archive is not None  # noqa: S101 - init() runs before the API starts
+    sessions, total = session_archive.page(device_id, limit, offset)
+    return {"sessions": sessions, "total": total, "limit": limit, "offset": offset}
+
+
+def get_session(session_id: int) -> dict[str, Any] | None:
+    """Return an archived session with its events, or None if there's no such session."""
+    assert session_archive is not None  # noqa: S101 - init() runs before the API starts
+    return session_archive.get(session_id)
+
+
+def init() -> None:
+    """Open the session archive (creating it if needed). Must be called once before ingest starts."""
+    global session_archive  # noqa: PLW0603
+    session_archive = SessionArchive(SESSIONS_DB)
+
+
+def close() -> None:
+    """Write queued sessions (at shutdown)."""
+    if session_archive is not None:
+        session_archive.close()
@@ -0,0 +1,188 @@
+"""Streaming reaction-time quantiles per device, level & mole, over rolling windows.
+
+Each hit's reaction time is counted (on ingest) in fixed-size histograms, so a quantile costs
+the same however many sessions have been played - unlike walking raw events or scanning the
+pop history (events.py).
+
+Histogram (HDR-style, log-linear): exact below 32 ms, then 16 buckets per power of two, so a
+reported quantile is within ~3% of the true value. Times are clamped to MAX_MS. Histograms
+merge by adding counts.
+
+Windows: a device keeps, per (level, mole), an all-time histogram plus rings of time slots -
+12 x 5 min ("hour"), 24 x 1 h ("day"), 7 x 1 day ("week"). A window's histogram is the merge of
+its ring's slots, so windows slide by a slot at a time. A pop for a slot older than the ring
+holds counts towards "all" only.
+
+Memory per device is bounded: 64 keys x (1 + 12 + 24 + 7) slots x BUCKETS counters at most
+(~1.6 MB; only keys played in a slot take space). Rebuilt from the pop history at startup.
+"""
+
+from __future__ import annotations
+
+import bisect
+import itertools
+import threading
+import time
+from array import array
+from collections import deque
+from typing import TYPE_CHECKING, Any, Final, Literal
+
+if TYPE_CHECKING:
+    from collections.abc import Iterable, Sequence
+
+    from .events import EventStore
+    from .types import HeatmapCell, ReactionQuantiles
+
+type SketchWindow = Literal["hour", "day", "week", "all"]
+type _Key = tuple[int, int]  # (lvl, mole)
+type _Slots = dict[_Key, array]
+
+MAX_MS: Final = 4095
+_LINEAR: Final = 32  # Exact buckets (ms) before log-linear ones
+_SUB: Final = 16  # Buckets per power of two above _LINEAR
+
+
+def _bucket(ms: int) -> int:
+    if ms < _LINEAR:
+        return ms
+    bits = ms.bit_length()
+    shift = bits - 5
+    return _LINEAR + (bits - 6) * _SUB + (ms >> shift) - _SUB
+
+
+def _midpoint(bucket: int) -> int:
+    if bucket < _LINEAR:
+        return bucket
+    octave, sub = divmod(bucket - _LINEAR, _SUB)
+    shift = octave + 1  # Bucket width is 1 << shift
+    return ((_SUB + sub) << shift) + (1 << shift) // 2
+
+
+BUCKETS: Final = _bucket(MAX_MS) + 1
+_INDEX: Final = array("H", map(_bucket, range(MAX_MS + 1)))  # ms -> bucket
+_VALUE: Final = array("H", map(_midpoint, range(BUCKETS)))  # Bucket -> value reported for quantiles
+
+# Window -> (slot length (ms), slots in ring)
+WINDOWS: Final = {"hour": (300_000, 12), "day": (3_600_000, 24), "week": (86_400_000, 7)}
+
+
+def _bump(slots: _Slots, key: _Key, bucket: int) -> None:
+    if (counts := slots.get(key)) is None:
+        counts = slots[key] = array("I", bytes(4 * BUCKETS))
+    counts[bucket] += 1
+
+
+def _merge(histograms: Sequence[array]) -> list[int]:
+    return [sum(column) for column in zip(*histograms, strict=True)] if histograms else [0] * BUCKETS
+
+
+def _quantiles(counts: Sequence[int]) -> ReactionQuantiles:
+    """Return count & p50/p90/p99 (ms; None if empty) of a histogram."""
+    cumulative = list(itertools.accumulate(counts))
+    n = cumulative[-1]
+
+    def at(q: float) -> int | None:
+        return _VALUE[bisect.bisect_right(cumulative, q * n)] if n else None
+
+    return {"n": n, "p50_ms": at(0.5), "p90_ms": at(0.9), "p99_ms": at(0.99)}
+
+
+class _DeviceSketches:
+    """One device's all-time histograms & slot rings (see module docstring)."""
+
+    def __init__(self) -> None:
+        self.total: _Slots = {}
+        self.rings: dict[str, deque[tuple[int, _Slots]]] = {w: deque(maxlen=n) for w, (_, n) in WINDOWS.items()}
+        self._slot_rings = [(WINDOWS[window][0], ring) for window, ring in self.rings.items()]
+
+    def add(self, key: _Key, ts: int, bucket: int) -> None:
+        _bump(self.total, key, bucket)
+        for slot_ms, ring in self._slot_rings:
+            start = ts - ts % slot_ms
+            if not ring or ring[-1][0] < start:
+                ring.append((start, {}))
+            elif ring[-1][0] > start:  # Late pop: find its slot, if still in the ring
+                slots = next((slots for slot_start, slots in ring if slot_start == start), None)
+                if slots is not None:
+                    _bump(slots, key, bucket)
+                continue
+            _bump(ring[-1][1], key, bucket)
+
+    def window(self, window: SketchWindow, now: int) -> Iterable[_Slots]:
+        """Return slots covering window (up to now)."""
+        if window == "all":
+            return [self.total]
+        slot_ms, n = WINDOWS[window]
+        oldest = now - now % slot_ms - (n - 1) * slot_ms
+        return [slots for start, slots in self.rings[window] if start >= oldest]
+
+
+class SketchIndex:
+    """Reaction-time histograms of every device (see module docstring). Thread-safe."""
+
+    def __init__(self) -> None:
+        self._lock = threading.Lock()
+        self._devices: dict[str, _DeviceSketches] = {}
+
+    def add(self, device_id: str, ts: int, lvl: int, mole: int, reaction_ms: int) -> None:
+        """Count a hit's reaction time."""
+        bucket = _INDEX[min(max(reaction_ms, 0), MAX_MS)]
+        with self._lock:
+            if (device := self._devices.get(device_id)) is None:
+                device = self._devices[device_id] = _DeviceSketches()
+            device.add((lvl, mole), ts, bucket)
+
+    def quantiles(
+        self,
+        window: SketchWindow,
+        device_id: str | None = None,
+        lvl: int | None = None,
+        mole: int | None = None,
+    ) -> ReactionQuantiles:
+        """Return reaction-time quantiles over window, of one device/level/mole or any mix (None: all)."""
+        now = int(time.time() * 1000)
+        with self._lock:  # Only to collect histograms: merged after (counts only ever go up)
+            devices = self._devices.values() if device_id is None else [self._devices.get(device_id)]
+            histograms = [
+                counts
+                for device in devices
+                if device is not None
+                for slots in device.window(window, now)
+                for (key_lvl, key_mole), counts in slots.items()
+                if (lvl is None or key_lvl == lvl) and (mole is None or key_mole == mole)
+            ]
+        return _quantiles(_merge(histograms))
+
+    def heatmap(self, device_id: str, window: SketchWindow) -> list[HeatmapCell]:
+        """Return device's reaction-time quantiles per (level, mole) hit over window."""
+        now = int(time.time() * 1000)
+        by_key: dict[_Key, list[array]] = {}
+        with self._lock:
+            if (device := self._devices.get(device_id)) is None:
+                return []
+            for slots in device.window(window, now):
+                for key, counts in slots.items():
+                    by_key.setdefault(key, []).append(counts)
+        return [{"lvl": lvl, "mole": mole, **_quantiles(_merge(h))} for (lvl, mole), h in sorted(by_key.items())]
+
+
+# Global sketches - fed on ingest (record_hit()), rebuilt by init()
+SKETCHES: Final = SketchIndex()
+
+
+def record_hit(device_id: str, event: dict[str, Any], ts: int) -> None:
+    """Count a pop_result's reaction time if it was a hit."""
+    if event.get("outcome") == "hit":
+        SKETCHES.add(
+            device_id, ts, int(event.get("lvl", 1)), int(event.get("mole_id", 0)), int(event.get("reaction_ms", 0))
+        )
+
+
+def init(store: EventStore) -> None:
+    """Rebuild sketches from the pop history (at startup, before ingest starts)."""
+    started = time.perf_counter()
+    n = 0
+    for device_id, ts, lvl, mole, reaction_ms in store.hits():
+        SKETCHES.add(device_id, ts, lvl, mole, reaction_ms)
+        n += 1
+    print(f"[Sketches] Rebuilt from {n} hits ({(time.perf_counter() - started) * 1000:.0f}ms)")
@@ -2,36 +2,108 @@
 Shared in-memory state between MQTT handler and API endpoints.
 
 Thread Safety:
-    All access to `devices` dict must be protected by DEV_LOCK.
-    MQTT handler thread and FastAPI request handlers run concurrently.
+    Each device has its own lock (DeviceEntry): writers edit its DeviceState under it with
+    `with entry as device:`. Leaving that block publishes an immutable DeviceSnapshot of the
+    device, which readers use without taking any lock. The registry itself is copy-on-write
+    (see registry()), so finding or listing devices never locks either.
+
+    Snapshots are published under COMMIT_LOCK along with the changes recorded during the edit
+    (see push.py), so whoever holds COMMIT_LOCK sees snapshots consistent with the changes
+    published so far. It's held only to swap in a snapshot, never while editing.
+
+Versions:
+    Every published snapshot has a version (per device) and bumps the registry's version(), so
+    /devices can tell a client its copy is current (ETag) without serializing anything. Each
+    snapshot's JSON is serialized at most once, however many requests read it.
 
 Data Flow:
-    MQTT messages -> handle_message() -> updates DeviceState
-    API requests  -> get_devices()    -> reads DeviceState
+    MQTT messages -> handle_message() -> edits DeviceState -> publishes DeviceSnapshot
+    API requests  -> get_devices()    -> reads DeviceSnapshot
+
+    Finished sessions are archived to disk (sessions.py); a device keeps only their summaries.
 """
 
+from __future__ import annotations
+
+import json
 import threading
-from dataclasses import dataclass, field
-from typing import Any, Final
+from dataclasses import dataclass, field, fields
+from functools import cached_property
+from types import MappingProxyType
+from typing import TYPE_CHECKING, Any, Final
 
-from dashboard.types import DevGameState, DevStatus
+from dashboard.leaderboard import hit_points
+from dashboard.sessions import recent as recent_sessions
 
-# Number of completed sessions to retain per device (for session history display)
+if TYPE_CHECKING:
+    from collections.abc import Callable, Mapping
+
+    from dashboard.types import DevGameState, DevStatus, SessionSummary
+
+# Number of completed sessions' summaries kept per device (older ones: /devices/{id}/sessions)
 MAX_PAST_SESSIONS: Final = 5
 
-# Global lock protecting the devices dictionary (multiple threads access it)
-DEV_LOCK: Final = threading.Lock()
+# Game levels (per-level tallies are indexed lvl - 1, as in the device's session_end summary)
+LEVELS: Final = 8
+
+
+def _per_level() -> list[int]:
+    return [0] * LEVELS
+
+
+# Held to publish a device snapshot (see module docstring)
+COMMIT_LOCK: Final = threading.Lock()
+
+# Bumped (under COMMIT_LOCK) whenever a snapshot is published or a device is added
+_version = 0
+
+# Guards adding devices to the registry (readers don't take it)
+_REGISTRY_LOCK: Final = threading.Lock()
+
+# A change recorded during an edit: (kind, builds its message data once the snapshot is published)
+type Change = tuple[str, Callable[[], dict[str, Any]]]
 
 
 @dataclass
 class Session:
-    """Tracks a single game session from session_start to session_end."""
+    """Tracks a single game session from session_start to session_end.
+
+    Score & tallies are kept up to date per event by add_event() rather than rescanning events.
+    """
 
     events: list[dict[str, Any]] = field(default_factory=list)
     started_at: int = 0
     ended_at: int = 0
     won: bool | None = None
     score: int = 0
+    pops: int = 0  # pop_result events received
+    hits: list[int] = field(default_factory=_per_level)  # Per level
+    misses: list[int] = field(default_factory=_per_level)
+    lates: list[int] = field(default_factory=_per_level)
+    rt_sum: int = 0  # Sum of hit reaction times (ms)
+    rt_min: int | None = None  # Fastest/slowest hit reaction time (ms)
+    rt_max: int | None = None
+
+    def add_event(self, event: dict[str, Any]) -> None:
+        """Append event, updating score & tallies (O(1); same score as calculate_score(events))."""
+        self.events.append(event)
+        if event.get("event_type") != "pop_result":
+            return
+
+        self.pops += 1
+        self.score += hit_points(event)
+
+        outcome = event.get("outcome")
+        lvl = event.get("lvl", 1)
+        if outcome in ("miss", "late") and 1 <= lvl <= LEVELS:
+            (self.misses if outcome == "miss" else self.lates)[lvl - 1] += 1
+        elif outcome == "hit":
+            if 1 <= lvl <= LEVELS:
+                self.hits[lvl - 1] += 1
+            reaction_ms = event.get("reaction_ms", 1000)
+            self.rt_sum += reaction_ms
+            self.rt_min = reaction_ms if self.rt_min is None else min(self.rt_min, reaction_ms)
+            self.rt_max = reaction_ms if self.rt_max is None else max(self.rt_max, reaction_ms)
 
 
 @dataclass
@@ -47,9 +119,154 @@ class DeviceState:
     game_state: DevGameState = "idle"
     last_seen: int = 0  # Last MQTT message timestamp (ms)
     current_session: Session | None = None  # Active session (if playing)
-    past_sessions: list[Session] = field(default_factory=list)
+    past_sessions: list[SessionSummary] = field(default_factory=list)  # Latest archived, newest first
+    events_lost: int = 0  # Dropped by device's offline buffer (reported via buffer_loss)
+    level: int = 1  # Current/last level (1-8)
+    lives: int = 5
+    paused: bool = False
+    buffered: int = 0  # Events in device's offline buffer at last status snapshot
+    clock: dict[str, Any] | None = None  # Agent's device clock sync estimate (offset/drift/error)
+    last_seq: tuple[int, int] | None = None  # (seq_epoch, seq) of last game event handled
+    pending_cmds: dict[str, dict[str, Any]] = field(default_factory=dict)  # Request ID -> {cmd, sent_at}
+    last_cmd: dict[str, Any] | None = None  # Latest command result from agent (cmd, status, rtt_ms, ...)
+
+
+# DeviceState fields besides its sessions (DeviceSnapshot.fields)
+DEVICE_FIELDS: Final = tuple(f.name for f in fields(DeviceState) if f.name not in ("current_session", "past_sessions"))
+SESSION_FIELDS: Final = tuple(f.name for f in fields(Session) if f.name != "events")
+
+
+def _copy(value: Any) -> Any:  # noqa: ANN401
+    """Copy a field that's edited in place (dicts/lists of immutables); others are only ever replaced."""
+    return value.copy() if isinstance(value, (dict, list)) else value
+
+
+@dataclass(frozen=True, slots=True)
+class SessionSnapshot:
+    """A session as of one snapshot.
+
+    Events are only ever appended (and never changed once added), so instead of copying them
+    a snapshot shares the session's list & remembers how many of its events it covers.
+    """
+
+    fields: dict[str, Any]  # Session's fields except events
+    events: list[dict[str, Any]]  # The session's own list - read only the first n_events
+    n_events: int
+
+    @staticmethod
+    def of(session: Session) -> SessionSnapshot:
+        return SessionSnapshot(
+            {name: _copy(getattr(session, name)) for name in SESSION_FIELDS}, session.events, len(session.events)
+        )
 
+    def to_dict(self) -> dict[str, Any]:
+        return {"events": self.events[: self.n_events], **self.fields}
+
+
+@dataclass(frozen=True)
+class DeviceSnapshot:
+    """Immutable view of a device's state (published after every edit; read without locking)."""
+
+    fields: dict[str, Any]  # DEVICE_FIELDS
+    current_session: SessionSnapshot | None
+    past_sessions: tuple[SessionSummary, ...]  # Never changed once archived
+    version: int  # Device's edit count as of this snapshot
+
+    @cached_property
+    def json(self) -> bytes:
+        """Return to_dict() serialized (once per snapshot, on first use)."""
+        return json.dumps(self.to_dict(), separators=(",", ":")).encode()
+
+    def to_dict(self) -> dict[str, Any]:
+        """Return device as asdict(DeviceState) would (for JSON; don't modify)."""
+        return {
+            **self.fields,
+            "current_session": None if self.current_session is None else self.current_session.to_dict(),
+            "past_sessions": list(self.past_sessions),
+        }
+
+
+class DeviceEntry:
+    """A device's state, the lock guarding it and its latest snapshot (see module docstring)."""
+
+    state: DeviceState  # Edit only via `with entry as device:`
+    snapshot: DeviceSnapshot  # Latest published state (read freely)
+    changes: list[Change]  # Recorded during the current edit, published with its snapshot
+
+    def __init__(self, state: DeviceState) -> None:
+        self.state = state
+        self.changes = []
+        self._lock = threading.Lock()
+        self.snapshot = DeviceSnapshot({}, None, (), 0)
+        self.snapshot = self._take_snapshot()
+
+    def __enter__(self) -> DeviceState:
+        self._lock.acquire()
+        return self.state
+
+    def __exit__(self, *_: object) -> None:
+        global _version  # noqa: PLW0603
+        try:
+            snapshot = self._take_snapshot()
+            with COMMIT_LOCK:
+                _version += 1
+                self.snapshot = snapshot
+                for hook in _commit_hooks:
+                    hook(self.changes)
+        finally:
+            self.changes = []
+            self._lock.release()
+
+    def _take_snapshot(self) -> DeviceSnapshot:
+        state = self.state
+        return DeviceSnapshot(
+            {name: _copy(getattr(state, name)) for name in DEVICE_FIELDS},
+            None if state.current_session is None else SessionSnapshot.of(state.current_session),
+            tuple(state.past_sessions),
+            self.snapshot.version + 1,
+        )
+
+
+# Called with each edit's changes as its snapshot is published (under COMMIT_LOCK)
+_commit_hooks: list[Callable[[list[Change]], None]] = []
+
+# Global device registry - keyed by device_id. Never modified: replaced with an updated copy
+# when a device is added, so it can be read (iterated) without locking.
+_devices: Mapping[str, DeviceEntry] = MappingProxyType({})
+
+
+def on_commit(hook: Callable[[list[Change]], None]) -> None:
+    """Call hook with each edit's recorded changes as its snapshot is published (under COMMIT_LOCK)."""
+    _commit_hooks.append(hook)
+
+
+def registry() -> Mapping[str, DeviceEntry]:
+    """Return the device registry as it is now (read-only; later additions don't show up in it)."""
+    return _devices
+
+
+def version() -> int:
+    """Return the registry's version (changes whenever any device's snapshot does, or one is added).
+
+    Read it before the snapshots: they're then at least as new as it says.
+    """
+    return _version
+
+
+def device_entry(device_id: str, **defaults: Any) -> DeviceEntry:  # noqa: ANN401
+    """Return device's entry, creating it with the given DeviceState field defaults if new (auto-discovery).
+
+    A new device's past sessions are its latest archived ones (e.g. from before a restart).
+    """
+    global _devices, _version  # noqa: PLW0603
 
-# Global device registry - keyed by device_id
-# Protected by DEV_LOCK for thread safety
-devices: dict[str, DeviceState] = {}
+    if (entry := _devices.get(device_id)) is not None:
+        return entry
+    with _REGISTRY_LOCK:
+        if (entry := _devices.get(device_id)) is None:
+            past_sessions = recent_sessions(device_id, MAX_PAST_SESSIONS)
+            entry = DeviceEntry(DeviceState(device_id=device_id, past_sessions=past_sessions, **defaults))
+            with COMMIT_LOCK:
+                _devices = MappingProxyType({**_devices, device_id: entry})
+                _version += 1
+        return entry
@@ -1,9 +1,21 @@
-const REFRESH_INTERVAL = 1000;  // 1 second - balance between responsiveness and smoothness
+const REFRESH_INTERVAL = 1000;  // 1 second - polling fallback when the change stream is unavailable
 const LEADERBOARD_REFRESH_INTERVAL = 5000;
-
-const knownDevices = new Map();
+const REACTION_REFRESH_INTERVAL = 10000;
+const STREAM_RETRY_INTERVAL = 5000;
+const PAST_SESSIONS_SHOWN = 5;  // Latest sessions in a device's state (server's MAX_PAST_SESSIONS)
+const PAST_SESSIONS_PAGE = 10;  // Older sessions fetched per "Show older sessions"
+
+const knownDevices = new Map();  // Device ID -> device as last rendered
+const deviceState = new Map();  // Device ID -> latest device state (from /stream)
+const dirtyDevices = new Set();  // Devices changed since last render (rendered once per frame)
 let currentTab = 'devices';
 let leaderboardInterval;
+let reactionInterval;
+let leaderboardEntries = null;  // Latest leaderboard from /stream (null while polling)
+let stream = null;
+let lastEventId = null;  // "<epoch>-<seq>" of last message applied from /stream
+let lastSeq = null;
+let pollInterval = null;
 const LEVELS = Array.from({ length: 8 }, (_, idx) => idx + 1);
 const LEVEL_BTN_ENABLED =
   "level-btn bg-sky-600 hover:bg-sky-500 text-gray-50 font-medium px-2.5 py-1 rounded-md text-sm transition-colors";
@@ -20,20 +32,43 @@ async function fetchLeaderboard() {
   return res.json();
 }
 
+async function fetchSessions(deviceId, offset, limit) {
+  const res = await fetch(`devices/${encodeURIComponent(deviceId)}/sessions?offset=${offset}&limit=${limit}`);
+  return res.json();
+}
+
+async function fetchSession(sessionId) {
+  const res = await fetch(`sessions/${sessionId}`);
+  return res.ok ? res.json() : null;
+}
+
+async function fetchReactionHeatmap(deviceId, window) {
+  const res = await fetch(`analytics/heatmap/${encodeURIComponent(deviceId)}?window=${window}`);
+  return res.json();
+}
+
 function showTab(tab) {
   currentTab = tab;
-  document.getElementById('devices').classList.toggle('hidden', tab !== 'devices');
-  document.getElementById('leaderboard').classList.toggle('hidden', tab !== 'leaderboard');
-  
-  document.getElementById('tab-devices').className = tab === 'devices'
-    ? 'px-4 py-2 rounded-lg bg-sky-600 text-white font-medium'
-    : 'px-4 py-2 rounded-lg bg-gray-800 text-gray-400 font-medium hover:bg-gray-700';
-  
-  document.getElementById('tab-leaderboard').className = tab === 'leaderboard'
-    ? 'px-4 py-2 rounded-lg bg-sky-600 text-white font-medium'
-    : 'px-4 py-2 rounded-lg bg-gray-800 text-gray-400 font-medium hover:bg-gray-700';
-  
-  if (tab === 'leaderboard') {
+  for (const name of ['devices', 'leaderboard', 'reaction']) {
+    document.getElementById(name).classList.toggle('hidden', tab !== name);
+    document.getElementById(`tab-${name}`).className = tab === name
+      ? 'px-4 py-2 rounded-lg bg-sky-600 text-white font-medium'
+      : 'px-4 py-2 rounded-lg bg-gray-800 text-gray-400 font-medium hover:bg-gray-700';
+  }
+
+  if (tab === 'reaction') {
+    refreshReaction();
+    if (!reactionInterval) {
+      reactionInterval = setInterval(refreshReaction, REACTION_REFRESH_INTERVAL);
+    }
+  } else if (reactionInterval) {
+    clearInterval(reactionInterval);
+    reactionInterval = null;
+  }
+
+  if (tab === 'leaderboard' && leaderboardEntries) {
+    renderLeaderboard(leaderboardEntries);  // Kept current by /stream
+  } else if (tab === 'leaderboard') {
     refreshLeaderboard();
     if (!leaderboardInterval) {
       leaderboardInterval = setInterval(refreshLeaderboard, LEADERBOARD_REFRESH_INTERVAL);
@@ -151,6 +186,66 @@ function renderMoleHeatmap(moleStats) {
     .join("");
 }
 
+// Reaction tab: a device's median hit reaction time per (level, mole), from the server's
+// streaming sketches (cheap to fetch whatever the history) - green is its fastest, red its slowest.
+
+async function refreshReaction() {
+  const select = document.getElementById('reaction-device');
+  const deviceIds = [...new Set([...deviceState.keys(), ...knownDevices.keys()])].sort();
+  const selected = select.value || deviceIds[0];
+  select.innerHTML = deviceIds
+    .map((id) => `<option value="${id}" ${id === selected ? 'selected' : ''}>${id}</option>`)
+    .join('');
+
+  const container = document.getElementById('reaction-heatmap');
+  if (!selected) {
+    container.innerHTML = '<div class="py-16 text-center text-gray-500 text-lg">No devices yet</div>';
+    return;
+  }
+  const window = document.getElementById('reaction-window').value;
+  container.innerHTML = renderReactionHeatmap(await fetchReactionHeatmap(selected, window));
+}
+
+function renderReactionHeatmap(cells) {
+  if (cells.length === 0) {
+    return '<div class="py-16 text-center text-gray-500 text-lg">No hits in this window</div>';
+  }
+
+  const byKey = new Map(cells.map((cell) => [`${cell.lvl}-${cell.mole}`, cell]));
+  const medians = cells.map((cell) => cell.p50_ms);
+  const fastest = Math.min(...medians);
+  const range = Math.max(...medians) - fastest || 1;
+  const moles = Array.from({ length: 8 }, (_, idx) => idx);
+
+  const header = moles
+    .map((mole) => `<div class="text-xs text-gray-500 text-center">Mole ${mole + 1}</div>`)
+    .join('');
+  const rows = LEVELS.map((lvl) => {
+    const tiles = moles.map((mole) => {
+      const cell = byKey.get(`${lvl}-${mole}`);
+      if (!cell) {
+        return '<div class="h-12 rounded-lg bg-gray-800 opacity-30"></div>';
+      }
+      const hue = 140 * (1 - (cell.p50_ms - fastest) / range);  // 140 (green) -> 0 (red)
+      const title = `Level ${lvl}, mole ${mole + 1}: ${cell.n} hits, p50 ${cell.p50_ms}ms, p90 ${cell.p90_ms}ms, p99 ${cell.p99_ms}ms`;
+      return `
+        <div class="h-12 rounded-lg flex items-center justify-center text-white text-sm font-semibold"
+          style="background-color: hsl(${hue.toFixed(0)}, 65%, 38%)" title="${title}">
+          ${cell.p50_ms}
+        </div>
+      `;
+    }).join('');
+    return `<div class="text-xs text-gray-500 self-center">Level ${lvl}</div>${tiles}`;
+  }).join('');
+
+  return `
+    <div class="grid gap-2 min-w-[36rem]" style="grid-template-columns: auto repeat(8, minmax(0, 1fr))">
+      <div></div>${header}${rows}
+    </div>
+    <div class="text-xs text-gray-500 mt-3">Median reaction time (ms) of hits; hover a tile for hit count &amp; p90/p99.</div>
+  `;
+}
+
 function renderAnalysisModal(session, deviceId, sessionIndex) {
   const analysis = analyzeSession(session);
   if (!analysis) return "";
@@ -300,12 +395,11 @@ function computeScoreTimeline(events) {
   let cumulativeScore = 0;
 
   popEvents.forEach((e, idx) => {
-    // Calculate score for this hit (simplified scoring formula)
+    // Score for this hit - integer formula, as the server's hit_points() (floats can come out 1 lower)
     if (e.outcome === "hit") {
       const lvl = e.lvl || 1;
       const reactionMs = e.reaction_ms || 1000;
-      const speedBonus = Math.max(0.5, 2 - reactionMs / 1000);
-      cumulativeScore += Math.trunc(100 * lvl * speedBonus);
+      cumulativeScore += Math.trunc((lvl * (2000 - Math.min(reactionMs, 1500))) / 10);
     }
 
     timeline.push({
@@ -551,6 +645,12 @@ function getStatusConfig(status) {
         text: "Online",
         textClass: "text-emerald-400",
       };
+    case "unresponsive":
+      return {
+        dot: "bg-amber-500",
+        text: "Unresponsive",
+        textClass: "text-amber-400",
+      };
     case "serial_error":
       return {
         dot: "bg-orange-500",
@@ -567,12 +667,40 @@ function getStatusConfig(status) {
 }
 
 function getGameStateBadge(device) {
-  const text = device.game_state === "playing" ? "Playing" : "Idle";
-  const bgClass =
-    device.game_state === "playing" ? "bg-emerald-600" : "bg-gray-600";
+  const playing = device.game_state === "playing";
+  const text = device.paused
+    ? `Paused · L${device.level}`
+    : playing
+    ? `Playing · L${device.level}`
+    : "Idle";
+  const bgClass = device.paused
+    ? "bg-amber-600"
+    : playing
+    ? "bg-emerald-600"
+    : "bg-gray-600";
   return `<span class="px-2 py-0.5 rounded text-xs font-medium ${bgClass}">${text}</span>`;
 }
 
+function renderEventsLost(device) {
+  return device.events_lost ? `${device.events_lost} events lost offline` : "";
+}
+
+const CMD_NAMES = { P: "Pause", R: "Reset", S: "Start" };
+
+function renderCommandState(device) {
+  const pending = Object.values(device.pending_cmds || {});
+  if (pending.length) {
+    const names = pending.map((c) => CMD_NAMES[c.cmd] || `L${c.cmd}`).join(", ");
+    return `${names} pending...`;
+  }
+  const last = device.last_cmd;
+  if (!last) return "";
+  const name = CMD_NAMES[last.cmd] || `L${last.cmd}`;
+  return last.rtt_ms != null
+    ? `${name} ${last.status} (${Math.round(last.rtt_ms)}ms)`
+    : `${name} ${last.status}`;
+}
+
 function renderLives(lives) {
   return (
     '<span class="text-rose-400">' +
@@ -619,12 +747,16 @@ function renderEvent(event) {
   if (type === "session_end") {
     const won = event.win === "true";
     const text = won ? "Victory!" : "Game Over";
+    const summary =
+      event.score !== undefined
+        ? `<span class="ml-2 text-gray-400 font-normal">${event.score.toLocaleString()} pts · avg ${event.rt_mean}ms</span>`
+        : "";
     const cls = won
       ? "text-emerald-400 bg-emerald-900/30"
       : "text-rose-400 bg-rose-900/30";
     return `
       <div class="flex items-center justify-center py-3 px-3 text-sm font-semibold ${cls}">
-        ${text}
+        ${text}${summary}
       </div>
     `;
   }
@@ -637,7 +769,7 @@ function renderEventLog(events) {
   return events.map(renderEvent).join("");
 }
 
-function renderPastSession(session, index, deviceId) {
+function renderPastSession(session, deviceId) {
   const date = new Date(session.started_at);
   const timeStr = date.toLocaleTimeString([], {
     hour: "2-digit",
@@ -647,52 +779,92 @@ function renderPastSession(session, index, deviceId) {
   const result = session.won
     ? '<span class="text-emerald-400">Won</span>'
     : '<span class="text-rose-400">Lost</span>';
-  const eventCount = session.events.length;
-
-  const hasPopEvents = session.events.some(
-    (e) => e.event_type === "pop_result"
-  );
-
-  const modalId = `analysis-${deviceId}-${index}`;
 
   return `
-    <details class="group">
+    <details class="group" ontoggle="loadPastSession(this, ${session.id}, '${deviceId}')">
       <summary class="flex items-center justify-between px-3 py-2 cursor-pointer hover:bg-gray-800/50 text-sm">
         <span class="text-gray-400">${timeStr}</span>
         <span>${result}</span>
-        <span class="text-gray-500">${eventCount} events</span>
+        <span class="text-gray-500">${session.n_events} events</span>
         <span class="text-gray-600 group-open:rotate-180 transition-transform">▼</span>
       </summary>
-      <div class="bg-gray-900/50">
-        <div class="max-h-48 overflow-y-auto">
-          ${renderEventLog(session.events)}
-        </div>
-        ${
-          hasPopEvents
-            ? `
-          <div class="px-3 py-2 border-t border-gray-800">
-            <button 
-              onclick="showAnalysis('${modalId}')" 
-              class="w-full bg-sky-600 hover:bg-sky-500 text-white font-medium py-2 px-4 rounded-lg text-sm transition-colors"
-            >
-              View Game Analysis
-            </button>
-          </div>
-        `
-            : ""
-        }
+      <div class="session-detail bg-gray-900/50">
+        <div class="px-3 py-2 text-xs text-gray-500">Loading events...</div>
       </div>
     </details>
-    ${hasPopEvents ? renderAnalysisModal(session, deviceId, index) : ""}
   `;
 }
 
+// Past sessions come as summaries; a session's events are fetched from the server's archive
+// when it's first expanded (and older sessions a page at a time).
+
+async function loadPastSession(details, sessionId, deviceId) {
+  if (!details.open || details.dataset.loaded) return;
+  details.dataset.loaded = "true";
+
+  const session = await fetchSession(sessionId);
+  const detail = details.querySelector(".session-detail");
+  if (!session) {
+    delete details.dataset.loaded;  // Retry on next expand
+    detail.innerHTML = '<div class="px-3 py-2 text-xs text-rose-400">Couldn\'t load this session</div>';
+    return;
+  }
+  detail.innerHTML = renderPastSessionDetail(session, deviceId);
+}
+
+function renderPastSessionDetail(session, deviceId) {
+  const hasPopEvents = session.events.some(
+    (e) => e.event_type === "pop_result"
+  );
+
+  const safeDeviceId = String(deviceId).replace(/[^a-zA-Z0-9]/g, "_");
+  const modalId = `analysis-${safeDeviceId}-${session.id}`;
+
+  return `
+    <div class="max-h-48 overflow-y-auto">
+      ${renderEventLog(session.events)}
+    </div>
+    ${
+      hasPopEvents
+        ? `
+      <div class="px-3 py-2 border-t border-gray-800">
+        <button 
+          onclick="showAnalysis('${modalId}')" 
+          class="w-full bg-sky-600 hover:bg-sky-500 text-white font-medium py-2 px-4 rounded-lg text-sm transition-colors"
+        >
+          View Game Analysis
+        </button>
+      </div>
+      ${renderAnalysisModal(session, deviceId, session.id)}
+    `
+        : ""
+    }
+  `;
+}
+
+async function loadOlderSessions(button, deviceId) {
+  const list = button.parentElement.querySelector(".past-session-list");
+  const shown = list.children.length;
+  const page = await fetchSessions(deviceId, shown, PAST_SESSIONS_PAGE);
+  list.insertAdjacentHTML(
+    "beforeend",
+    page.sessions.map((s) => renderPastSession(s, deviceId)).join("")
+  );
+  if (shown + page.sessions.length >= page.total) button.remove();
+}
+
 function renderPastSessions(sessions, deviceId) {
   if (!sessions || sessions.length === 0) return "";
   return `
     <div class="border-t border-gray-800">
       <div class="px-3 py-2 text-xs text-gray-500 uppercase tracking-wide">Past Sessions</div>
-      ${sessions.map((s, i) => renderPastSession(s, i, deviceId)).join("")}
+      <div class="past-session-list">${sessions.map((s) => renderPastSession(s, deviceId)).join("")}</div>
+      ${
+        sessions.length >= PAST_SESSIONS_SHOWN
+          ? `<button onclick="loadOlderSessions(this, '${deviceId}')"
+              class="w-full px-3 py-2 text-xs text-sky-400 hover:bg-gray-800/50">Show older sessions</button>`
+          : ""
+      }
     </div>
   `;
 }
@@ -750,6 +922,8 @@ function createDeviceCard(device) {
               <span class="status-text ${statusConfig.textClass} text-xs">${
     statusConfig.text
   }</span>
+              <span class="events-lost text-amber-500 text-xs">${renderEventsLost(device)}</span>
+              <span class="cmd-state text-gray-500 text-xs">${renderCommandState(device)}</span>
               ${
                 device.status !== "online" && device.last_seen
                   ? `<span class="text-gray-600 text-xs">${formatRelativeTime(
@@ -827,6 +1001,12 @@ function updateDeviceCard(card, device) {
   statusText.className = `status-text ${statusConfig.textClass} text-xs`;
   statusText.textContent = statusConfig.text;
 
+  const eventsLost = card.querySelector(".events-lost");
+  if (eventsLost) eventsLost.textContent = renderEventsLost(device);
+
+  const cmdState = card.querySelector(".cmd-state");
+  if (cmdState) cmdState.textContent = renderCommandState(device);
+
   const gameBadge = card.querySelector(".game-badge");
   gameBadge.innerHTML = getGameStateBadge(device);
 
@@ -1023,13 +1203,13 @@ function updateDeviceCard(card, device) {
     }
   }
 
-  // Update past sessions only if count changed
+  // Update past sessions only if one was archived (summaries; events are fetched when expanded)
   const pastSessionsEl = card.querySelector(".past-sessions");
   const prevDevice = knownDevices.get(device.device_id);
-  const prevCount = prevDevice?.past_sessions?.length ?? 0;
-  const newCount = device.past_sessions?.length ?? 0;
+  const prevNewest = prevDevice?.past_sessions?.[0]?.id;
+  const newNewest = device.past_sessions?.[0]?.id;
 
-  if (pastSessionsEl && newCount !== prevCount) {
+  if (pastSessionsEl && newNewest !== prevNewest) {
     pastSessionsEl.innerHTML = renderPastSessions(
       device.past_sessions,
       device.device_id
@@ -1038,8 +1218,11 @@ function updateDeviceCard(card, device) {
 }
 
 async function refresh() {
+  renderDevices(await fetchDevices());
+}
+
+function renderDevices(devices) {
   const container = document.getElementById("devices");
-  const devices = await fetchDevices();
 
   if (devices.length === 0) {
     container.innerHTML = `
@@ -1065,25 +1248,135 @@ async function refresh() {
   }
 
   for (const device of devices) {
-    let card = document.querySelector(`[data-device="${device.device_id}"]`);
+    renderDevice(container, device);
+  }
+}
 
-    if (!card) {
-      const placeholder = container.querySelector(".col-span-full");
-      if (placeholder) placeholder.remove();
+function renderDevice(container, device) {
+  let card = document.querySelector(`[data-device="${device.device_id}"]`);
 
-      container.insertAdjacentHTML("beforeend", createDeviceCard(device));
-      card = document.querySelector(`[data-device="${device.device_id}"]`);
-      knownDevices.set(device.device_id, device);
-    }
+  if (!card) {
+    const placeholder = container.querySelector(".col-span-full");
+    if (placeholder) placeholder.remove();
 
-    updateDeviceCard(card, device);
+    container.insertAdjacentHTML("beforeend", createDeviceCard(device));
+    card = document.querySelector(`[data-device="${device.device_id}"]`);
     knownDevices.set(device.device_id, device);
   }
+
+  updateDeviceCard(card, device);
+  knownDevices.set(device.device_id, device);
+}
+
+// === Change stream (server-sent events, see push.py) ===
+// A snapshot on connect, then one message per change. Deltas build a new device object so
+// updateDeviceCard can still diff against knownDevices (session events are appended in place,
+// as the card only compares their count).
+
+const DELTA_HANDLERS = {
+  device: (fields) => updateDevice(fields.device_id, (device) => ({ ...device, ...fields })),
+  session: (data) => updateDevice(data.device_id, (device) => ({ ...device, ...data })),
+  event: ({ device_id, event, session: fields }) =>
+    updateDevice(device_id, (device) => {
+      const session = device.current_session;
+      if (!session) return device;
+      session.events.push(event);
+      return { ...device, current_session: { ...session, ...fields } };
+    }),
+  leaderboard: ({ entries }) => setLeaderboard(entries),
+};
+
+function eventSeq(eventId) {
+  return Number(eventId.split("-")[1]);
+}
+
+function connectStream() {
+  const url = lastEventId ? `stream?last_id=${encodeURIComponent(lastEventId)}` : "stream";
+  stream = new EventSource(url);
+
+  stream.addEventListener("snapshot", (e) => {
+    const { devices, leaderboard } = JSON.parse(e.data);
+    lastEventId = e.lastEventId;
+    lastSeq = eventSeq(e.lastEventId);
+    stopPolling();
+
+    deviceState.clear();
+    dirtyDevices.clear();
+    devices.forEach((device) => deviceState.set(device.device_id, device));
+    renderDevices(devices);
+    setLeaderboard(leaderboard);
+  });
+
+  for (const [kind, apply] of Object.entries(DELTA_HANDLERS)) {
+    stream.addEventListener(kind, (e) => {
+      const seq = eventSeq(e.lastEventId);
+      if (lastSeq !== null && seq <= lastSeq) return;  // Already applied
+      if (lastSeq === null || seq !== lastSeq + 1) {
+        // Missed a message: reconnect to be replayed it (or sent a fresh snapshot)
+        stream.close();
+        connectStream();
+        return;
+      }
+      lastEventId = e.lastEventId;
+      lastSeq = seq;
+      apply(JSON.parse(e.data));
+    });
+  }
+
+  stream.onerror = () => {
+    if (stream.readyState !== EventSource.CLOSED) return;  // Reconnecting by itself (resumes after last id)
+
+    // Stream unavailable (e.g. proxy without SSE support) - poll until it's back
+    stream = null;
+    lastEventId = null;
+    startPolling();
+    setTimeout(connectStream, STREAM_RETRY_INTERVAL);
+  };
+}
+
+function updateDevice(deviceId, update) {
+  const device = deviceState.get(deviceId) ?? { device_id: deviceId, current_session: null, past_sessions: [] };
+  deviceState.set(deviceId, update(device));
+
+  if (dirtyDevices.size === 0) requestAnimationFrame(renderDirtyDevices);
+  dirtyDevices.add(deviceId);
+}
+
+function renderDirtyDevices() {
+  const container = document.getElementById("devices");
+  for (const deviceId of dirtyDevices) {
+    renderDevice(container, deviceState.get(deviceId));
+  }
+  dirtyDevices.clear();
+}
+
+function setLeaderboard(entries) {
+  leaderboardEntries = entries;
+  if (currentTab === 'leaderboard') renderLeaderboard(entries);
+}
+
+function startPolling() {
+  leaderboardEntries = null;
+  if (!pollInterval) {
+    refresh();
+    pollInterval = setInterval(refresh, REFRESH_INTERVAL);
+  }
+  if (currentTab === 'leaderboard') showTab('leaderboard');
+}
+
+function stopPolling() {
+  clearInterval(pollInterval);
+  clearInterval(leaderboardInterval);
+  pollInterval = null;
+  leaderboardInterval = null;
 }
 
 async function refreshLeaderboard() {
+  renderLeaderboard(await fetchLeaderboard());
+}
+
+function renderLeaderboard(entries) {
   const list = document.getElementById('leaderboard-list');
-  const entries = await fetchLeaderboard();
 
   if (entries.length === 0) {
     list.innerHTML = `
@@ -1120,5 +1413,8 @@ async function refreshLeaderboard() {
   }).join('');
 }
 
-refresh();
-setInterval(refresh, REFRESH_INTERVAL);
\ No newline at end of file
+if (window.EventSource) {
+  connectStream();
+} else {
+  startPolling();
+}
\ No newline at end of file
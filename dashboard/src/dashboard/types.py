@@ -1,8 +1,80 @@
-from typing import Literal, TypedDict
+from typing import Any, Literal, TypedDict
 
-type DevStatus = Literal["online", "serial_error", "offline"]
+type DevStatus = Literal["online", "unresponsive", "serial_error", "offline"]
 type DevGameState = Literal["playing", "idle"]
 
 
 class StatusOk(TypedDict):
     ok: bool
+
+
+class CommandSent(StatusOk):
+    id: str  # Request ID; its result arrives on whac/<device_id>/command_acks
+
+
+class PublishStats(TypedDict):
+    connected: bool
+    sent: int  # Commands the broker acked
+    failed: int  # Not connected, or no ack in time
+    latency_ms: dict[str, float | None]  # p50/p95/max publish-to-ack time over recent commands
+
+
+class IngestStats(TypedDict):
+    queue_depth: int  # Messages waiting to be applied
+    max_queue_depth: int
+    received: int  # From the broker
+    dropped: int  # Queue full (overload)
+    applied: int
+    decode_errors: int  # Not JSON
+    apply_errors: int  # Handler raised
+    batches: int
+    lag_ms: dict[str, float | None]  # p50/p95/max receive-to-applied time (per batch's oldest message)
+    apply_ms: dict[str, float | None]  # p50/p95/max time to decode & apply a batch
+
+
+class HitRateBucket(TypedDict):
+    start: int  # Unix timestamp (ms) of hour/day start
+    pops: int
+    hits: int
+    hit_rate: float
+
+
+class ReactionQuantiles(TypedDict):
+    n: int  # Hits counted
+    p50_ms: int | None  # Within ~3% (see sketches.py); None if no hits
+    p90_ms: int | None
+    p99_ms: int | None
+
+
+class HeatmapCell(ReactionQuantiles):
+    lvl: int
+    mole: int
+
+
+class SessionSummary(TypedDict):
+    id: int  # Archive ID (/sessions/{id} has its events)
+    started_at: int
+    ended_at: int
+    won: bool | None
+    score: int
+    pops: int
+    n_events: int
+
+
+class SessionPage(TypedDict):
+    sessions: list[SessionSummary]  # Newest first
+    total: int  # Device's archived sessions (all pages)
+    limit: int
+    offset: int
+
+
+class FleetStats(TypedDict):
+    devices: list[dict[str, Any]]  # Per device: device_id, pops, hits, misses, lates, hit_rate, sessions, p50_ms
+    fleet: dict[str, Any]  # Same, over all devices
+
+
+class ScorePage(TypedDict):
+    entries: list[dict[str, Any]]  # Same shape as /leaderboard entries, ranked
+    total: int  # Scores matching the query (all pages)
+    limit: int
+    offset: int
@@ -0,0 +1,12 @@
+"""Dashboard tests (stdlib unittest): `python -m unittest -v` from dashboard/.
+
+The dashboard reads its config from the environment on import; tests get a throwaway DATA_DIR.
+"""
+
+import os
+import tempfile
+
+os.environ.setdefault("MQTT_BROKER", "localhost")
+os.environ.setdefault("MQTT_PORT", "1883")
+os.environ.setdefault("APP_PORT", "8000")
+os.environ["DATA_DIR"] = tempfile.mkdtemp(prefix="dashboard-tests-")
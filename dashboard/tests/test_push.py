@@ -0,0 +1,139 @@
+"""Push deltas under batched ingest: a client applying them must end up with the server's state.
+
+handle_messages() applies a batch of a device's messages in one edit, so a session_start and its
+pops (or a session_end and the next session_start) can share one. The deltas are replayed
+through the frontend's own reducers (DELTA_HANDLERS in static/js/dashboard.js, run with node).
+"""
+
+import itertools
+import json
+import re
+import shutil
+import subprocess
+import unittest
+from pathlib import Path
+from typing import Any
+
+from dashboard import sessions
+from dashboard.__main__ import handle_messages
+from dashboard.ingest import Message
+from dashboard.leaderboard import hit_points
+from dashboard.push import snapshot
+from dashboard.state import COMMIT_LOCK, on_commit, registry
+
+DASHBOARD_JS = Path(__file__).resolve().parents[1] / "src" / "dashboard" / "static" / "js" / "dashboard.js"
+
+# The frontend's device store (as in dashboard.js, minus rendering) around its DELTA_HANDLERS
+REDUCER_JS = """
+const deviceState = new Map();
+function updateDevice(deviceId, update) {
+  const device = deviceState.get(deviceId) ?? { device_id: deviceId, current_session: null, past_sessions: [] };
+  deviceState.set(deviceId, update(device));
+}
+function setLeaderboard(entries) {}
+%s
+const { devices, deltas } = JSON.parse(require("fs").readFileSync(0, "utf8"));
+devices.forEach((device) => deviceState.set(device.device_id, device));
+for (const [kind, data] of deltas) DELTA_HANDLERS[kind](data);
+process.stdout.write(JSON.stringify(Object.fromEntries(deviceState)));
+"""
+
+_published: list[tuple[str, dict[str, Any]]] = []  # Every delta built, as a client receives it
+_device_ids = itertools.count()
+
+
+def _record(changes: list[tuple[str, Any]]) -> None:
+    _published.extend((kind, json.loads(json.dumps(build()))) for kind, build in changes)
+
+
+on_commit(_record)
+
+
+def pop(outcome: str, reaction_ms: int, ts: int) -> dict[str, Any]:
+    return {
+        "event_type": "pop_result",
+        "outcome": outcome,
+        "lvl": 2,
+        "mole_id": 1,
+        "reaction_ms": reaction_ms,
+        "ts": ts,
+    }
+
+
+def end(ts: int) -> dict[str, Any]:
+    return {"event_type": "session_end", "win": "true", "ts": ts}
+
+
+class BatchedPushTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls) -> None:
+        sessions.init()
+        cls.addClassCleanup(sessions.close)
+
+    def setUp(self) -> None:
+        self.device_id = f"push-{next(_device_ids)}"
+        with COMMIT_LOCK:
+            self.devices = json.loads(json.dumps(snapshot()()["devices"]))
+        _published.clear()
+
+    def apply(self, *events: dict[str, Any]) -> list[tuple[str, dict[str, Any]]]:
+        """Apply game events as one batch; return the deltas it published."""
+
+        topic = f"whac/{self.device_id}/game_events"
+        start = len(_published)
+        self.assertEqual(handle_messages(self.device_id, [Message(topic, e, e["ts"]) for e in events]), [])
+        return _published[start:]
+
+    def server_device(self) -> dict[str, Any]:
+        return json.loads(json.dumps(registry()[self.device_id].snapshot.to_dict()))
+
+    def test_deltas_as_of_each_change(self) -> None:
+        """A session's delta holds none of the pops batched after its start; each event its own running score."""
+
+        pops = [pop("hit", 200, 2), pop("miss", 1500, 3), pop("hit", 600, 4)]
+        deltas = self.apply({"event_type": "session_start", "ts": 1}, *pops)
+
+        (session,) = [data for kind, data in deltas if kind == "session"]
+        self.assertEqual(session["current_session"]["events"], [])
+        self.assertEqual(session["current_session"]["score"], 0)
+
+        events = [data for kind, data in deltas if kind == "event"]
+        self.assertEqual([e["event"] for e in events], pops)
+        running = list(itertools.accumulate(map(hit_points, pops)))
+        self.assertEqual([e["session"]["score"] for e in events], running)
+        self.assertEqual([e["session"]["pops"] for e in events], [1, 2, 3])
+        self.assertTrue(all("events" not in e["session"] for e in events))
+
+        self.assertEqual(sum(kind == "device" for kind, _ in deltas), 1)  # Fields as of the edit's end
+
+    @unittest.skipUnless(shutil.which("node"), "needs node")
+    def test_reducers_reach_server_state(self) -> None:
+        """After every batch, the frontend's reducers over all deltas so far give the server's device."""
+
+        batches = [
+            [{"event_type": "session_start", "ts": 1}, pop("hit", 200, 2), pop("miss", 1500, 3)],
+            [pop("hit", 350, 4), {"event_type": "lvl_complete", "lvl": 2, "ts": 5}, pop("late", 1500, 6)],
+            [pop("hit", 900, 7), end(8), {"event_type": "session_start", "ts": 9}, pop("hit", 100, 10)],
+            [pop("hit", 1200, 11)],
+            [end(12)],
+        ]
+        deltas: list[tuple[str, dict[str, Any]]] = []
+        for n, batch in enumerate(batches):
+            deltas += self.apply(*batch)
+            with self.subTest(batch=n):
+                self.assertEqual(self.reduce(deltas)[self.device_id], self.server_device())
+
+    def reduce(self, deltas: list[tuple[str, dict[str, Any]]]) -> dict[str, Any]:
+        """Return devices as dashboard.js has them after the snapshot & deltas."""
+
+        match = re.search(r"^const DELTA_HANDLERS = \{$.*?^\};$", DASHBOARD_JS.read_text(), re.DOTALL | re.MULTILINE)
+        assert match is not None  # noqa: S101 - dashboard.js defines it
+        stdin = json.dumps({"devices": self.devices, "deltas": deltas})
+        node = subprocess.run(
+            ["node", "-e", REDUCER_JS % match.group()], input=stdin, capture_output=True, check=True, text=True
+        )
+        return json.loads(node.stdout)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,64 @@
+"""Hit scoring: the dashboard's hit_points() against the device's game_hit_points()."""
+
+import shutil
+import subprocess
+import tempfile
+import unittest
+from fractions import Fraction
+from pathlib import Path
+
+from dashboard.leaderboard import hit_points
+
+EMB_INCLUDE = Path(__file__).resolve().parents[2] / "emb" / "include"
+LEVELS = range(1, 9)
+REACTION_MS = range(3001)  # Every ms, well past the 1500 ms cap
+
+
+def hit(lvl: int, reaction_ms: int) -> dict:
+    return {"event_type": "pop_result", "outcome": "hit", "lvl": lvl, "reaction_ms": reaction_ms}
+
+
+class HitPointsTest(unittest.TestCase):
+    def test_matches_formula_exactly(self) -> None:
+        """100 * lvl * max(0.5, 2 - rt/1000), truncated - in exact arithmetic, unlike floats."""
+        for lvl in LEVELS:
+            for rt in REACTION_MS:
+                want = int(100 * lvl * max(Fraction(1, 2), 2 - Fraction(rt, 1000)))
+                self.assertEqual(hit_points(hit(lvl, rt)), want, (lvl, rt))
+
+    def test_float_rounding_cases(self) -> None:
+        # Computed in floats these came out 1 lower than the device's score
+        self.assertEqual(hit_points(hit(1, 680)), 132)
+        self.assertEqual(hit_points(hit(1, 850)), 115)
+        self.assertEqual(hit_points(hit(1, 870)), 113)
+
+    def test_non_hits_score_nothing(self) -> None:
+        for outcome in ("miss", "late"):
+            self.assertEqual(hit_points({**hit(3, 200), "outcome": outcome}), 0)
+        self.assertEqual(hit_points({**hit(3, 200), "event_type": "lvl_complete"}), 0)
+
+    @unittest.skipUnless(shutil.which("cc"), "needs a C compiler")
+    def test_matches_device(self) -> None:
+        """Same points as the firmware's game_hit_points() (compiled for the host) for every lvl & rt."""
+        source = f"""
+            #include <stdio.h>
+            #include "game.h"
+            int main(void) {{
+                for (unsigned lvl = 1; lvl <= LVLS; lvl++)
+                    for (unsigned rt = 0; rt < {len(REACTION_MS)}; rt++) printf("%u\\n", game_hit_points(lvl, rt));
+                return 0;
+            }}
+        """
+        with tempfile.TemporaryDirectory() as tmp:
+            (Path(tmp) / "points.c").write_text(source)
+            subprocess.run(["cc", "-std=c11", "-I", str(EMB_INCLUDE), "-o", "points", "points.c"], cwd=tmp, check=True)
+            output = subprocess.run([Path(tmp) / "points"], capture_output=True, check=True, text=True).stdout
+
+        cases = [(lvl, rt) for lvl in LEVELS for rt in REACTION_MS]
+        device = dict(zip(cases, map(int, output.split()), strict=True))
+        mismatches = [(lvl, rt) for lvl, rt in cases if hit_points(hit(lvl, rt)) != device[lvl, rt]]
+        self.assertEqual(mismatches, [])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,180 @@
+"""Running session score & tallies (Session.add_event) against rescanning the events."""
+
+import itertools
+import random
+import unittest
+from typing import Any
+
+from dashboard import sessions
+from dashboard.__main__ import handle_messages
+from dashboard.ingest import Message
+from dashboard.leaderboard import calculate_score, get_leaderboard, hit_points, session_score, summary_pop_count
+from dashboard.state import LEVELS, Session, registry
+
+SEED = 42
+N_SESSIONS = 2000
+MAX_EVENTS = 60
+OTHER_EVENT_P = 0.1  # Chance of an event that isn't a pop_result
+SUMMARY_P = 0.7  # Chance a session_end carries the device's summary
+
+LVL_CHOICES = [*range(1, LEVELS + 1), 0, LEVELS + 1, None]  # Out of range & missing (None) too
+OUTCOMES = ["hit", "hit", "hit", "miss", "late", "bogus", None]
+OTHER_EVENTS = ["lvl_complete", "heartbeat"]
+
+_device_ids = itertools.count()
+
+
+def pop(outcome: str | None, lvl: int | None, reaction_ms: int | None) -> dict[str, Any]:
+    fields = {"outcome": outcome, "lvl": lvl, "reaction_ms": reaction_ms}
+    return {"event_type": "pop_result"} | {key: value for key, value in fields.items() if value is not None}
+
+
+def random_event(rng: random.Random) -> dict[str, Any]:
+    if rng.random() < OTHER_EVENT_P:
+        return {"event_type": rng.choice(OTHER_EVENTS)}
+    reaction_ms = rng.choice([None, rng.randrange(3001)])
+    return pop(rng.choice(OUTCOMES), rng.choice(LVL_CHOICES), reaction_ms)
+
+
+def random_session_end(rng: random.Random) -> dict[str, Any]:
+    """Return a session_end with or without the device's summary (which may cover more pops than sent)."""
+
+    end: dict[str, Any] = {"event_type": "session_end", "won": rng.choice((True, False))}
+    if rng.random() < SUMMARY_P:
+        end["score"] = rng.randrange(100000)
+        end |= {key: [rng.randrange(10) for _ in range(LEVELS)] for key in ("hits", "misses", "lates")}
+    return end
+
+
+def recount(events: list[dict[str, Any]]) -> dict[str, Any]:
+    """Return Session's tallies, recounted from scratch."""
+
+    pops = [e for e in events if e.get("event_type") == "pop_result"]
+    hits = [e for e in pops if e.get("outcome") == "hit"]
+    reaction = [e.get("reaction_ms", 1000) for e in hits]
+
+    def per_level(outcome: str) -> list[int]:
+        return [
+            sum(1 for e in pops if e.get("outcome") == outcome and e.get("lvl", 1) == lvl)
+            for lvl in range(1, LEVELS + 1)
+        ]
+
+    return {
+        "pops": len(pops),
+        "hits": per_level("hit"),
+        "misses": per_level("miss"),
+        "lates": per_level("late"),
+        "rt_sum": sum(reaction),
+        "rt_min": min(reaction, default=None),
+        "rt_max": max(reaction, default=None),
+    }
+
+
+def rescanned_session_score(events: list[dict[str, Any]]) -> int:
+    """Return session_score() as computed before scores were kept running (rescanning all events)."""
+
+    end = events[-1] if events else {}
+    if end.get("event_type") != "session_end" or "score" not in end:
+        return calculate_score(events)
+    pops = sum(1 for e in events if e.get("event_type") == "pop_result")
+    return int(end["score"]) if pops < summary_pop_count(end) else calculate_score(events)
+
+
+def tallies(session: Session) -> dict[str, Any]:
+    return {key: getattr(session, key) for key in recount([])}
+
+
+class RunningScoreTest(unittest.TestCase):
+    def test_every_level_and_reaction_time(self) -> None:
+        """A hit at each lvl & rt (past the cap) scores & tallies as the rescan does."""
+
+        for lvl in range(1, LEVELS + 1):
+            for rt in range(3001):
+                session = Session()
+                session.add_event(pop("hit", lvl, rt))
+                self.assertEqual(session.score, calculate_score(session.events), (lvl, rt))
+                self.assertEqual(session.score, hit_points(session.events[0]), (lvl, rt))
+                self.assertEqual(tallies(session), recount(session.events), (lvl, rt))
+
+    def test_random_sessions(self) -> None:
+        """Score & tallies match the rescan after every event (odd lvls/outcomes, missing fields incl.)."""
+
+        rng = random.Random(SEED)  # noqa: S311 - reproducible test data, not crypto
+        for n in range(N_SESSIONS):
+            session = Session()
+            for _ in range(rng.randrange(MAX_EVENTS)):
+                session.add_event(random_event(rng))
+                self.assertEqual(session.score, calculate_score(session.events), (n, session.events[-1]))
+            self.assertEqual(tallies(session), recount(session.events), n)
+
+            session.add_event(random_session_end(rng))
+            self.assertEqual(session_score(session), rescanned_session_score(session.events), n)
+
+
+class SessionScoreTest(unittest.TestCase):
+    def setUp(self) -> None:
+        self.session = Session()
+        for rt in (200, 400):
+            self.session.add_event(pop("hit", 2, rt))
+        self.session.add_event(pop("miss", 2, None))
+        self.running = calculate_score(self.session.events)
+
+    def end(self, **summary: Any) -> int:  # noqa: ANN401
+        self.session.add_event({"event_type": "session_end", **summary})
+        return session_score(self.session)
+
+    def test_no_summary(self) -> None:
+        self.assertEqual(self.end(), self.running)
+
+    def test_summary_covers_received_pops(self) -> None:
+        """All pops arrived: the dashboard's own score stands."""
+        self.assertEqual(
+            self.end(score=1, hits=[0, 2, 0, 0, 0, 0, 0, 0], misses=[0, 1, 0, 0, 0, 0, 0, 0]), self.running
+        )
+
+    def test_pops_lost_upstream(self) -> None:
+        """Fewer pops arrived than the device summarized: the device's score is used."""
+        self.assertEqual(self.end(score=12345, hits=[0, 5, 0, 0, 0, 0, 0, 0], lates=[1, 0, 0, 0, 0, 0, 0, 0]), 12345)
+
+    def test_summary_only_session(self) -> None:
+        """No pop_results at all (summary-only telemetry): the device's score is used."""
+        self.session = Session()
+        self.assertEqual(self.end(score=999, hits=[3, 0, 0, 0, 0, 0, 0, 0]), 999)
+
+    def test_not_ended(self) -> None:
+        self.session.add_event({"event_type": "lvl_complete"})
+        self.assertEqual(session_score(self.session), self.running)
+
+
+class CompactedSessionEndTest(unittest.TestCase):
+    """session_end of a session the device collapsed while offline (its session_start & pops are gone)."""
+
+    @classmethod
+    def setUpClass(cls) -> None:
+        sessions.init()
+        cls.addClassCleanup(sessions.close)
+
+    def end_session(self, **summary: Any) -> str:  # noqa: ANN401
+        device_id = f"compacted-{next(_device_ids)}"
+        end = {"event_type": "session_end", "win": "true", "compacted": True, "ts": 1000, **summary}
+        self.assertEqual(handle_messages(device_id, [Message(f"whac/{device_id}/game_events", end, 1000)]), [])
+        return device_id
+
+    def leaderboard_scores(self, device_id: str) -> list[int]:
+        return [e["score"] for e in get_leaderboard() if e["device_id"] == device_id]
+
+    def test_scored_by_summary(self) -> None:
+        device_id = self.end_session(score=1_000_000, hits=[9, 0, 0, 0, 0, 0, 0, 0])
+        self.assertEqual(self.leaderboard_scores(device_id), [1_000_000])
+        self.assertEqual([s["score"] for s in registry()[device_id].state.past_sessions], [1_000_000])
+
+    def test_summary_lost(self) -> None:
+        """Nothing to score it by (its pops are in the device's buffer_loss): not a 0 on the leaderboard."""
+        device_id = self.end_session()
+        self.assertEqual(self.leaderboard_scores(device_id), [])
+        self.assertEqual(registry()[device_id].state.past_sessions, [])
+        self.assertIsNone(registry()[device_id].state.current_session)
+
+
+if __name__ == "__main__":
+    unittest.main()
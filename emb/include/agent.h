@@ -2,7 +2,12 @@
  * @brief Agent task: handles UART communication with Python bridge (agent/)
  *
  * - Reads events from event_queue, sends as JSON over UART
- * - Responds to identify (b"I") requests from bridge
+ * - session_end carries per-session aggregates (see session_summary_t, sent via summary_queue)
+ * - Responds to identify (b"I"), status (b"?") and clock sync (b"Y") requests from bridge
+ * - Acknowledges tagged commands (cmd_ack, see CMD_TAG) once applied; identify says so ("acks")
+ * - Every game event carries its device tick ("t", ms since boot) for bridge-side timestamping
+ * - Drops to offline buffering if no command/keepalive within AGENT_TIMEOUT_MS
+ * - Emits a heartbeat every DEVICE_HEARTBEAT_MS while connected
  */
 
 #pragma once
@@ -12,15 +17,39 @@
 
 #define DEVICE_ID_LEN 10
 
-/** @brief Lock-free SPSC ring buffer for offline event storage */
+/**
+ * @brief Ring buffer for offline event storage (only touched by agent task)
+ * @note When full, completed sessions whose session_end has a summary are collapsed into it (the
+ *       summary covers them); only if nothing can be collapsed is the oldest event dropped
+ * @note Summaries sit in their own ring, in the order of the session_ends that have one; past
+ *       SUMMARY_BUFFER_SIZE, a session_end loses its summary (sent without aggregates): the oldest
+ *       not collapsed, else the oldest, whose collapsed events then count as dropped
+ * @note dropped counts every event lost, including those a dropped/summary-less session_end stood for
+ */
 typedef struct {
     game_event_t events[EVENT_BUFFER_SIZE];
-    volatile uint8_t head; // next write pos (producer only)
-    volatile uint8_t tail; // next read pos (consumer only)
+    session_summary_t summaries[SUMMARY_BUFFER_SIZE];
+    volatile uint8_t head; // next write pos
+    volatile uint8_t tail; // next read pos
+    uint8_t sum_tail;      // oldest summary
+    uint8_t sum_count;
+    uint16_t dropped; // events lost since last flush (reported as buffer_loss)
 } event_ring_buffer_t;
 
 /** @brief Set by UART ISR when identify command received */
 extern volatile bool identify_requested;
 
+/** @brief Set by UART ISR when status command received */
+extern volatile bool status_requested;
+
+/** @brief Set by UART ISR when clock sync command received */
+extern volatile bool sync_requested;
+
+/** @brief Tick count captured by UART ISR on receipt of clock sync command */
+extern volatile TickType_t sync_tick;
+
+/** @brief Summary-only telemetry (suppress pop_result; session_end carries aggregates) */
+extern volatile bool summary_only;
+
 /** @brief FreeRTOS task entry point */
 void agent_task(void* param);
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #define LVLS 8
 #define LIVES 5
@@ -15,4 +16,33 @@ typedef enum {
     POP_LATE,
 } pop_outcome_t;
 
+/** @brief Reaction time (ms) from which a hit scores the minimum (half the base points) */
+#define HIT_RT_CAP_MS 1500
+
+/**
+ * @brief Points for a hit: 100 * lvl * max(0.5, 2 - rt/1000), truncated
+ * @note Integer-only (no FPU use) - the dashboard's hit_points() must compute exactly this
+ * @param lvl Level (1-based)
+ * @param reaction_ms Reaction time (ms)
+ * @return Points
+ */
+static inline uint32_t game_hit_points(const uint8_t lvl, const uint16_t reaction_ms) {
+    const uint32_t rt = reaction_ms < HIT_RT_CAP_MS ? reaction_ms : HIT_RT_CAP_MS;
+    return (uint32_t)lvl * (2000 - rt) / 10;
+}
+
+/** @brief Snapshot of game progress (for status command) */
+typedef struct {
+    bool playing;
+    uint8_t level; // 1-based
+    uint8_t lives;
+    uint8_t pop; // Pops completed in current level
+} game_status_t;
+
+/**
+ * @brief Get a consistent snapshot of the game state (safe to call from other tasks)
+ * @param out Snapshot output
+ */
+void game_get_status(game_status_t* const out);
+
 void game_task(void* const param);
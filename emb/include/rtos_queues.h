@@ -9,16 +9,35 @@
 
 #define EVENT_QUEUE_LENGTH 32
 #define CMD_QUEUE_LENGTH 8
+#define ACK_QUEUE_LENGTH 16
+#define SUMMARY_QUEUE_LENGTH 2
 
-/** @brief Offline event buffer size (~1 game session worth) */
+/** @brief Offline summary buffer size (session_end records that keep their summary) */
+#define SUMMARY_BUFFER_SIZE 16
+
+/** @brief Offline event buffer size (~1 raw session, or many once compacted to summaries) */
 #define EVENT_BUFFER_SIZE 100
 
-/** @brief Agent connection timeout (ms) - mark disconnected if no command received */
-#define AGENT_TIMEOUT_MS 60000
+/**
+ * @brief Agent connection timeout (ms) - mark disconnected if no command received
+ * @note Bridge sends a keepalive (K) every 2s, so this tolerates ~2 lost pings
+ */
+#define AGENT_TIMEOUT_MS 6000
+
+/** @brief Interval (ms) between device heartbeats while agent is connected */
+#define DEVICE_HEARTBEAT_MS 5000
 
 #define RTOS_QUEUES_OK 0
 #define RTOS_QUEUES_ERR -1
 
+/**
+ * @brief Tagged command prefix: `#`, ID byte, command byte (acknowledged once applied)
+ * @note IDs are >= CMD_ID_MIN so older firmware ignores the prefix & just runs the command
+ */
+#define CMD_TAG '#'
+#define CMD_ID_MIN 0x80
+#define CMD_ID_NONE 0 // Untagged command (not acknowledged)
+
 typedef enum {
     CMD_SET_LEVEL,
     CMD_RESET,
@@ -29,8 +48,34 @@ typedef enum {
 typedef struct {
     cmd_type_t type;
     uint8_t level;
+    uint8_t id; // CMD_ID_NONE if untagged
 } cmd_msg_t;
 
+/** @brief Tagged command acknowledgement (sent to the bridge by the agent task) */
+typedef struct {
+    uint8_t id;
+    bool applied; // false if dropped (command queue full)
+} cmd_ack_t;
+
+/** @brief Reaction-time histogram: RT_HIST_BINS buckets of RT_HIST_BIN_MS (last is open-ended) */
+#define RT_HIST_BINS 8
+#define RT_HIST_BIN_MS 200
+
+/**
+ * @brief Per-session aggregates, accumulated by the game task as pops happen
+ * @note Integer-only (no FPU use); rt_* cover hits only and are 0 if there were no hits
+ */
+typedef struct {
+    uint32_t score; // Sum of game_hit_points() (same integer formula as dashboard's hit_points())
+    uint8_t hits[LVLS];
+    uint8_t misses[LVLS];
+    uint8_t lates[LVLS];
+    uint8_t rt_hist[RT_HIST_BINS];
+    uint16_t rt_min;
+    uint16_t rt_mean;
+    uint16_t rt_max;
+} session_summary_t;
+
 typedef enum {
     EVENT_SESSION_START,
     EVENT_POP_RESULT,
@@ -41,6 +86,7 @@ typedef enum {
 /** @brief Event sent to the bridge/agent */
 typedef struct {
     event_type_t type;
+    TickType_t tick; // When event happened (ticks are ms, configTICK_RATE_HZ = 1000)
     union {
         struct {
             uint8_t mole;
@@ -56,12 +102,17 @@ typedef struct {
         } level_complete;
         struct {
             bool won;
+            bool compacted;   // Set by offline buffer when the session's other events collapsed
+            bool has_summary; // Its session_summary_t is next in summary_queue (not in the union)
+            uint8_t collapsed; // How many of those its summary stands for (0 once it's lost)
         } session_end;
     } data;
 } game_event_t;
 
 extern QueueHandle_t event_queue;
 extern QueueHandle_t cmd_queue;
+extern QueueHandle_t ack_queue;
+extern QueueHandle_t summary_queue; // session_summary_t, one per session_end with has_summary
 
 // Agent connection state (extern - defined in agent.c)
 extern volatile bool agent_connected;
@@ -79,17 +130,20 @@ int8_t rtos_queues_init(void);
 void evbuf_init(void);
 
 /**
- * @brief Push event to offline buffer (drops if full)
+ * @brief Push event to offline buffer
+ * @note If full, compacts completed sessions first, then drops oldest (counted for buffer_loss)
  * @param event Event to push
+ * @param summary Its session summary (only read for a session_end with has_summary)
  */
-void evbuf_push(const game_event_t* const event);
+void evbuf_push(const game_event_t* const event, const session_summary_t* const summary);
 
 /**
  * @brief Pop event from offline buffer
  * @param event Output event
+ * @param summary Output session summary (only written for a session_end with has_summary)
  * @return true if event was popped, false if buffer empty
  */
-bool evbuf_pop(game_event_t* const event);
+bool evbuf_pop(game_event_t* const event, session_summary_t* const summary);
 
 /**
  * @brief Get number of events in offline buffer
@@ -97,5 +151,5 @@ bool evbuf_pop(game_event_t* const event);
  */
 uint8_t evbuf_count(void);
 
-/** @brief Flush all buffered events via UART (called on reconnect) */
+/** @brief Flush all buffered events via UART, preceded by a loss marker if any were dropped */
 void evbuf_flush(void);
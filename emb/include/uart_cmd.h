@@ -3,6 +3,7 @@
 #include "FreeRTOS.h"
 #include "portmacro.h"
 #include "task.h"
+#include <stdbool.h>
 
 /**
  * @brief Initialize UART command handler (interrupt + pause task)
@@ -11,3 +12,6 @@
  * @see mxc_errors.h
  */
 const BaseType_t uart_cmd_init(TaskHandle_t game_handle);
+
+/** @brief Return true if the game task is currently paused (via P command) */
+bool uart_cmd_is_paused(void);
@@ -2,38 +2,166 @@
 #include "mxc_errors.h"
 #include "mxc_sys.h"
 #include "rtos_queues.h"
+#include "uart_cmd.h"
 #include "utils.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 static const char* const OUTCOME_STR[] = {"hit", "miss", "late"};
 
 volatile bool identify_requested = false;
+volatile bool status_requested = false;
+volatile bool sync_requested = false;
+volatile TickType_t sync_tick = 0;
+volatile bool summary_only = false;
 
 // Agent connection state (used by uart_cmd.c for timeout tracking)
 volatile bool agent_connected = false;
 volatile TickType_t last_cmd_tick = 0;
 static event_ring_buffer_t evbuf;
 
-static void send_event_json(const game_event_t* const event);
+static void send_event_json(
+    const game_event_t* const event,
+    const session_summary_t* const summary
+);
+
+static void send_buffer_loss(uint16_t dropped);
 
 void evbuf_init(void) {
     evbuf.head = 0;
     evbuf.tail = 0;
+    evbuf.sum_tail = 0;
+    evbuf.sum_count = 0;
+    evbuf.dropped = 0;
+}
+
+static inline uint8_t evbuf_next(const uint8_t idx) { return (idx + 1) % EVENT_BUFFER_SIZE; }
+
+static inline bool has_summary(const game_event_t* const event) {
+    return event->type == EVENT_SESSION_END && event->data.session_end.has_summary;
+}
+
+static inline void summary_pop_oldest(void) {
+    evbuf.sum_tail = (evbuf.sum_tail + 1) % SUMMARY_BUFFER_SIZE;
+    evbuf.sum_count--;
+}
+
+/** @brief Remove the n-th oldest summary (later ones move up, keeping session_end order) */
+static void summary_remove(uint8_t n) {
+    for (; n + 1 < evbuf.sum_count; n++) {
+        evbuf.summaries[(evbuf.sum_tail + n) % SUMMARY_BUFFER_SIZE] =
+            evbuf.summaries[(evbuf.sum_tail + n + 1) % SUMMARY_BUFFER_SIZE];
+    }
+    evbuf.sum_count--;
+}
+
+/** @brief Count events lost from the buffer (reported as buffer_loss on flush) */
+static inline void evbuf_count_dropped(const uint16_t n) {
+    evbuf.dropped = (n > UINT16_MAX - evbuf.dropped) ? UINT16_MAX : evbuf.dropped + n;
+}
+
+/**
+ * @brief Make room for a summary by sending one buffered session_end without it
+ *
+ * Takes the oldest session whose events are still buffered (the bridge rescores them). If every
+ * summary stands in for collapsed events, the oldest goes and those events count as dropped.
+ */
+static void summary_evict(void) {
+    game_event_t* oldest = NULL;
+    uint8_t n = 0; // Summaries before i's
+    for (uint8_t i = evbuf.tail; i != evbuf.head; i = evbuf_next(i)) {
+        game_event_t* const event = &evbuf.events[i];
+        if (!has_summary(event)) continue;
+        if (event->data.session_end.collapsed == 0) {
+            event->data.session_end.has_summary = false;
+            summary_remove(n);
+            return;
+        }
+        if (oldest == NULL) oldest = event;
+        n++;
+    }
+
+    if (oldest != NULL) { // Always: every summary's session_end is buffered
+        oldest->data.session_end.has_summary = false;
+        evbuf_count_dropped(oldest->data.session_end.collapsed);
+        oldest->data.session_end.collapsed = 0;
+    }
+    summary_pop_oldest();
+}
+
+/**
+ * @brief Collapse completed sessions into their session_end record where it has a summary
+ *
+ * Sessions are sequential, so the events before a session_end (back to the previous one) are
+ * that session's; its summary covers them. Sessions without one (summary_queue was full, or
+ * evicted since) keep their events: they're all the bridge has to score them by.
+ *
+ * @return true if any slots were freed
+ */
+static bool evbuf_compact(void) {
+    uint8_t w = evbuf.tail;
+    uint8_t r = evbuf.tail;
+
+    while (r != evbuf.head) {
+        // This session's events run up to its session_end (head if it's still in progress)
+        uint8_t end = r;
+        while (end != evbuf.head && evbuf.events[end].type != EVENT_SESSION_END) end = evbuf_next(end);
+        const bool collapse = (end != evbuf.head) && has_summary(&evbuf.events[end]);
+
+        uint8_t collapsed = 0;
+        for (; r != end; r = evbuf_next(r)) {
+            if (collapse) {
+                collapsed++;
+                continue;
+            }
+            if (w != r) evbuf.events[w] = evbuf.events[r];
+            w = evbuf_next(w);
+        }
+        if (end == evbuf.head) break;
+
+        if (collapsed > 0) {
+            evbuf.events[end].data.session_end.compacted = true;
+            evbuf.events[end].data.session_end.collapsed += collapsed; // < EVENT_BUFFER_SIZE in all
+        }
+        if (w != end) evbuf.events[w] = evbuf.events[end];
+        w = evbuf_next(w);
+        r = evbuf_next(end);
+    }
+
+    const bool freed = (w != evbuf.head);
+    evbuf.head = w;
+    return freed;
 }
 
-/** @brief Push event to ring buffer. Returns false if full (event dropped). */
-void evbuf_push(const game_event_t* const event) {
-    const uint8_t next = (evbuf.head + 1) % EVENT_BUFFER_SIZE;
-    if (next == evbuf.tail) return; // Full - drop event
+void evbuf_push(const game_event_t* const event, const session_summary_t* const summary) {
+    if (evbuf_next(evbuf.head) == evbuf.tail && !evbuf_compact()) {
+        // Nothing to collapse - drop oldest (with any events it stood for; flush reports the loss)
+        const game_event_t* const oldest = &evbuf.events[evbuf.tail];
+        if (has_summary(oldest)) summary_pop_oldest();
+        evbuf_count_dropped(1 + (oldest->type == EVENT_SESSION_END ? oldest->data.session_end.collapsed : 0));
+        evbuf.tail = evbuf_next(evbuf.tail);
+    }
+
+    if (has_summary(event)) {
+        if (evbuf.sum_count == SUMMARY_BUFFER_SIZE) summary_evict();
+        evbuf.summaries[(evbuf.sum_tail + evbuf.sum_count) % SUMMARY_BUFFER_SIZE] = *summary;
+        evbuf.sum_count++;
+    }
+
     evbuf.events[evbuf.head] = *event;
-    evbuf.head = next;
+    evbuf.head = evbuf_next(evbuf.head);
 }
 
-bool evbuf_pop(game_event_t* const event) {
+bool evbuf_pop(game_event_t* const event, session_summary_t* const summary) {
     if (evbuf.head == evbuf.tail) return false; // Empty
     *event = evbuf.events[evbuf.tail];
-    evbuf.tail = (evbuf.tail + 1) % EVENT_BUFFER_SIZE;
+    evbuf.tail = evbuf_next(evbuf.tail);
+
+    if (has_summary(event)) {
+        *summary = evbuf.summaries[evbuf.sum_tail];
+        summary_pop_oldest();
+    }
     return true;
 }
 
@@ -42,8 +170,14 @@ uint8_t evbuf_count(void) {
 }
 
 void evbuf_flush(void) {
+    if (evbuf.dropped > 0) {
+        send_buffer_loss(evbuf.dropped);
+        evbuf.dropped = 0;
+    }
+
     game_event_t event;
-    while (evbuf_pop(&event)) send_event_json(&event);
+    session_summary_t summary;
+    while (evbuf_pop(&event, &summary)) send_event_json(&event, &summary);
 }
 
 /** @brief Get unique device ID from chip's serial number (last 5 bytes, most distinct). */
@@ -74,20 +208,99 @@ static const char* get_device_id(void) {
 static void send_identify(void) {
     const char* device_id = get_device_id();
     if (device_id == NULL) return;
-    printf("{\"event_type\":\"identify\",\"device_id\":\"%s\"}\n", device_id);
+    // acks: tagged commands are acknowledged (cmd_ack) - the bridge only tags if this is set
+    printf("{\"event_type\":\"identify\",\"device_id\":\"%s\",\"acks\":true}\n", device_id);
+    fflush(stdout);
+}
+
+static void send_sync(void) {
+    printf("{\"event_type\":\"sync\",\"t\":%lu}\n", (unsigned long)sync_tick);
     fflush(stdout);
 }
 
-static void send_event_json(const game_event_t* const event) {
+static void send_status(void) {
+    game_status_t game;
+    game_get_status(&game);
+
+    printf(
+        "{\"event_type\":\"status\",\"state\":\"%s\",\"lvl\":%u,\"lives\":%u,\"pop\":%u,"
+        "\"paused\":%s,\"buffered\":%u,\"summary_only\":%s}\n",
+        game.playing ? "playing" : "idle",
+        game.level,
+        game.lives,
+        game.pop,
+        TF(uart_cmd_is_paused()),
+        evbuf_count(),
+        TF(summary_only)
+    );
+    fflush(stdout);
+}
+
+static void send_buffer_loss(const uint16_t dropped) {
+    printf("{\"event_type\":\"buffer_loss\",\"dropped\":%u}\n", dropped);
+    fflush(stdout);
+}
+
+static void send_cmd_ack(const cmd_ack_t* const ack) {
+    printf("{\"event_type\":\"cmd_ack\",\"id\":%u,\"ok\":%s}\n", ack->id, TF(ack->applied));
+    fflush(stdout);
+}
+
+static void send_heartbeat(void) {
+    printf("{\"event_type\":\"heartbeat\"}\n");
+    fflush(stdout);
+}
+
+/** @brief Print `,"key":[v0,v1,...]` (JSON fragment) */
+static void print_u8_array(const char* const key, const uint8_t* const vals, const uint8_t n) {
+    printf(",\"%s\":[", key);
+    for (uint8_t i = 0; i < n; i++) printf(i ? ",%u" : "%u", vals[i]);
+    printf("]");
+}
+
+/** @brief Send session_end, with its summary's aggregates unless it has none (summary unused) */
+static void send_session_end(
+    const game_event_t* const event,
+    const session_summary_t* const summary
+) {
+    printf(
+        "{\"event_type\":\"session_end\",\"t\":%lu,\"win\":%s,\"compacted\":%s",
+        (unsigned long)event->tick,
+        TF(event->data.session_end.won),
+        TF(event->data.session_end.compacted)
+    );
+    if (event->data.session_end.has_summary) {
+        printf(
+            ",\"score\":%lu,\"rt_min\":%u,\"rt_mean\":%u,\"rt_max\":%u",
+            (unsigned long)summary->score,
+            summary->rt_min,
+            summary->rt_mean,
+            summary->rt_max
+        );
+        print_u8_array("hits", summary->hits, LVLS);
+        print_u8_array("misses", summary->misses, LVLS);
+        print_u8_array("lates", summary->lates, LVLS);
+        print_u8_array("rt_hist", summary->rt_hist, RT_HIST_BINS);
+    }
+    printf("}\n");
+}
+
+static void send_event_json(
+    const game_event_t* const event,
+    const session_summary_t* const summary
+) {
     switch (event->type) {
         case EVENT_SESSION_START:
-            printf("{\"event_type\":\"session_start\"}\n");
+            printf(
+                "{\"event_type\":\"session_start\",\"t\":%lu}\n", (unsigned long)event->tick
+            );
             break;
 
         case EVENT_POP_RESULT:
             printf(
-                "{\"event_type\":\"pop_result\",\"mole_id\":%u,\"outcome\":\"%s\","
+                "{\"event_type\":\"pop_result\",\"t\":%lu,\"mole_id\":%u,\"outcome\":\"%s\","
                 "\"reaction_ms\":%u,\"lives\":%u,\"lvl\":%u,\"pop\":%u,\"pops_total\":%u}\n",
+                (unsigned long)event->tick,
                 event->data.pop.mole,
                 OUTCOME_STR[event->data.pop.outcome],
                 event->data.pop.reaction_ms,
@@ -100,14 +313,14 @@ static void send_event_json(const game_event_t* const event) {
 
         case EVENT_LEVEL_COMPLETE:
             printf(
-                "{\"event_type\":\"lvl_complete\",\"lvl\":%u}\n", event->data.level_complete.level
+                "{\"event_type\":\"lvl_complete\",\"t\":%lu,\"lvl\":%u}\n",
+                (unsigned long)event->tick,
+                event->data.level_complete.level
             );
             break;
 
         case EVENT_SESSION_END:
-            printf(
-                "{\"event_type\":\"session_end\",\"win\":%s}\n", TF(event->data.session_end.won)
-            );
+            send_session_end(event, summary);
             break;
     }
     fflush(stdout);
@@ -118,6 +331,8 @@ void agent_task(void* const param) {
 
     evbuf_init();
     game_event_t event;
+    session_summary_t summary;
+    TickType_t last_heartbeat_tick = 0;
 
     while (true) {
         // Handle identify request from bridge (marks connection)
@@ -129,12 +344,52 @@ void agent_task(void* const param) {
             evbuf_flush();
         }
 
+        // Answer clock sync first - its tick was captured in the ISR, but the bridge's
+        // round-trip (and so its error bound) includes the time until we reply
+        if (sync_requested) {
+            sync_requested = false;
+            send_sync();
+        }
+
+        if (status_requested) {
+            status_requested = false;
+            send_status();
+        }
+
+        // Command acks go out even while buffering (the bridge is waiting on them)
+        cmd_ack_t ack;
+        while (xQueueReceive(ack_queue, &ack, 0) == pdTRUE) send_cmd_ack(&ack);
+
+        // Copy the ISR-updated tick before reading the clock: read the other way round, a command
+        // arriving in between makes now - last_cmd underflow & the bridge look silent
+        const TickType_t last_cmd = last_cmd_tick;
+        const TickType_t now = xTaskGetTickCount();
+
+        // Bridge went silent without sending D (crashed/killed) - fall back to buffering
+        if (agent_connected && (now - last_cmd) > pdMS_TO_TICKS(AGENT_TIMEOUT_MS)) {
+            agent_connected = false;
+        }
+
+        // Low-rate heartbeat so the bridge can tell a stalled device from an idle one
+        if (agent_connected && (now - last_heartbeat_tick) >= pdMS_TO_TICKS(DEVICE_HEARTBEAT_MS)) {
+            last_heartbeat_tick = now;
+            send_heartbeat();
+        }
+
         // Drain event queue
         while (xQueueReceive(event_queue, &event, pdMS_TO_TICKS(10)) == pdTRUE) {
+            // Summary-only telemetry: per-pop results are folded into session_end
+            if (summary_only && event.type == EVENT_POP_RESULT) continue;
+
+            // Queued just before its session_end by the game task
+            if (has_summary(&event) && xQueueReceive(summary_queue, &summary, 0) != pdTRUE) {
+                event.data.session_end.has_summary = false;
+            }
+
             if (agent_connected) {
-                send_event_json(&event);
+                send_event_json(&event, &summary);
             } else {
-                evbuf_push(&event);
+                evbuf_push(&event, &summary);
             }
         }
 
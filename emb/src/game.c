@@ -5,6 +5,7 @@
 #include "rtos_queues.h"
 #include "utils.h"
 #include <stdint.h>
+#include <string.h>
 
 static uint8_t lives;
 static uint32_t rng_state;
@@ -14,11 +15,67 @@ static bool reset_requested = false;
 static bool start_requested = false;
 static bool reset_abort_session = false;
 
+// Progress exposed via game_get_status()
+static bool playing = false;
+static uint8_t cur_lvl_idx = 0;
+static uint8_t cur_pop = 0;
+
 static const uint8_t POPS_PER_LVL[8] = {[0 ... 7] = 10};
 static const uint16_t POP_DURATIONS[8] = {1500, 1250, 1000, 750, 600, 500, 350, 275};
 
+// Streaming per-session aggregates (sent with session_end)
+static session_summary_t summary;
+static uint32_t rt_sum;
+
+static void summary_reset(void) {
+    memset(&summary, 0, sizeof(summary));
+    summary.rt_min = UINT16_MAX;
+    rt_sum = 0;
+}
+
+static void summary_add_pop(
+    const pop_outcome_t outcome,
+    const uint16_t reaction_ms,
+    const uint8_t lvl_idx
+) {
+    switch (outcome) {
+        case POP_MISS:
+            summary.misses[lvl_idx]++;
+            return;
+        case POP_LATE:
+            summary.lates[lvl_idx]++;
+            return;
+        case POP_HIT:
+            break;
+    }
+
+    summary.hits[lvl_idx]++;
+    rt_sum += reaction_ms;
+    if (reaction_ms < summary.rt_min) summary.rt_min = reaction_ms;
+    if (reaction_ms > summary.rt_max) summary.rt_max = reaction_ms;
+
+    const uint8_t bin = reaction_ms / RT_HIST_BIN_MS;
+    summary.rt_hist[bin < RT_HIST_BINS ? bin : RT_HIST_BINS - 1]++;
+
+    summary.score += game_hit_points(lvl_idx + 1, reaction_ms);
+}
+
+static void summary_finalize(void) {
+    uint32_t n_hits = 0;
+    for (uint8_t i = 0; i < LVLS; i++) n_hits += summary.hits[i];
+
+    if (n_hits == 0) {
+        summary.rt_min = 0;
+        return;
+    }
+
+    summary.rt_mean = (rt_sum + n_hits / 2) / n_hits; // Rounded
+}
+
 static void emit_session_start(void) {
-    const game_event_t event = {.type = EVENT_SESSION_START};
+    const game_event_t event = {.type = EVENT_SESSION_START, .tick = xTaskGetTickCount()};
+    summary_reset();
+    playing = true;
     xQueueSend(event_queue, &event, 0);
 }
 
@@ -32,6 +89,7 @@ static void emit_pop_result(
 ) {
     const game_event_t event = {
         .type = EVENT_POP_RESULT,
+        .tick = xTaskGetTickCount(),
         .data.pop = {
             .mole = mole,
             .outcome = outcome,
@@ -42,21 +100,34 @@ static void emit_pop_result(
             .pops_total = pops_total,
         },
     };
+    summary_add_pop(outcome, reaction_ms, lvl);
+    cur_pop = pop_idx;
     xQueueSend(event_queue, &event, 0);
 }
 
 static void emit_level_complete(const uint8_t lvl) {
     const game_event_t event = {
         .type = EVENT_LEVEL_COMPLETE,
+        .tick = xTaskGetTickCount(),
         .data.level_complete.level = lvl + 1,
     };
     xQueueSend(event_queue, &event, 0);
 }
 
 static void emit_session_end(const bool won) {
+    summary_finalize();
+    playing = false;
+
+    // Only this task sends to either queue, so a free event slot can't be taken before we use it:
+    // the summary is queued only if its session_end will be too, keeping the two queues in step
+    if (uxQueueSpacesAvailable(event_queue) == 0) return;
     const game_event_t event = {
         .type = EVENT_SESSION_END,
-        .data.session_end.won = won,
+        .tick = xTaskGetTickCount(),
+        .data.session_end = {
+            .won = won,
+            .has_summary = xQueueSend(summary_queue, &summary, 0) == pdTRUE,
+        },
     };
     xQueueSend(event_queue, &event, 0);
 }
@@ -83,6 +154,11 @@ static void drain_cmd_queue(void) {
                 start_requested = true;
                 break;
         }
+
+        if (cmd.id != CMD_ID_NONE) {
+            const cmd_ack_t ack = {.id = cmd.id, .applied = true};
+            xQueueSend(ack_queue, &ack, 0);
+        }
     }
 }
 
@@ -187,6 +263,8 @@ static pop_outcome_t pop_do(
 }
 
 static void game_run_level(const uint8_t lvl_idx, const uint8_t pops) {
+    cur_lvl_idx = lvl_idx;
+    cur_pop = 0;
     lvl_show(lvl_idx);
 
     for (int pop = 0; pop < pops; pop++) {
@@ -333,6 +411,15 @@ static void game_run(void) {
     feedback_win();
 }
 
+void game_get_status(game_status_t* const out) {
+    taskENTER_CRITICAL();
+    out->playing = playing;
+    out->level = cur_lvl_idx + 1;
+    out->lives = lives;
+    out->pop = cur_pop;
+    taskEXIT_CRITICAL();
+}
+
 void game_task(void* const param) {
     (void)param;
 
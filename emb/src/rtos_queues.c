@@ -3,6 +3,8 @@
 
 QueueHandle_t event_queue = NULL;
 QueueHandle_t cmd_queue = NULL;
+QueueHandle_t ack_queue = NULL;
+QueueHandle_t summary_queue = NULL;
 
 int8_t rtos_queues_init(void) {
     event_queue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(game_event_t));
@@ -15,5 +17,22 @@ int8_t rtos_queues_init(void) {
         return -1;
     }
 
+    ack_queue = xQueueCreate(ACK_QUEUE_LENGTH, sizeof(cmd_ack_t));
+    if (!ack_queue) {
+        vQueueDelete(cmd_queue);
+        vQueueDelete(event_queue);
+        cmd_queue = event_queue = NULL;
+        return -1;
+    }
+
+    summary_queue = xQueueCreate(SUMMARY_QUEUE_LENGTH, sizeof(session_summary_t));
+    if (!summary_queue) {
+        vQueueDelete(ack_queue);
+        vQueueDelete(cmd_queue);
+        vQueueDelete(event_queue);
+        ack_queue = cmd_queue = event_queue = NULL;
+        return -1;
+    }
+
     return E_SUCCESS;
 }
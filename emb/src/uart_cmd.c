@@ -8,6 +8,14 @@
  * - 1-8: Set level
  * - I: Identify (respond with device ID)
  * - D: Disconnect (mark agent as disconnected, start buffering events)
+ * - K: Keepalive (no-op; only refreshes the agent connection timeout)
+ * - Q: Summary-only telemetry (suppress per-pop events)
+ * - V: Verbose telemetry (send every event; default)
+ * - ?: Status (respond with game/pause/buffer snapshot)
+ * - Y: Clock sync (respond with tick count captured on receipt)
+ *
+ * Any command may be tagged as `#`, ID (>= CMD_ID_MIN), command; tagged commands are
+ * acknowledged via ack_queue once applied (game/pause task) or dropped (queue full).
  *
  * Architecture:
  * UART RX Interrupt -> command dispatch -> task notification or queue
@@ -27,6 +35,22 @@ static TaskHandle_t game_task_handle;
 static TaskHandle_t pause_task_handle;
 static bool paused = false;
 
+// Tagged command parser state (ISR only): CMD_TAG, then ID byte, then command byte
+static enum { TAG_NONE, TAG_ID, TAG_CMD } tag_state = TAG_NONE;
+static uint8_t tag_id = CMD_ID_NONE;
+
+/** @brief Acknowledge command from ISR (no-op if untagged; ack lost if ack queue is full) */
+static void ack_from_isr(const uint8_t id, const bool applied, BaseType_t* const woken) {
+    if (id == CMD_ID_NONE) return;
+    const cmd_ack_t ack = {.id = id, .applied = applied};
+    xQueueSendFromISR(ack_queue, &ack, woken);
+}
+
+/** @brief Queue command for game task (which acks it once applied); nacked if queue is full */
+static void queue_cmd_from_isr(const cmd_msg_t* const cmd, BaseType_t* const woken) {
+    if (xQueueSendFromISR(cmd_queue, cmd, woken) != pdTRUE) ack_from_isr(cmd->id, false, woken);
+}
+
 /**
  * @brief UART interrupt handler
  * @note reads commands from UART and sends them to game task
@@ -41,28 +65,48 @@ void UART_Handler(void) {
     while (MXC_UART_GetRXFIFOAvailable(uart) > 0) {
         int c = MXC_UART_ReadCharacterRaw(uart);
 
+        // Tagged command: remember ID for the command byte that follows. An out-of-range ID
+        // means the prefix was garbled/truncated - resync by treating c as a plain command
+        uint8_t id = CMD_ID_NONE;
+        if (tag_state == TAG_ID && c >= CMD_ID_MIN) {
+            tag_id = (uint8_t)c;
+            tag_state = TAG_CMD;
+            continue;
+        }
+        if (tag_state == TAG_CMD) id = tag_id;
+        tag_state = TAG_NONE;
+        if (c == CMD_TAG && id == CMD_ID_NONE) {
+            tag_state = TAG_ID;
+            continue;
+        }
+
         // Any command (except D) refreshes connection timeout
         if (c != 'D') last_cmd_tick = xTaskGetTickCount();
 
         switch (c) {
             case 'P':
-                xTaskNotifyFromISR(pause_task_handle, 0, eNoAction, &woken);
+                // Pause task acks once toggled; a toggle still pending is not merged (nacked)
+                if (xTaskNotifyFromISR(pause_task_handle, id, eSetValueWithoutOverwrite, &woken)
+                    != pdPASS) {
+                    ack_from_isr(id, false, &woken);
+                }
                 break;
 
             case 'D':
                 // Disconnect command - mark agent as disconnected (start buffering)
                 agent_connected = false;
+                ack_from_isr(id, true, &woken);
                 break;
 
             case 'R': {
-                const cmd_msg_t cmd = {.type = CMD_RESET};
-                xQueueSendFromISR(cmd_queue, &cmd, &woken);
+                const cmd_msg_t cmd = {.type = CMD_RESET, .id = id};
+                queue_cmd_from_isr(&cmd, &woken);
                 break;
             }
 
             case 'S': {
-                const cmd_msg_t cmd = {.type = CMD_START};
-                xQueueSendFromISR(cmd_queue, &cmd, &woken);
+                const cmd_msg_t cmd = {.type = CMD_START, .id = id};
+                queue_cmd_from_isr(&cmd, &woken);
                 break;
             }
 
@@ -70,16 +114,45 @@ void UART_Handler(void) {
                 const cmd_msg_t cmd = {
                     .type = CMD_SET_LEVEL,
                     .level = (uint8_t)(c - '0'),
+                    .id = id,
                 };
-                xQueueSendFromISR(cmd_queue, &cmd, &woken);
+                queue_cmd_from_isr(&cmd, &woken);
                 break;
             }
 
             case 'I':
                 identify_requested = true;
+                ack_from_isr(id, true, &woken);
+                break;
+
+            case 'K':
+                // Keepalive - last_cmd_tick already refreshed above
+                ack_from_isr(id, true, &woken);
+                break;
+
+            case 'Q':
+                summary_only = true;
+                ack_from_isr(id, true, &woken);
+                break;
+
+            case 'V':
+                summary_only = false;
+                ack_from_isr(id, true, &woken);
+                break;
+
+            case '?':
+                status_requested = true;
+                ack_from_isr(id, true, &woken);
+                break;
+
+            case 'Y':
+                sync_tick = xTaskGetTickCountFromISR();
+                sync_requested = true;
+                ack_from_isr(id, true, &woken);
                 break;
 
             default:
+                ack_from_isr(id, false, &woken); // Unknown command
                 break;
         }
     }
@@ -87,12 +160,13 @@ void UART_Handler(void) {
     portYIELD_FROM_ISR(woken);
 }
 
-/** @brief FreeRTOS task to resume/suspend game task */
+/** @brief FreeRTOS task to resume/suspend game task (notification value: command ID) */
 static void pause_task(void* const param) {
     (void)param;
 
     while (true) {
-        xTaskNotifyWait(0, 0, NULL, portMAX_DELAY);
+        uint32_t id;
+        xTaskNotifyWait(0, UINT32_MAX, &id, portMAX_DELAY);
 
         if (paused) {
             vTaskResume(game_task_handle);
@@ -101,9 +175,16 @@ static void pause_task(void* const param) {
             vTaskSuspend(game_task_handle);
             paused = true;
         }
+
+        if (id != CMD_ID_NONE) {
+            const cmd_ack_t ack = {.id = (uint8_t)id, .applied = true};
+            xQueueSend(ack_queue, &ack, 0);
+        }
     }
 }
 
+bool uart_cmd_is_paused(void) { return paused; }
+
 const BaseType_t uart_cmd_init(const TaskHandle_t game_handle) {
     game_task_handle = game_handle;
 